@@ -104,7 +104,7 @@ class TmpStat {
 class BasicAppContext {
  public:
   TmpStat *tmp_stat = nullptr;
-  erpc::Rpc *rpc = nullptr;
+  erpc::Rpc<erpc::CTransport> *rpc = nullptr;
   erpc::FastRand fastrand;
 
   std::vector<int> session_num_vec;
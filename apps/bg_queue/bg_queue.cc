@@ -0,0 +1,155 @@
+/**
+ * @file bg_queue.cc
+ * @brief Contention microbenchmark for the queues that carry datapath calls
+ * from background threads to an Rpc's dispatch thread. 1 to
+ * FLAGS_max_bg_threads producer threads push in a loop, like background
+ * threads calling enqueue_response(), and one consumer thread drains the queue
+ * in batches, like the event loop. For comparison, each step also runs with a
+ * mutex-protected std::queue, which eRPC used before MpscQueue.
+ *
+ * Besides throughput, this reports how long the consumer's pop_batch() calls
+ * take, since the dispatch thread must not stall behind background threads.
+ */
+#include <gflags/gflags.h>
+#include <signal.h>
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "../apps_common.h"
+#include "util/latency.h"
+#include "util/mpsc_queue.h"
+#include "util/numautils.h"
+#include "util/timer.h"
+
+static constexpr size_t kAppQueueSize = 4096;   // Like Rpc::kBgQueueSize
+static constexpr size_t kAppPopBatch = 64;      // Like Rpc::kBgQueuePopBatch
+static constexpr size_t kAppMaxBgThreads = 64;  // Max producer threads
+static constexpr double kAppLatFac = 100.0;     // Pop latency in units of 10 ns
+
+DEFINE_uint64(max_bg_threads, 8, "Producer threads in the last step");
+
+volatile sig_atomic_t ctrl_c_pressed = 0;
+void ctrl_c_handler(int) { ctrl_c_pressed = 1; }
+
+// The item that enqueue_response() sends to the dispatch thread
+typedef erpc::enq_resp_args_t item_t;
+
+/// The queue that eRPC used before MpscQueue: a mutex around a std::queue,
+/// with a size polled by the consumer
+class LockedQueue {
+ public:
+  void push(const item_t &item) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push(item);
+    size++;
+  }
+
+  size_t pop_batch(item_t *out, size_t max_n) {
+    if (size == 0) return 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t n = 0;
+    for (; n < max_n && !queue.empty(); n++) {
+      out[n] = queue.front();
+      queue.pop();
+    }
+    size -= n;
+    return n;
+  }
+
+ private:
+  std::mutex mutex;
+  std::queue<item_t> queue;
+  volatile size_t size = 0;
+};
+
+/// Per-producer counters, on separate cache lines
+struct ProducerStats {
+  size_t num_pushes = 0;
+  size_t push_cycles = 0;
+  uint8_t pad[erpc::kCacheLineSize];
+};
+
+/// Run one step with num_bg_threads producers, and print one line of results
+template <class QueueT>
+void run_step(const char *name, size_t num_bg_threads, double freq_ghz) {
+  auto *queue = new QueueT();
+  std::vector<ProducerStats> stats(num_bg_threads);
+  std::atomic<bool> stop(false);
+  std::atomic<size_t> num_done(0);
+
+  std::vector<std::thread> producers;
+  for (size_t i = 0; i < num_bg_threads; i++) {
+    producers.emplace_back([queue, &stats, &stop, &num_done, i] {
+      item_t item(nullptr, nullptr);
+      ProducerStats &s = stats[i];
+      while (!stop.load(std::memory_order_relaxed)) {
+        const size_t start_tsc = erpc::rdtsc();
+        queue->push(item);
+        s.push_cycles += erpc::rdtsc() - start_tsc;
+        s.num_pushes++;
+      }
+      num_done++;
+    });
+
+    // Leave the first core for the consumer
+    const size_t num_lcores = erpc::num_lcores_per_numa_node();
+    if (num_lcores > 1) {
+      erpc::bind_to_core(producers.back(), 0, 1 + i % (num_lcores - 1));
+    }
+  }
+
+  item_t batch[kAppPopBatch];
+  size_t num_pops = 0, max_pop_cycles = 0;
+  erpc::Latency pop_latency;
+  const size_t end_tsc =
+      erpc::rdtsc() + erpc::ms_to_cycles(FLAGS_test_ms, freq_ghz);
+  while (true) {
+    const size_t start_tsc = erpc::rdtsc();
+    if (start_tsc >= end_tsc) break;
+    num_pops += queue->pop_batch(batch, kAppPopBatch);
+
+    const size_t pop_cycles = erpc::rdtsc() - start_tsc;
+    max_pop_cycles = std::max(max_pop_cycles, pop_cycles);
+    pop_latency.update(static_cast<size_t>(
+        erpc::to_usec(pop_cycles, freq_ghz) * kAppLatFac));
+  }
+
+  // Keep draining so that producers waiting on a full queue can exit
+  stop = true;
+  while (num_done != num_bg_threads) queue->pop_batch(batch, kAppPopBatch);
+  for (auto &t : producers) t.join();
+
+  size_t num_pushes = 0, push_cycles = 0;
+  for (auto &s : stats) {
+    num_pushes += s.num_pushes;
+    push_cycles += s.push_cycles;
+  }
+
+  // Percentiles saturate at 39.68 us, so the max is tracked exactly
+  printf("%s %zu %.2f %.1f %.0f %.0f %.1f\n", name, num_bg_threads,
+         num_pops / (FLAGS_test_ms * 1000.0),
+         erpc::to_nsec(push_cycles, freq_ghz) / num_pushes,
+         pop_latency.perc(.99) * 1000.0 / kAppLatFac,
+         pop_latency.perc(.999) * 1000.0 / kAppLatFac,
+         erpc::to_usec(max_pop_cycles, freq_ghz));
+  delete queue;
+}
+
+int main(int argc, char **argv) {
+  signal(SIGINT, ctrl_c_handler);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  erpc::rt_assert(FLAGS_max_bg_threads <= kAppMaxBgThreads, "Too many threads");
+
+  const double freq_ghz = erpc::measure_rdtsc_freq();
+  printf(
+      "queue bg_threads dispatch_mops push_ns pop_p99_ns pop_p999_ns "
+      "pop_max_us\n");
+
+  for (size_t i = 1; i <= FLAGS_max_bg_threads; i++) {
+    run_step<LockedQueue>("mutex", i, freq_ghz);
+    run_step<erpc::MpscQueue<item_t, kAppQueueSize>>("mpsc", i, freq_ghz);
+    if (ctrl_c_pressed == 1) break;
+  }
+}
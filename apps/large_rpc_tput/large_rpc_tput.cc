@@ -125,7 +125,7 @@ void thread_func(size_t thread_id, app_stats_t *app_stats, erpc::Nexus *nexus) {
   // erpc::rt_assert(port_vec.size() > 0);
   // uint8_t phy_port = port_vec.at(thread_id % port_vec.size());
 
-  erpc::Rpc rpc(nexus, static_cast<void *>(&c),
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c),
                                   static_cast<uint8_t>(thread_id),
                                   basic_sm_handler);
   rpc.retry_connect_on_invalid_rpc_id = true;
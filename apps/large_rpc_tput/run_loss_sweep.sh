@@ -0,0 +1,24 @@
+# Measure large RPC goodput under 0.1% to 1% random packet loss. Run this on
+# two machines with process ID 0 and 1. Packet drops need a testing build of
+# eRPC (cmake -DPERF=OFF). To compare selective retransmission against
+# go-back-N, run it once each on this tree and on a tree before selective
+# retransmission.
+set -e
+process_id=${1:-0}
+
+for drop_prob in 0.0 0.001 0.003 0.01; do
+  echo "large_rpc_tput: drop_prob = $drop_prob"
+  ./large_rpc_tput \
+      --test_ms 10000 \
+      --req_size 1048576 \
+      --resp_size 32 \
+      --num_processes 2 \
+      --num_proc_0_threads 1 \
+      --num_proc_other_threads 1 \
+      --concurrency 4 \
+      --drop_prob $drop_prob \
+      --profile incast \
+      --throttle 0 \
+      --throttle_fraction 0.9 \
+      --process_id $process_id | grep "Tput"
+done
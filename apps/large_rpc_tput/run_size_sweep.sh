@@ -0,0 +1,23 @@
+# Measure large RPC throughput for 64 KB to 8 MB requests. Run this on two
+# machines with process ID 0 and 1. To compare UDP GSO/GRO against regular
+# datagrams, run it once each with kUdpGso set to true and to false in
+# src/tweakme.h.
+set -e
+process_id=${1:-0}
+
+for req_size in 65536 262144 1048576 4194304 8388608; do
+  echo "large_rpc_tput: req_size = $req_size"
+  ./large_rpc_tput \
+      --test_ms 10000 \
+      --req_size $req_size \
+      --resp_size 32 \
+      --num_processes 2 \
+      --num_proc_0_threads 1 \
+      --num_proc_other_threads 1 \
+      --concurrency 8 \
+      --drop_prob 0.0 \
+      --profile incast \
+      --throttle 0 \
+      --throttle_fraction 0.9 \
+      --process_id $process_id | grep "Tput"
+done
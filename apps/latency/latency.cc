@@ -44,7 +44,7 @@ class ClientContext : public BasicAppContext {
 void req_handler(erpc::ReqHandle *req_handle, void *_context) {
   auto *c = static_cast<ServerContext *>(_context);
 
-  erpc::Rpc::resize_msg_buffer(&req_handle->pre_resp_msgbuf,
+  erpc::Rpc<erpc::CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf,
                                                  kAppRespSize);
   c->rpc->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf);
 }
@@ -54,7 +54,7 @@ void server_func(erpc::Nexus *nexus) {
   // uint8_t phy_port = port_vec.at(0);
 
   ServerContext c;
-  erpc::Rpc rpc(nexus, static_cast<void *>(&c), 0 /* tid */,
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c), 0 /* tid */,
                                   basic_sm_handler);
   c.rpc = &rpc;
 
@@ -102,7 +102,7 @@ void client_func(erpc::Nexus *nexus) {
   // uint8_t phy_port = port_vec.at(0);
 
   ClientContext c;
-  erpc::Rpc rpc(nexus, static_cast<void *>(&c), 0,
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c), 0,
                                   basic_sm_handler);
 
   rpc.retry_connect_on_invalid_rpc_id = true;
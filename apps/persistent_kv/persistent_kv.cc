@@ -179,45 +179,54 @@ void max_key_req_handler(erpc::ReqHandle *req_handle, void *_context) {
   c->rpc->enqueue_response(req_handle, &resp);
 }
 
-void kv_req_handler(erpc::ReqHandle *req_handle, void *_context) {
+// Prefetch the hash buckets for a batch of requests, then do the hash table
+// operations for up to kAppMaxServerBatch of them at a time
+void kv_req_batch_handler(erpc::ReqHandle *const *req_handles, size_t num_reqs,
+                          void *_context) {
   auto *c = static_cast<ServerContext *>(_context);
 
-  const erpc::MsgBuffer *req = req_handle->get_req_msgbuf();
-  size_t req_size = req->get_data_size();
+  for (size_t i = 0; i < num_reqs; i++) {
+    erpc::ReqHandle *req_handle = req_handles[i];
+    const erpc::MsgBuffer *req = req_handle->get_req_msgbuf();
+    size_t req_size = req->get_data_size();
 
-  erpc::MsgBuffer &resp = req_handle->pre_resp_msgbuf;
-  c->rpc->resize_msg_buffer(&resp, sizeof(Value));  // sizeof(Result) is smaller
-
-  const size_t batch_i = c->num_reqs_in_batch;
-
-  // Common for both GETs and SETs
-  Key *key = reinterpret_cast<Key *>(req->buf);
-
-  c->req_handle_arr[batch_i] = req_handle;
-  c->key_ptr_arr[batch_i] = key;
-  c->keyhash_arr[batch_i] = c->hashmap->get_hash(key);
-  c->hashmap->prefetch(c->keyhash_arr[batch_i]);
-
-  if (req_size == sizeof(Key)) {
-    if (kAppVerbose) printf("Thread %zu: received GET request\n", c->thread_id);
-    // GET request
-    c->is_set_arr[batch_i] = false;
-    Value *value = reinterpret_cast<Value *>(resp.buf);
-    c->val_ptr_arr[batch_i] = value;
-  } else if (req_size == sizeof(Key) + sizeof(Value)) {
-    if (kAppVerbose) printf("Thread %zu: received SET request\n", c->thread_id);
-    // PUT request
-    c->is_set_arr[batch_i] = true;
-    Value *value = reinterpret_cast<Value *>(req->buf + sizeof(Key));
-    c->val_ptr_arr[batch_i] = value;
-  } else {
-    assert(false);
+    erpc::MsgBuffer &resp = req_handle->pre_resp_msgbuf;
+    c->rpc->resize_msg_buffer(&resp, sizeof(Value));  // sizeof(Result) smaller
+
+    const size_t batch_i = c->num_reqs_in_batch;
+
+    // Common for both GETs and SETs
+    Key *key = reinterpret_cast<Key *>(req->buf);
+
+    c->req_handle_arr[batch_i] = req_handle;
+    c->key_ptr_arr[batch_i] = key;
+    c->keyhash_arr[batch_i] = c->hashmap->get_hash(key);
+    c->hashmap->prefetch(c->keyhash_arr[batch_i]);
+
+    if (req_size == sizeof(Key)) {
+      if (kAppVerbose) printf("Thread %zu: GET request\n", c->thread_id);
+      // GET request
+      c->is_set_arr[batch_i] = false;
+      Value *value = reinterpret_cast<Value *>(resp.buf);
+      c->val_ptr_arr[batch_i] = value;
+    } else if (req_size == sizeof(Key) + sizeof(Value)) {
+      if (kAppVerbose) printf("Thread %zu: SET request\n", c->thread_id);
+      // PUT request
+      c->is_set_arr[batch_i] = true;
+      Value *value = reinterpret_cast<Value *>(req->buf + sizeof(Key));
+      c->val_ptr_arr[batch_i] = value;
+    } else {
+      assert(false);
+    }
+
+    // Tracking
+    c->num_reqs_tot++;
+    c->num_reqs_in_batch++;
+    if (c->num_reqs_in_batch == kAppMaxServerBatch) drain_batch(c);
   }
 
-  // Tracking
-  c->num_reqs_tot++;
-  c->num_reqs_in_batch++;
-  if (c->num_reqs_in_batch == kAppMaxServerBatch) drain_batch(c);
+  // Zero-copy requests are valid only during this handler, so drain the rest
+  if (c->num_reqs_in_batch > 0) drain_batch(c);
 }
 
 // Populate the partition for this server and set c.max_key
@@ -298,14 +307,7 @@ void server_func(erpc::Nexus *nexus, size_t thread_id) {
     size_t start_tsc = erpc::rdtsc();
 
     while (erpc::rdtsc() - start_tsc <= tsc_per_sec) {
-      size_t num_reqs_tot_start = c.num_reqs_tot;
       rpc.run_event_loop_once();
-
-      // If no new requests were received in this iteration of the event loop,
-      // and we have responses to send, send them now.
-      if (c.num_reqs_tot == num_reqs_tot_start && c.num_reqs_in_batch > 0) {
-        drain_batch(&c);
-      }
     }
 
     const double seconds = erpc::to_sec(erpc::rdtsc() - start_tsc, freq_ghz);
@@ -402,7 +404,8 @@ void create_sessions(ClientContext &c) {
   }
 
   for (size_t i = 0; i < FLAGS_num_server_threads; i++) {
-    int session_num = c.rpc->create_session(server_uri, i);
+    // All of this client's requests may go to one session
+    int session_num = c.rpc->create_session(server_uri, i, kAppMaxWindowSize);
     erpc::rt_assert(session_num >= 0, "Failed to create session");
     c.session_num_vec.push_back(session_num);
   }
@@ -499,7 +502,7 @@ int main(int argc, char **argv) {
 
   erpc::Nexus nexus(erpc::get_uri_for_process(FLAGS_process_id),
                     FLAGS_numa_node, 0);
-  nexus.register_req_func(kAppKvReqType, kv_req_handler);
+  nexus.register_batch_req_func(kAppKvReqType, kv_req_batch_handler);
   nexus.register_req_func(kAppMaxKeyReqType, max_key_req_handler);
 
   size_t num_threads = FLAGS_process_id == 0 ? FLAGS_num_server_threads
@@ -237,8 +237,8 @@ void client_connect_sessions(BasicAppContext *c) {
   printf("pmem_bw: Thread %zu: Creating 1 session to proc 0, thread %zu.\n",
          c->thread_id, rem_tid);
 
-  c->session_num_vec[0] =
-      c->rpc->create_session(erpc::get_uri_for_process(0), rem_tid);
+  c->session_num_vec[0] = c->rpc->create_session(
+      erpc::get_uri_for_process(0), rem_tid, kAppMaxConcurrency);
   erpc::rt_assert(c->session_num_vec[0] >= 0, "create_session() failed");
 
   while (c->num_sm_resps != 1) {
@@ -330,8 +330,6 @@ int main(int argc, char **argv) {
                 "This test needs RX ring--independent requests");
   static_assert(erpc::kEnableCc == false,
                 "Disable congestion control for performance");
-  static_assert(erpc::kSessionReqWindow >= 32,
-                "Increase eRPC's session request window for performance");
 
   signal(SIGINT, ctrl_c_handler);
   gflags::ParseCommandLineFlags(&argc, &argv, true);
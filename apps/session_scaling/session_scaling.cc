@@ -0,0 +1,160 @@
+/**
+ * @file session_scaling.cc
+ * @brief Measure request latency as the number of sessions per Rpc grows. One
+ * client thread creates up to FLAGS_max_sessions sessions to one server thread,
+ * and keeps FLAGS_concurrency requests in flight over them round-robin.
+ */
+#include <gflags/gflags.h>
+#include <signal.h>
+#include <cstring>
+#include <string>
+#include "../apps_common.h"
+#include "rpc.h"
+#include "util/autorun_helpers.h"
+#include "util/latency.h"
+#include "util/numautils.h"
+
+static constexpr size_t kAppEvLoopMs = 1000;  // Duration of event loop
+static constexpr double kAppLatFac = 10.0;    // Precision factor for latency
+static constexpr size_t kAppReqType = 1;      // eRPC request type
+static constexpr size_t kAppMaxConcurrency = 64;
+
+DEFINE_uint64(max_sessions, 16384, "Sessions created in the last step");
+DEFINE_uint64(concurrency, 8, "Requests in flight at the client");
+DEFINE_uint64(msg_size, 32, "Request and response size");
+
+const std::string uris[] = {
+  "172.17.224.104:31850",
+  "172.17.224.105:31860"
+};
+
+volatile sig_atomic_t ctrl_c_pressed = 0;
+void ctrl_c_handler(int) { ctrl_c_pressed = 1; }
+
+class ServerContext : public BasicAppContext {};
+
+class ClientContext : public BasicAppContext {
+ public:
+  size_t num_active_sessions = 0;  // Connected sessions used for requests
+  size_t next_session_i = 0;       // Round-robin index into session_num_vec
+  size_t start_tsc[kAppMaxConcurrency];
+  erpc::MsgBuffer req_msgbuf[kAppMaxConcurrency];
+  erpc::MsgBuffer resp_msgbuf[kAppMaxConcurrency];
+  erpc::Latency latency;
+  ~ClientContext() {}
+};
+
+void req_handler(erpc::ReqHandle *req_handle, void *_context) {
+  auto *c = static_cast<ServerContext *>(_context);
+
+  erpc::Rpc<erpc::CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf,
+                                                 FLAGS_msg_size);
+  c->rpc->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf);
+}
+
+void server_func(erpc::Nexus *nexus) {
+  ServerContext c;
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c), 0 /* tid */,
+                                  basic_sm_handler);
+  c.rpc = &rpc;
+
+  while (true) {
+    rpc.run_event_loop(1000);
+    if (ctrl_c_pressed == 1) break;
+  }
+}
+
+// Create sessions until we have num_sessions
+void connect_sessions(ClientContext &c, size_t num_sessions) {
+  while (c.session_num_vec.size() < num_sessions) {
+    int session_num = c.rpc->create_session(uris[0], 0 /* tid */);
+    erpc::rt_assert(session_num >= 0, "Failed to create session");
+    c.session_num_vec.push_back(session_num);
+
+    // Don't flood the server's session management queue
+    if (c.session_num_vec.size() - c.num_sm_resps >= 256) {
+      c.rpc->run_event_loop_once();
+    }
+  }
+
+  while (c.num_sm_resps != num_sessions) {
+    c.rpc->run_event_loop(kAppEvLoopMs);
+    if (unlikely(ctrl_c_pressed == 1)) return;
+  }
+}
+
+void app_cont_func(void *, void *);
+inline void send_req(ClientContext &c, size_t msgbuf_idx) {
+  int session_num = c.session_num_vec[c.next_session_i];
+  c.next_session_i = (c.next_session_i + 1) % c.num_active_sessions;
+
+  c.start_tsc[msgbuf_idx] = erpc::rdtsc();
+  c.rpc->enqueue_request(session_num, kAppReqType, &c.req_msgbuf[msgbuf_idx],
+                         &c.resp_msgbuf[msgbuf_idx], app_cont_func,
+                         reinterpret_cast<void *>(msgbuf_idx));
+}
+
+void app_cont_func(void *_context, void *_tag) {
+  auto *c = static_cast<ClientContext *>(_context);
+  auto msgbuf_idx = reinterpret_cast<size_t>(_tag);
+  assert(c->resp_msgbuf[msgbuf_idx].get_data_size() == FLAGS_msg_size);
+
+  double req_lat_us = erpc::to_usec(erpc::rdtsc() - c->start_tsc[msgbuf_idx],
+                                    c->rpc->get_freq_ghz());
+  c->latency.update(static_cast<size_t>(req_lat_us * kAppLatFac));
+
+  send_req(*c, msgbuf_idx);
+}
+
+void client_func(erpc::Nexus *nexus) {
+  ClientContext c;
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c), 0,
+                                  basic_sm_handler);
+
+  rpc.retry_connect_on_invalid_rpc_id = true;
+  c.rpc = &rpc;
+
+  for (size_t i = 0; i < FLAGS_concurrency; i++) {
+    c.req_msgbuf[i] = rpc.alloc_msg_buffer_or_die(FLAGS_msg_size);
+    c.resp_msgbuf[i] = rpc.alloc_msg_buffer_or_die(FLAGS_msg_size);
+  }
+
+  printf("num_sessions median_us 99th_us 999th_us max_us\n");
+
+  bool started = false;
+  for (size_t num_sessions = 1; num_sessions <= FLAGS_max_sessions;
+       num_sessions *= 4) {
+    connect_sessions(c, num_sessions);
+    if (ctrl_c_pressed == 1) break;
+    c.num_active_sessions = num_sessions;
+
+    if (!started) {
+      for (size_t i = 0; i < FLAGS_concurrency; i++) send_req(c, i);
+      started = true;
+    }
+
+    // Run one untimed second so that the round-robin covers the new sessions
+    rpc.run_event_loop(kAppEvLoopMs);
+    c.latency.reset();
+
+    rpc.run_event_loop(FLAGS_test_ms);
+    if (ctrl_c_pressed == 1) break;
+    printf("%zu %.1f %.1f %.1f %.1f\n", num_sessions,
+           c.latency.perc(.5) / kAppLatFac, c.latency.perc(.99) / kAppLatFac,
+           c.latency.perc(.999) / kAppLatFac, c.latency.max() / kAppLatFac);
+  }
+}
+
+int main(int argc, char **argv) {
+  signal(SIGINT, ctrl_c_handler);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  erpc::rt_assert(FLAGS_concurrency <= kAppMaxConcurrency, "Invalid conc");
+
+  erpc::Nexus nexus(uris[FLAGS_process_id], 0, 0);
+  nexus.register_req_func(kAppReqType, req_handler);
+
+  auto t =
+      std::thread(FLAGS_process_id == 0 ? server_func : client_func, &nexus);
+  erpc::bind_to_core(t, 0, 0);
+  t.join();
+}
@@ -0,0 +1,139 @@
+/**
+ * @file session_window.cc
+ * @brief Measure the request rate of one session as its request window grows.
+ * For each window size, the client creates a session with that window and
+ * keeps a full window of requests in flight.
+ */
+#include <gflags/gflags.h>
+#include <signal.h>
+#include <cstring>
+#include <string>
+#include "../apps_common.h"
+#include "rpc.h"
+#include "util/autorun_helpers.h"
+#include "util/numautils.h"
+
+static constexpr size_t kAppEvLoopMs = 1000;  // Duration of event loop
+static constexpr size_t kAppReqType = 1;      // eRPC request type
+
+DEFINE_uint64(max_req_window, erpc::kSessionMaxReqWindow,
+              "Request window of the last session");
+DEFINE_uint64(msg_size, 32, "Request and response size");
+
+const std::string uris[] = {
+  "172.17.224.104:31850",
+  "172.17.224.105:31860"
+};
+
+volatile sig_atomic_t ctrl_c_pressed = 0;
+void ctrl_c_handler(int) { ctrl_c_pressed = 1; }
+
+class ServerContext : public BasicAppContext {};
+
+class ClientContext : public BasicAppContext {
+ public:
+  size_t num_resps = 0;
+  size_t num_in_flight = 0;
+  bool draining = false;  // Don't send more requests in the cont function
+  std::vector<erpc::MsgBuffer> req_msgbuf, resp_msgbuf;
+  ~ClientContext() {}
+};
+
+void req_handler(erpc::ReqHandle *req_handle, void *_context) {
+  auto *c = static_cast<ServerContext *>(_context);
+
+  erpc::Rpc<erpc::CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf,
+                                                 FLAGS_msg_size);
+  c->rpc->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf);
+}
+
+void server_func(erpc::Nexus *nexus) {
+  ServerContext c;
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c), 0 /* tid */,
+                                  basic_sm_handler);
+  c.rpc = &rpc;
+
+  while (true) {
+    rpc.run_event_loop(1000);
+    if (ctrl_c_pressed == 1) break;
+  }
+}
+
+void app_cont_func(void *, void *);
+inline void send_req(ClientContext &c, size_t msgbuf_idx) {
+  c.num_in_flight++;
+  c.rpc->enqueue_request(c.session_num_vec.back(), kAppReqType,
+                         &c.req_msgbuf[msgbuf_idx], &c.resp_msgbuf[msgbuf_idx],
+                         app_cont_func, reinterpret_cast<void *>(msgbuf_idx));
+}
+
+void app_cont_func(void *_context, void *_tag) {
+  auto *c = static_cast<ClientContext *>(_context);
+  auto msgbuf_idx = reinterpret_cast<size_t>(_tag);
+  assert(c->resp_msgbuf[msgbuf_idx].get_data_size() == FLAGS_msg_size);
+
+  c->num_resps++;
+  c->num_in_flight--;
+  if (!c->draining) send_req(*c, msgbuf_idx);
+}
+
+void client_func(erpc::Nexus *nexus) {
+  ClientContext c;
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c), 0,
+                                  basic_sm_handler);
+
+  rpc.retry_connect_on_invalid_rpc_id = true;
+  c.rpc = &rpc;
+
+  c.req_msgbuf.resize(FLAGS_max_req_window);
+  c.resp_msgbuf.resize(FLAGS_max_req_window);
+  for (size_t i = 0; i < FLAGS_max_req_window; i++) {
+    c.req_msgbuf[i] = rpc.alloc_msg_buffer_or_die(FLAGS_msg_size);
+    c.resp_msgbuf[i] = rpc.alloc_msg_buffer_or_die(FLAGS_msg_size);
+  }
+
+  printf("req_window Mrps\n");
+
+  // Sessions of earlier steps stay connected but idle
+  for (size_t req_window = 1; req_window <= FLAGS_max_req_window;
+       req_window *= 2) {
+    int session_num = rpc.create_session(uris[0], 0 /* tid */, req_window);
+    erpc::rt_assert(session_num >= 0, "Failed to create session");
+    c.session_num_vec.push_back(session_num);
+
+    while (c.num_sm_resps != c.session_num_vec.size()) {
+      rpc.run_event_loop(kAppEvLoopMs);
+      if (unlikely(ctrl_c_pressed == 1)) return;
+    }
+
+    for (size_t i = 0; i < req_window; i++) send_req(c, i);
+
+    rpc.run_event_loop(kAppEvLoopMs);  // Warm up
+    c.num_resps = 0;
+    rpc.run_event_loop(FLAGS_test_ms);
+    if (ctrl_c_pressed == 1) break;
+    printf("%zu %.2f\n", req_window, c.num_resps / (FLAGS_test_ms * 1000.0));
+
+    // Let the msgbufs free up for the next step
+    c.draining = true;
+    while (c.num_in_flight > 0) rpc.run_event_loop_once();
+    c.draining = false;
+  }
+}
+
+int main(int argc, char **argv) {
+  signal(SIGINT, ctrl_c_handler);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  erpc::rt_assert(
+      erpc::is_power_of_two(FLAGS_max_req_window) &&
+          FLAGS_max_req_window <= erpc::kSessionMaxReqWindow,
+      "Invalid max request window");
+
+  erpc::Nexus nexus(uris[FLAGS_process_id], 0, 0);
+  nexus.register_req_func(kAppReqType, req_handler);
+
+  auto t =
+      std::thread(FLAGS_process_id == 0 ? server_func : client_func, &nexus);
+  erpc::bind_to_core(t, 0, 0);
+  t.join();
+}
@@ -184,7 +184,7 @@ void req_handler(erpc::ReqHandle *req_handle, void *_context) {
     }
     c->rpc->enqueue_response(req_handle, &req_handle->dyn_resp_msgbuf);
   } else {
-    erpc::Rpc::resize_msg_buffer(&req_handle->pre_resp_msgbuf,
+    erpc::Rpc<erpc::CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf,
                                                    FLAGS_msg_size);
 
     if (!kAppPayloadCheck) {
@@ -362,7 +362,7 @@ void thread_func(size_t thread_id, app_stats_t *app_stats, erpc::Nexus *nexus) {
   // erpc::rt_assert(port_vec.size() > 0);
   // uint8_t phy_port = port_vec.at(thread_id % port_vec.size());
 
-  erpc::Rpc rpc(nexus, static_cast<void *>(&c),
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c),
                                   static_cast<uint8_t>(thread_id),
                                   basic_sm_handler);
 
@@ -153,11 +153,16 @@ void client_req_handler(erpc::ReqHandle *req_handle, void *_context) {
 }
 
 void init_erpc(AppContext *c, erpc::Nexus *nexus) {
+  // Raft's RPCs must not wait behind client requests, or followers may miss
+  // heartbeats and start elections under load
   nexus->register_req_func(static_cast<uint8_t>(ReqType::kRequestVote),
-                           requestvote_handler);
+                           requestvote_handler, erpc::ReqFuncType::kForeground,
+                           erpc::ReqPriority::kHigh);
 
   nexus->register_req_func(static_cast<uint8_t>(ReqType::kAppendEntries),
-                           appendentries_handler);
+                           appendentries_handler,
+                           erpc::ReqFuncType::kForeground,
+                           erpc::ReqPriority::kHigh);
 
   nexus->register_req_func(static_cast<uint8_t>(ReqType::kClientReq),
                            client_req_handler);
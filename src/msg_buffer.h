@@ -2,6 +2,7 @@
 
 #include "common.h"
 #include "pkthdr.h"
+#include "rpc_types.h"
 #include "util/buffer.h"
 #include "util/math_utils.h"
 
@@ -24,6 +25,7 @@ class Session;
  */
 class MsgBuffer {
   friend class Transport;
+  template <class T>
   friend class Rpc;
   friend class Session;
 
@@ -125,6 +127,20 @@ class MsgBuffer {
    */
   inline size_t get_data_size() const { return data_size; }
 
+  /**
+   * Return the outcome of the request that this response message buffer
+   * belongs to. This is valid in the request's continuation.
+   */
+  inline RespStatus get_resp_status() const { return resp_status; }
+
+  /**
+   * Return true iff this response message buffer holds a response chunk that
+   * is followed by more chunks. See Rpc::enqueue_response_chunk().
+   */
+  inline bool has_more_chunks() const {
+    return resp_status == RespStatus::kOk && get_pkthdr_0()->more_chunks == 1;
+  }
+
  private:
   /// The optional backing hugepage buffer. buffer.buf points to the zeroth
   /// packet header, i.e., not application data.
@@ -136,6 +152,10 @@ class MsgBuffer {
   size_t max_num_pkts;   ///< Max number of packets in this MsgBuffer
   size_t num_pkts;       ///< Current number of packets in this MsgBuffer
 
+  /// The outcome of the request, set in response MsgBuffers before the
+  /// continuation is invoked
+  RespStatus resp_status;
+
  public:
   /// Pointer to the first application data byte. The message buffer is invalid
   /// invalid if this is null.
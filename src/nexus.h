@@ -1,13 +1,14 @@
 #pragma once
 
 #include <unistd.h>
+#include <memory>
 #include <unordered_map>
 #include "common.h"
 #include "heartbeat_mgr.h"
 #include "session.h"
 #include "sm_types.h"
 #include "util/logger.h"
-#include "util/mt_queue.h"
+#include "util/mpsc_queue.h"
 #include "util/tls_registry.h"
 
 namespace erpc {
@@ -16,6 +17,7 @@ namespace erpc {
  * @brief A per-process library object used for initializing eRPC
  */
 class Nexus {
+  template <class T>
   friend class Rpc;
 
   /**
@@ -42,10 +44,39 @@ class Nexus {
    * @brief Register application-defined request handler function. This
    * must be done before any Rpc registers a hook with the Nexus.
    *
+   * @param req_priority The priority class of this request type. Processes
+   * that send requests of a high-priority type must also register it.
+   *
    * @return 0 on success, negative errno on failure.
    */
   int register_req_func(uint8_t req_type, erpc_req_func_t req_func,
-                        ReqFuncType req_func_type = ReqFuncType::kForeground);
+                        ReqFuncType req_func_type = ReqFuncType::kForeground,
+                        ReqPriority req_priority = ReqPriority::kNormal);
+
+  /**
+   * @brief Register a streaming request handler. \p req_chunk_func receives
+   * the request's data in order while the rest is still in flight, and
+   * \p req_func runs in the foreground when the request is complete. This
+   * must be done before any Rpc registers a hook with the Nexus.
+   *
+   * @return 0 on success, negative errno on failure.
+   */
+  int register_streaming_req_func(
+      uint8_t req_type, erpc_req_chunk_func_t req_chunk_func,
+      erpc_req_func_t req_func,
+      ReqPriority req_priority = ReqPriority::kNormal);
+
+  /**
+   * @brief Register a batched request handler. \p req_batch_func runs in the
+   * foreground once per RX batch, with all requests of this type that
+   * completed in the batch. This must be done before any Rpc registers a
+   * hook with the Nexus.
+   *
+   * @return 0 on success, negative errno on failure.
+   */
+  int register_batch_req_func(uint8_t req_type,
+                              erpc_req_batch_func_t req_batch_func,
+                              ReqPriority req_priority = ReqPriority::kNormal);
 
  private:
   enum class BgWorkItemType : bool { kReq, kResp };
@@ -89,17 +120,31 @@ class Nexus {
     bool is_req() const { return wi_type == BgWorkItemType::kReq; }
   };
 
+  /// Capacity of each background thread's request queue. Rpcs wait while the
+  /// queue is full.
+  static constexpr size_t kBgReqQueueSize = 4096;
+
+  /// Work items that a background thread takes from its queue at a time
+  static constexpr size_t kBgPopBatch = 16;
+
+  /// Capacity of an Rpc's session management RX queue. The SM thread drops
+  /// packets for an Rpc whose queue is full. Session management requests are
+  /// retried on timeout, so this is like a packet loss.
+  static constexpr size_t kSmRxQueueSize = 1024;
+
+  typedef MpscQueue<BgWorkItem, kBgReqQueueSize> BgReqQueue;
+
   /// A hook created by an Rpc thread, and shared with the Nexus
   class Hook {
    public:
     uint8_t rpc_id;  ///< ID of the Rpc that created this hook
 
     /// Background thread request queues, installed by the Nexus
-    MtQueue<BgWorkItem> *bg_req_queue_arr[kMaxBgThreads] = {nullptr};
+    BgReqQueue *bg_req_queue_arr[kMaxBgThreads] = {nullptr};
 
     /// The Rpc thread's session management RX queue, installed by the Rpc.
     /// Work items from the SM thread for this Rpc are queued here.
-    MtQueue<SmWorkItem> sm_rx_queue;
+    MpscQueue<SmWorkItem, kSmRxQueueSize> sm_rx_queue;
   };
 
   /// Check if a hook with for rpc_id exists in this Nexus. The caller must not
@@ -112,6 +157,16 @@ class Nexus {
   /// Unregister a previously registered session management hook
   void unregister_hook(Hook *hook);
 
+  /// Publish the in-process channel region that a client Rpc created for the
+  /// session with this token
+  void offer_loopback_region(conn_req_uniq_token_t uniq_token,
+                             std::shared_ptr<uint8_t> region);
+
+  /// Remove and return the in-process channel region offered for the session
+  /// with this token, or nullptr if there is none
+  std::shared_ptr<uint8_t> take_loopback_region(
+      conn_req_uniq_token_t uniq_token);
+
   /// Background thread context
   class BgThreadCtx {
    public:
@@ -123,9 +178,9 @@ class Nexus {
     /// functions are registered.
     std::array<ReqFunc, kReqTypeArraySize> *req_func_arr;
 
-    TlsRegistry *tls_registry;          ///< The Nexus's thread-local registry
-    size_t bg_thread_index;             ///< Index of this background thread
-    MtQueue<BgWorkItem> *bg_req_queue;  ///< Background thread request queue
+    TlsRegistry *tls_registry;  ///< The Nexus's thread-local registry
+    size_t bg_thread_index;     ///< Index of this background thread
+    BgReqQueue *bg_req_queue;   ///< Background thread request queue
   };
 
   /// Session management thread context
@@ -171,11 +226,16 @@ class Nexus {
   Hook *reg_hooks_arr[kMaxRpcId + 1] = {nullptr};
   std::mutex reg_hooks_lock;  ///< Lock for concurrent access to the hooks array
 
+  /// In-process channel regions offered by client Rpcs, by session token
+  std::unordered_map<conn_req_uniq_token_t, std::shared_ptr<uint8_t>>
+      loopback_regions;
+  std::mutex loopback_regions_lock;
+
   HeartbeatMgr heartbeat_mgr;  ///< The heartbeat manager
   volatile bool kill_switch;   ///< Used to turn off SM and background threads
 
   std::thread sm_thread;  ///< The session management thread
-  MtQueue<BgWorkItem> bg_req_queue[kMaxBgThreads];  ///< Background req queues
+  BgReqQueue bg_req_queue[kMaxBgThreads];    ///< Background req queues
   std::thread bg_thread_arr[kMaxBgThreads];  ///< Background thread context
 };
 }  // namespace erpc
@@ -124,8 +124,26 @@ void Nexus::unregister_hook(Hook *hook) {
   reg_hooks_lock.unlock();
 }
 
+void Nexus::offer_loopback_region(conn_req_uniq_token_t uniq_token,
+                                  std::shared_ptr<uint8_t> region) {
+  std::lock_guard<std::mutex> lock(loopback_regions_lock);
+  loopback_regions[uniq_token] = std::move(region);
+}
+
+std::shared_ptr<uint8_t> Nexus::take_loopback_region(
+    conn_req_uniq_token_t uniq_token) {
+  std::lock_guard<std::mutex> lock(loopback_regions_lock);
+  auto it = loopback_regions.find(uniq_token);
+  if (it == loopback_regions.end()) return nullptr;
+
+  std::shared_ptr<uint8_t> region = std::move(it->second);
+  loopback_regions.erase(it);
+  return region;
+}
+
 int Nexus::register_req_func(uint8_t req_type, erpc_req_func_t req_func,
-                             ReqFuncType req_func_type) {
+                             ReqFuncType req_func_type,
+                             ReqPriority req_priority) {
   char issue_msg[kMaxIssueMsgLen];  // The basic issue message
   sprintf(issue_msg,
           "eRPC Nexus: Failed to register handlers for request type %u. Issue",
@@ -154,7 +172,55 @@ int Nexus::register_req_func(uint8_t req_type, erpc_req_func_t req_func,
     return -EPERM;
   }
 
-  arr_req_func = ReqFunc(req_func, req_func_type);
+  arr_req_func = ReqFunc(req_func, req_func_type, req_priority);
+  return 0;
+}
+
+int Nexus::register_streaming_req_func(uint8_t req_type,
+                                       erpc_req_chunk_func_t req_chunk_func,
+                                       erpc_req_func_t req_func,
+                                       ReqPriority req_priority) {
+  if (req_chunk_func == nullptr) {
+    ERPC_WARN(
+        "eRPC Nexus: Failed to register handlers for request type %u. Issue: "
+        "Invalid chunk handler.\n",
+        req_type);
+    return -EINVAL;
+  }
+
+  // Chunks are delivered in the dispatch thread, so the handler runs there too
+  int ret = register_req_func(req_type, req_func, ReqFuncType::kForeground,
+                              req_priority);
+  if (ret != 0) return ret;
+
+  req_func_arr[req_type].req_chunk_func = req_chunk_func;
+  return 0;
+}
+
+int Nexus::register_batch_req_func(uint8_t req_type,
+                                   erpc_req_batch_func_t req_batch_func,
+                                   ReqPriority req_priority) {
+  char issue_msg[kMaxIssueMsgLen];  // The basic issue message
+  sprintf(issue_msg,
+          "eRPC Nexus: Failed to register handlers for request type %u. Issue",
+          req_type);
+
+  if (!req_func_registration_allowed) {
+    ERPC_WARN("%s: Registration not allowed anymore.\n", issue_msg);
+    return -EPERM;
+  }
+
+  if (req_func_arr[req_type].is_registered()) {
+    ERPC_WARN("%s: Handler for this request type already exists.\n", issue_msg);
+    return -EEXIST;
+  }
+
+  if (req_batch_func == nullptr) {
+    ERPC_WARN("%s: Invalid batched handler.\n", issue_msg);
+    return -EINVAL;
+  }
+
+  req_func_arr[req_type] = ReqFunc(req_batch_func, req_priority);
   return 0;
 }
 }  // namespace erpc
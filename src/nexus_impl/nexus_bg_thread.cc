@@ -2,7 +2,7 @@
 #include "nexus.h"
 #include "rpc_types.h"
 #include "session.h"
-#include "util/mt_queue.h"
+#include "util/mpsc_queue.h"
 
 namespace erpc {
 
@@ -15,14 +15,16 @@ void Nexus::bg_thread_func(BgThreadCtx ctx) {
   ERPC_INFO("eRPC Nexus: Background thread %zu running. Tiny TID = %zu.\n",
             ctx.bg_thread_index, ctx.tls_registry->get_etid());
 
+  BgWorkItem wi_batch[kBgPopBatch];
   while (*ctx.kill_switch == false) {
-    if (ctx.bg_req_queue->size == 0) {
+    const size_t num_wi = ctx.bg_req_queue->pop_batch(wi_batch, kBgPopBatch);
+    if (num_wi == 0) {
       // TODO: Put bg thread to sleep if it's idle for a long time
       continue;
     }
 
-    while (ctx.bg_req_queue->size > 0) {
-      BgWorkItem wi = ctx.bg_req_queue->unlocked_pop();
+    for (size_t i = 0; i < num_wi; i++) {
+      const BgWorkItem &wi = wi_batch[i];
 
       if (wi.is_req()) {
         SSlot *s = wi.sslot;  // For requests, we have a valid sslot
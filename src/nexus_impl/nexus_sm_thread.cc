@@ -33,8 +33,13 @@ void Nexus::sm_thread_func(SmThreadCtx ctx) {
       Hook *target_hook = const_cast<Hook *>(ctx.reg_hooks_arr[target_rpc_id]);
 
       if (target_hook != nullptr) {
-        target_hook->sm_rx_queue.unlocked_push(
-            SmWorkItem(target_rpc_id, sm_pkt));
+        if (!target_hook->sm_rx_queue.try_push(
+                SmWorkItem(target_rpc_id, sm_pkt))) {
+          ERPC_WARN(
+              "eRPC Nexus: Session management queue of Rpc %u is full. "
+              "Dropping packet %s.\n",
+              target_rpc_id, sm_pkt.to_string().c_str());
+        }
       } else {
         // We don't have an Rpc object for the target Rpc. Send an error
         // response iff it's a request packet.
@@ -4,13 +4,14 @@
 
 namespace erpc {
 
-static constexpr size_t kMsgSizeBits = 34;  ///< Bits for message size
+static constexpr size_t kMsgSizeBits = 28;  ///< Bits for message size
 static constexpr size_t kReqNumBits = 44;   ///< Bits for request number
-static constexpr size_t kPktNumBits = 20;   ///< Bits for packet number
+static constexpr size_t kPktNumBits = 18;   ///< Bits for packet number
+static constexpr size_t kSackBits = 48;     ///< Bits for the SACK bitmap
 
-/// Debug bits for packet header. Also useful for making the total size of all
-/// pkthdr_t bitfields equal to 128 bits, which makes copying faster.
-static const size_t kPktHdrMagicBits = 128 - (8 + kMsgSizeBits + 16 + 2 + kPktNumBits + kReqNumBits);
+/// Debug bits for packet header. Also useful for making the total size of the
+/// first two words of pkthdr_t bitfields equal to 128 bits.
+static const size_t kPktHdrMagicBits = 128 - (8 + 8 + kMsgSizeBits + 16 + 2 + kPktNumBits + kReqNumBits);
 static constexpr size_t kPktHdrMagic = 11;  ///< Magic number for packet headers
 
 static_assert(kPktHdrMagicBits == 4, "");  // Just to keep track
@@ -38,6 +39,7 @@ static std::string pkt_type_str(uint64_t pkt_type) {
 
 struct pkthdr_t {
   uint64_t req_type : 8;             ///< RPC request type
+  uint64_t dest_rpc_id : 8;          ///< Destination Rpc ID. See kPktHdrDestRpcIdOffset.
   uint64_t msg_size : kMsgSizeBits;  ///< Req/resp msg size, excluding headers
   uint64_t dest_session_num : 16;    ///< Destination session number
   uint64_t pkt_type : 2;             ///< The packet type
@@ -47,6 +49,30 @@ struct pkthdr_t {
   uint64_t req_num : kReqNumBits;
   uint64_t magic : kPktHdrMagicBits;  ///< Magic from alloc_msg_buffer()
 
+  /// Credits that the server lends to the session. Set only in server-to-client
+  /// packets.
+  uint64_t credit_grant : 8;
+
+  /// Selective ack bitmap, set only in explicit credit returns. Bit i is set
+  /// iff the server has received request packet (pkt_num - kSackBits + i).
+  /// Request packets carry the request's time budget here instead; see
+  /// get_budget_us().
+  uint64_t sack : kSackBits;
+
+  /// Set in a client's cancellation notice for a request. These notices are
+  /// RFR packets that the server doesn't answer.
+  uint64_t cancel : 1;
+
+  /// Set in response packets of a response chunk that is not the last one.
+  /// See Rpc::enqueue_response_chunk().
+  uint64_t more_chunks : 1;
+
+  /// Set in an explicit credit return that the server sent in a later event
+  /// loop iteration than the one that received pkt_num. The client doesn't
+  /// take an RTT sample from it.
+  uint64_t delayed : 1;
+  uint64_t reserved : 5;  ///< Unused
+
   /// Fill in packet header fields
   void format(uint64_t _req_type, uint64_t _msg_size,
               uint64_t _dest_session_num, uint64_t _pkt_type, uint64_t _pkt_num,
@@ -68,16 +94,28 @@ struct pkthdr_t {
   std::string to_string() const {
     std::ostringstream ret;
     ret << "[type " << pkt_type_str(pkt_type) << ", "
+        << "drpc " << std::to_string(dest_rpc_id) << ", "
         << "dsn " << std::to_string(dest_session_num) << ", "
         << "reqn " << std::to_string(req_num) << ", "
         << "pktn " << std::to_string(pkt_num) << ", "
-        << "msz " << std::to_string(msg_size) << "]";
+        << "msz " << std::to_string(msg_size) << ", "
+        << "crd " << std::to_string(credit_grant) << "]";
 
     return ret.str();
   }
 
   inline bool check_magic() const { return magic == kPktHdrMagic; }
 
+  /// Return the time budget that the client gave a request, in microseconds
+  /// from when the client enqueued it, or zero if the request has no deadline.
+  /// This is valid only in request packets.
+  inline size_t get_budget_us() const { return sack; }
+
+  /// Set the time budget of a request packet
+  inline void set_budget_us(size_t budget_us) {
+    sack = std::min(budget_us, static_cast<size_t>((1ull << kSackBits) - 1));
+  }
+
   inline bool is_req() const { return pkt_type == kPktTypeReq; }
   inline bool is_rfr() const { return pkt_type == kPktTypeRFR; }
   inline bool is_resp() const { return pkt_type == kPktTypeResp; }
@@ -86,4 +124,9 @@ struct pkthdr_t {
 } __attribute__((packed));
 
 static_assert(sizeof(pkthdr_t) % sizeof(size_t) == 0, "");
+
+/// Byte offset of pkthdr_t::dest_rpc_id in a packet. The kernel steers
+/// packets arriving at a shared datapath port with a program that reads this
+/// byte, so the field must stay byte-aligned here.
+static constexpr size_t kPktHdrDestRpcIdOffset = 1;
 }  // namespace erpc
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include <set>
 #include "cc/timing_wheel.h"
 #include "common.h"
@@ -7,13 +8,15 @@
 #include "nexus.h"
 #include "pkthdr.h"
 #include "rpc_types.h"
+#include "rto_wheel.h"
 #include "session.h"
-#include "transport.h"
+#include "transport_impl/udp/udp_transport.h"
+#include "transport_impl/uring/uring_transport.h"
 #include "util/buffer.h"
 #include "util/fixed_queue.h"
 #include "util/std_alloc.h"
 #include "util/logger.h"
-#include "util/mt_queue.h"
+#include "util/mpsc_queue.h"
 #include "util/rand.h"
 #include "util/timer.h"
 #include "util/udp_client.h"
@@ -65,7 +68,11 @@ namespace erpc {
  * eRPC's worker (background) threads have limited; concurrent access to Rpc
  * objects. The functions with the _st can be called from only the foreground
  * thread that owns the Rpc object.
+ *
+ * @tparam TTransport The unreliable transport, e.g., UDPTransport. See
+ * Transport for the functions that a transport must provide.
  */
+template <class TTransport>
 class Rpc {
   friend class RpcTest;
 
@@ -73,11 +80,26 @@ class Rpc {
   /// Timeout for a session management request in milliseconds
   static constexpr size_t kSMTimeoutMs = kTesting ? 10 : 100;
 
+  /// Packets between the stages of the software-pipelined RX loop. See
+  /// process_comps_st().
+  static constexpr size_t kRxPrefetchDist = 2;
+
+  /// Capacity of each queue of datapath API calls from background threads.
+  /// Background threads wait while the queue is full.
+  static constexpr size_t kBgQueueSize = 4096;
+
+  /// Calls from each background queue processed per event loop iteration
+  static constexpr size_t kBgQueuePopBatch = 64;
+
+  /// Most chunks of a response that may wait for the client to pull them. See
+  /// enqueue_response_chunk().
+  static constexpr size_t kMaxRespChunks = 16;
+
  public:
   /// Max request or response *data* size, i.e., excluding packet headers
   static constexpr size_t kMaxMsgSize = 1024 * 1024 * 128; // FIXME
   static_assert((1LL << kMsgSizeBits) >= kMaxMsgSize, "");
-  static_assert((1LL << kPktNumBits) * Transport::kMaxDataPerPkt > 2 * kMaxMsgSize, "");
+  static_assert((1LL << kPktNumBits) * TTransport::kMaxDataPerPkt > 2 * kMaxMsgSize, "");
 
   /**
    * @brief Construct the Rpc object
@@ -185,9 +207,18 @@ class Rpc {
    * so it won't work in create_session.
    *
    * @param rem_rpc_id The ID of the remote Rpc object
+   *
+   * @param req_window The number of requests that the session can have
+   * outstanding. This must be a power of two up to kSessionMaxReqWindow. The
+   * server may grant a smaller window.
+   *
+   * @param credits The number of packets that the session can have in flight,
+   * up to kSessionCredits. The server may grant fewer credits.
    */
-  int create_session(std::string remote_uri, uint8_t rem_rpc_id) {
-    return create_session_st(remote_uri, rem_rpc_id);
+  int create_session(std::string remote_uri, uint8_t rem_rpc_id,
+                     size_t req_window = kSessionReqWindow,
+                     size_t credits = kSessionCredits) {
+    return create_session_st(remote_uri, rem_rpc_id, req_window, credits);
   }
 
   /**
@@ -232,10 +263,51 @@ class Rpc {
    * continuation on. The default value of \p kInvalidBgETid means that the
    * continuation runs in the foreground. This argument is meant only for
    * internal use by eRPC (i.e., user calls must ignore it).
+   *
+   * @param deadline_tsc The TSC at which the request fails with
+   * RespStatus::kTimedOut, or zero for no deadline. This argument is meant
+   * only for internal use by eRPC; see enqueue_request_with_timeout().
    */
   void enqueue_request(int session_num, uint8_t req_type, MsgBuffer *req_msgbuf,
                        MsgBuffer *resp_msgbuf, erpc_cont_func_t cont_func,
-                       void *tag, size_t cont_etid = kInvalidBgETid);
+                       void *tag, size_t cont_etid = kInvalidBgETid,
+                       size_t deadline_tsc = 0);
+
+  /**
+   * @brief Identical to enqueue_request(), but the request fails if its
+   * response is not received within \p timeout_us microseconds. The
+   * continuation of a failed request sees a zero-size response whose
+   * get_resp_status() is RespStatus::kTimedOut. The session stays connected.
+   *
+   * The timeout is also sent to the server, which drops work for requests
+   * that the client has given up on. The deadline of a request waiting for a
+   * free session slot is checked only when it gets a slot.
+   */
+  inline void enqueue_request_with_timeout(int session_num, uint8_t req_type,
+                                           MsgBuffer *req_msgbuf,
+                                           MsgBuffer *resp_msgbuf,
+                                           erpc_cont_func_t cont_func,
+                                           void *tag, size_t timeout_us) {
+    enqueue_request(session_num, req_type, req_msgbuf, resp_msgbuf, cont_func,
+                    tag, kInvalidBgETid,
+                    rdtsc() + us_to_cycles(timeout_us, freq_ghz));
+  }
+
+  /**
+   * @brief Cancel an outstanding request. Its continuation is invoked with a
+   * zero-size response whose get_resp_status() is RespStatus::kCancelled,
+   * either before this returns or, if some of its packets are still paced in
+   * the timing wheel, once they leave the wheel. The server is told to drop
+   * the request's state. This can be called only from the creator thread.
+   *
+   * @param session_num The session that the request was enqueued on
+   * @param tag The tag of the request. If several outstanding requests on the
+   * session have this tag, one of them is cancelled.
+   *
+   * @return True if a request was cancelled, false if no outstanding request
+   * on this session has this tag
+   */
+  bool cancel_request(int session_num, void *tag);
 
   /**
    * @brief Enqueue a response for transmission at the server. This must
@@ -262,6 +334,32 @@ class Rpc {
    */
   void enqueue_response(ReqHandle *req_handle, MsgBuffer *resp_msgbuf);
 
+  /**
+   * @brief Enqueue a chunk of a response that is sent in several chunks. The
+   * handler may call this several times, and then calls enqueue_response()
+   * with the final chunk. The client's continuation is invoked for every
+   * chunk, with resp_msgbuf->has_more_chunks() set for all but the final one.
+   * This function is safe to call from background threads (TS).
+   *
+   * The first chunk is sent right away. The client asks for each later chunk
+   * only after the continuation for the previous one returns, so a slow client
+   * doesn't get overrun. Up to kMaxRespChunks chunks that the client hasn't
+   * asked for yet wait at the server.
+   *
+   * The request MsgBuffer stays valid until the final enqueue_response().
+   *
+   * @param req_handle The handle passed to the request handler by eRPC
+   *
+   * @param chunk_msgbuf A MsgBuffer allocated with alloc_msg_buffer(). eRPC
+   * takes ownership of its memory, and frees it after the client receives it.
+   * The chunk must fit in the client's response buffer.
+   *
+   * @return True if the chunk is enqueued. False if kMaxRespChunks chunks
+   * already wait; the caller keeps ownership of the chunk, and may retry after
+   * the client pulls more chunks.
+   */
+  bool enqueue_response_chunk(ReqHandle *req_handle, MsgBuffer *chunk_msgbuf);
+
   /// Run the event loop for some milliseconds
   inline void run_event_loop(size_t timeout_ms) {
     run_event_loop_timeout_st(timeout_ms);
@@ -337,7 +435,7 @@ class Rpc {
 
   /// Return the maximum *data* size in one packet for the (private) transport
   static inline constexpr size_t get_max_data_per_pkt() {
-    return Transport::kMaxDataPerPkt;
+    return TTransport::kMaxDataPerPkt;
   }
 
   /// Return the hostname of the remote endpoint for a connected session
@@ -345,9 +443,10 @@ class Rpc {
     return session_vec[static_cast<size_t>(session_num)]->get_remote_hostname();
   }
 
-  /// Return the maximum number of sessions supported
+  /// Return the maximum number of sessions supported. Session numbers are not
+  /// reused, so this bounds the number of sessions ever created.
   static inline constexpr size_t get_max_num_sessions() {
-    return Transport::kNumRxRingEntries / kSessionCredits;
+    return kInvalidSessionNum;
   }
 
   /// Return the data size in bytes that can be sent in one request or response
@@ -382,9 +481,17 @@ class Rpc {
     return dpath_stats.pkts_tx * 1.0 / dpath_stats.tx_burst_calls;
   }
 
+  /// Return the number of system calls made by the transport's datapath
+  size_t get_num_dpath_syscalls() const {
+    if (!kDatapathStats) return 0;
+    return transport->dpath_stats.syscalls;
+  }
+
   /// Reset all datapath stats to zero
   void reset_dpath_stats() {
     memset(reinterpret_cast<void *>(&dpath_stats), 0, sizeof(dpath_stats));
+    memset(reinterpret_cast<void *>(&transport->dpath_stats), 0,
+           sizeof(transport->dpath_stats));
   }
 
   /**
@@ -400,7 +507,8 @@ class Rpc {
   void fault_inject_set_pkt_drop_prob_st(double pkt_drop_prob);
 
  private:
-  int create_session_st(std::string remote_uri, uint8_t rem_rpc_id);
+  int create_session_st(std::string remote_uri, uint8_t rem_rpc_id,
+                        size_t req_window, size_t credits);
   int destroy_session_st(int session_num);
   size_t num_active_sessions_st();
 
@@ -448,6 +556,20 @@ class Rpc {
   // free their backing memory.
   //
 
+  /// Release \p n chunks counted in resp_chunks_waiting
+  static inline void release_resp_chunks(SSlot *sslot, size_t n) {
+    __atomic_sub_fetch(&sslot->server_info.resp_chunks_waiting, n,
+                       __ATOMIC_RELAXED);
+  }
+
+  /// Free the response chunks that wait in a server sslot's resp_chunk_q
+  inline void free_waiting_resp_chunks_st(SSlot *sslot) {
+    auto &si = sslot->server_info;
+    for (MsgBuffer &chunk : *si.resp_chunk_q) free_msg_buffer(chunk);
+    release_resp_chunks(sslot, si.resp_chunk_q->size());
+    si.resp_chunk_q->clear();
+  }
+
   /**
    * @brief Bury a server sslot's response MsgBuffer (i.e., sslot->tx_msgbuf).
    * This is done in the foreground thread after receiving a packet for the
@@ -461,12 +583,27 @@ class Rpc {
 
     // Free the response MsgBuffer iff it's the dynamically allocated response.
     // This high-specificity checks prevents freeing a null tx_msgbuf.
-    if (sslot->tx_msgbuf == &sslot->dyn_resp_msgbuf) {
+    if (sslot->tx_msgbuf == &sslot->dyn_resp_msgbuf ||
+        sslot->tx_msgbuf == &sslot->server_info.resp_chunk) {
       MsgBuffer *tx_msgbuf = sslot->tx_msgbuf;
       free_msg_buffer(*tx_msgbuf);
       // Need not nullify tx_msgbuf->buffer.buf: we'll just nullify tx_msgbuf
     }
 
+    // Free the unsent rest of a chunked response
+    auto &si = sslot->server_info;
+    if (unlikely(si.resp_chunk_q != nullptr)) {
+      free_waiting_resp_chunks_st(sslot);
+      delete si.resp_chunk_q;
+      si.resp_chunk_q = nullptr;
+
+      if (si.resp_final == &sslot->dyn_resp_msgbuf &&
+          sslot->tx_msgbuf != si.resp_final) {
+        free_msg_buffer(*si.resp_final);
+      }
+      si.resp_final = nullptr;
+    }
+
     sslot->tx_msgbuf = nullptr;
   }
 
@@ -488,56 +625,119 @@ class Rpc {
   }
 
   //
-  // Handle available ring entries
+  // Credit pool
   //
 
-  /// Return true iff there are sufficient ring entries available for a session
-  bool have_ring_entries() const {
-    return ring_entries_available >= kSessionCredits;
-  }
-
-  /// Allocate ring entries for one session
-  void alloc_ring_entries() {
-    assert(have_ring_entries());
-    ring_entries_available -= kSessionCredits;
+  /// Lend pool credits to a server session whose client is sending, so that
+  /// the next packets to the client grant them
+  inline void lend_credits_st(Session *session) {
+    auto &si = session->server_info;
+    si.active = true;
+    if (likely(si.credits == session->max_credits) || credit_pool == 0) return;
+
+    if (si.credits == kSessionMinCredits) credit_borrowers.push_back(session);
+    const size_t lend = std::min(session->max_credits - si.credits, credit_pool);
+    si.credits += lend;
+    credit_pool -= lend;
   }
 
-  /// Free ring entries allocated for one session
-  void free_ring_entries() {
-    ring_entries_available += kSessionCredits;
-    assert(ring_entries_available <= Transport::kNumRxRingEntries);
+  /// Take back the lent credits of server sessions that were idle for a whole
+  /// credit scan epoch
+  void reclaim_credits_st();
+
+  /// Return a server session's lent credits to the pool
+  void return_lent_credits_st(Session *session);
+
+  /// Change the credit limit of a client session. When the limit drops below
+  /// the packets in flight, the excess credits are dropped as they return.
+  static inline void set_credit_limit(Session *session, size_t credit_limit) {
+    auto &ci = session->client_info;
+    if (credit_limit > ci.credit_limit) {
+      ci.credits += credit_limit - ci.credit_limit;
+    } else {
+      ci.credits -= std::min(ci.credits, ci.credit_limit - credit_limit);
+    }
+    ci.credit_limit = credit_limit;
   }
 
   //
   // Datapath helpers
   //
 
-  /// Convert a response packet's wire protocol packet number (pkt_num) to its
-  /// index in the response MsgBuffer
-  static inline size_t resp_ntoi(size_t pkt_num, size_t num_req_pkts) {
-    return pkt_num - (num_req_pkts - 1);
-  }
-
-  /// Return true iff a packet received by a client is in order. This must be
-  /// only a few instructions.
-  inline size_t in_order_client(const SSlot *sslot, const pkthdr_t *pkthdr) {
+  /// Return true iff a packet received by a client answers a packet that the
+  /// client has sent, and that was not answered before. This must be only a
+  /// few instructions.
+  inline bool fresh_reply_client(const SSlot *sslot, const pkthdr_t *pkthdr) {
     // Counters for pkthdr's request number are valid only if req numbers match
     if (unlikely(pkthdr->req_num != sslot->cur_req_num)) return false;
 
-    const auto &ci = sslot->client_info;
-    if (unlikely(pkthdr->pkt_num != ci.num_rx)) return false;
+    // Ignore replies for a completed, cancelled, or timed-out request
+    if (unlikely(sslot->tx_msgbuf == nullptr)) return false;
 
-    // Ignore spurious packets received as a consequence of rollback:
-    // 1. We've only sent pkts up to (ci.num_tx - 1). Ignore later packets.
-    // 2. Ignore if the corresponding client packet for pkthdr is still in wheel
-    if (unlikely(pkthdr->pkt_num >= ci.num_tx)) return false;
+    // Ignore replies for a failing request that waits for the wheel
+    const auto &ci = sslot->client_info;
+    if (unlikely(ci.fail_status != RespStatus::kOk)) return false;
 
-    if (kCcPacing && unlikely(ci.in_wheel[pkthdr->pkt_num % kSessionCredits])) {
-      pkt_loss_stats.still_in_wheel_during_retx++;
+    // Ignore replies to packets that we haven't sent, and duplicate replies
+    if (unlikely(pkthdr->pkt_num < ci.ack_base || pkthdr->pkt_num >= ci.num_tx)) {
       return false;
     }
+    return ((ci.ack_bitmap >> (pkthdr->pkt_num - ci.ack_base)) & 1) == 0;
+  }
 
-    return true;
+  /// Return a mask with the lowest \p n bits set
+  static inline uint64_t low_bits(size_t n) {
+    return n >= 64 ? ~0ull : (1ull << n) - 1;
+  }
+
+  /**
+   * @brief Mark client packets as answered, taking one credit back for each
+   * packet answered for the first time
+   *
+   * @param pkthdr The received packet that answers the packets
+   * @param mask The packets to mark. Bit i is packet (ack_base + i).
+   */
+  inline void ack_pkts_client(SSlot *sslot, const pkthdr_t *pkthdr,
+                              uint64_t mask) {
+    auto &ci = sslot->client_info;
+    mask &= ~ci.ack_bitmap;
+    const size_t num_acked = static_cast<size_t>(__builtin_popcountll(mask));
+    bump_credits(sslot->session, pkthdr, num_acked);
+    ci.num_rx += num_acked;
+    ci.ack_bitmap |= mask;
+    if (num_acked > 0) tx_wake_st(sslot->session);  // Credits returned
+
+    // Slide the window past the answered prefix
+    if (ci.ack_bitmap == ~0ull) {
+      ci.ack_base += 64;
+      ci.ack_bitmap = 0;
+    } else {
+      const size_t shift = static_cast<size_t>(__builtin_ctzll(~ci.ack_bitmap));
+      ci.ack_base += shift;
+      ci.ack_bitmap >>= shift;
+    }
+  }
+
+  /// Forget the sslot's pending explicit CR, e.g., because the response
+  /// answers its packets
+  static inline void cancel_pending_cr_st(SSlot *sslot) {
+    auto &si = sslot->server_info;
+    sslot->session->server_info.cr_num_pkts -= si.cr_num_pkts;
+    si.cr_num_pkts = 0;
+  }
+
+  /// Return the SACK bitmap that the server sends in a credit return for
+  /// request packet \p pkt_num. See pkthdr_t::sack.
+  static inline uint64_t sack_bitmap_server(const SSlot *sslot,
+                                            size_t pkt_num) {
+    const auto &si = sslot->server_info;
+    if (pkt_num <= si.rx_base) return low_bits(kSackBits);
+
+    // Packets (pkt_num - kSackBits) and earlier than rx_base are received
+    const size_t n = pkt_num - si.rx_base;  // < kSessionCredits
+    if (n >= kSackBits) return (si.rx_bitmap >> (n - kSackBits)) & low_bits(kSackBits);
+    return ((si.rx_bitmap << (kSackBits - n)) | low_bits(kSackBits - n)) &
+           low_bits(kSackBits);
   }
 
   /**
@@ -547,8 +747,8 @@ class Rpc {
    * For \p data_size = 0, the return value need not be 0, i.e., it can be 1.
    */
   static size_t data_size_to_num_pkts(size_t data_size) {
-    if (data_size <= Transport::kMaxDataPerPkt) return 1;
-    return (data_size + Transport::kMaxDataPerPkt - 1) / Transport::kMaxDataPerPkt;
+    if (data_size <= TTransport::kMaxDataPerPkt) return 1;
+    return (data_size + TTransport::kMaxDataPerPkt - 1) / TTransport::kMaxDataPerPkt;
   }
 
   /// Return the total number of packets sent on the wire by one RPC endpoint.
@@ -563,9 +763,15 @@ class Rpc {
     return sslot->client_info.num_tx < sslot->tx_msgbuf->num_pkts;
   }
 
+  /// Return true iff requests of this type are in the high priority class
+  inline bool is_high_prio(uint8_t req_type) const {
+    return req_func_arr[req_type].req_priority == ReqPriority::kHigh;
+  }
+
   /// Return true iff it's currently OK to bypass the wheel for this request
   inline bool can_bypass_wheel(SSlot *sslot) const {
     if (!kCcPacing) return true;
+    if (is_high_prio(sslot->tx_msgbuf->get_pkthdr_0()->req_type)) return true;
     if (kTesting) return faults.hard_wheel_bypass;
     if (kCcOptWheelBypass) {
       // To prevent reordering, do not bypass the wheel if it contains packets
@@ -579,7 +785,7 @@ class Rpc {
   /// Complete transmission for all packets in the Rpc's TX batch and the
   /// transport's DMA queue
   void drain_tx_batch_and_dma_queue() {
-    if (tx_batch_i > 0) do_tx_burst_st();
+    if (tx_batch_i + tx_batch_hi_i > 0) do_tx_burst_st();
     transport->tx_flush();
   }
 
@@ -610,15 +816,156 @@ class Rpc {
   /// Actually run one iteration of the event loop
   void run_event_loop_do_one_st();
 
-  /// Enqueue client packets for a sslot that has at least one credit and
-  /// request packets to send. Packets may be added to the timing wheel or the
-  /// TX burst; credits are used in both cases.
-  void kick_req_st(SSlot *);
+  /// Enqueue up to \p max_pkts client packets for a sslot that has at least
+  /// one credit and request packets to send. Packets may be added to the
+  /// timing wheel or the TX burst; credits are used in both cases. Return the
+  /// number of packets enqueued.
+  size_t kick_req_st(SSlot *, size_t max_pkts = SIZE_MAX);
+
+  /// Enqueue up to \p max_pkts client packets for a sslot that has at least
+  /// one credit and RFR packets to send. Packets may be added to the timing
+  /// wheel or the TX burst; credits are used in both cases. Return the number
+  /// of packets enqueued.
+  size_t kick_rfr_st(SSlot *, size_t max_pkts = SIZE_MAX);
+
+  /// Enqueue up to \p max_pkts request or RFR packets for a sslot that has at
+  /// least one credit and packets to send
+  inline size_t kick_st(SSlot *sslot, size_t max_pkts) {
+    return req_pkts_pending(sslot) ? kick_req_st(sslot, max_pkts)
+                                   : kick_rfr_st(sslot, max_pkts);
+  }
+
+  //
+  // TX scheduling. Client requests whose session has no credits, or whose
+  // session has other requests waiting, wait in the session's TX queue. The
+  // queue is served in deficit round robin order with kTxQuantumPkts packets
+  // per turn, so a large request can't hold back small requests for long.
+  // High-priority requests don't wait behind normal ones.
+  // Sessions whose queue can make progress are in tx_ready_sessions: credit
+  // returns wake them, so stalled sessions cost nothing.
+  //
+
+  /**
+   * @brief Send the packets of a client request that may have packets to
+   * send. If no other request of the session is waiting, or if the request
+   * is high-priority, the request uses all available credits now. Packets left
+   * over wait in the session's TX queue.
+   */
+  inline void tx_sched_st(SSlot *sslot) {
+    Session *session = sslot->session;
+    auto &sci = session->client_info;
+    const bool hi = is_high_prio(sslot->tx_msgbuf->get_pkthdr_0()->req_type);
+    if (likely((sci.tx_head == nullptr || hi) && sci.credits > 0)) {
+      kick_st(sslot, SIZE_MAX);
+      if (!can_tx(sslot)) {
+        // A queued high-priority request may have sent its last packets here
+        tx_queue_remove(sslot);
+        return;
+      }
+    }
+
+    if (!sslot->client_info.in_tx_queue) tx_queue_push(session, sslot);
+    tx_wake_st(session);
+  }
+
+  /// Mark a session ready for the TX scheduler if it has credits and queued
+  /// requests. This is called when credits return.
+  inline void tx_wake_st(Session *session) {
+    auto &sci = session->client_info;
+    if (sci.tx_ready || sci.credits == 0 || sci.tx_head == nullptr) return;
+    sci.tx_ready = true;
+    tx_ready_sessions.push_back(session);
+  }
+
+  /// Return true iff a client request has packets to send, and the ack window
+  /// allows sending one
+  static inline bool can_tx(SSlot *sslot) {
+    const auto &ci = sslot->client_info;
+    if (ci.num_tx == ci.ack_base + kSessionCredits) return false;
+    if (req_pkts_pending(sslot)) return true;
+
+    // RFRs are known only after the first response packet is received
+    return ci.num_tx < resp_end_client(sslot);
+  }
+
+  /// Return one past the packet number of the last RFR that a client request
+  /// can send for its current response chunk. Before the chunk's first packet
+  /// arrives, this allows only the RFR that pulls the chunk, which chunks
+  /// after the first need.
+  static inline size_t resp_end_client(const SSlot *sslot) {
+    const auto &ci = sslot->client_info;
+    const size_t base = ci.resp_pkt_base;
+    const size_t off = base - ci.ack_base;  // Valid if base >= ack_base
+    const bool started = base < ci.ack_base ||
+                         (off < 64 && ((ci.ack_bitmap >> off) & 1) == 1);
+    return started ? base + ci.resp_msgbuf->num_pkts : base + 1;
+  }
+
+  /// Append a request to its session's TX queue. High-priority requests are
+  /// appended to the high-priority segment at the front of the queue instead,
+  /// so they take turns among themselves ahead of normal requests.
+  inline void tx_queue_push(Session *session, SSlot *sslot) {
+    auto &sci = session->client_info;
+    auto &ci = sslot->client_info;
+    assert(!ci.in_tx_queue);
+    ci.in_tx_queue = true;
+
+    if (unlikely(is_high_prio(sslot->tx_msgbuf->get_pkthdr_0()->req_type))) {
+      if (sci.tx_hi_tail == nullptr) {
+        ci.tx_next = sci.tx_head;
+        sci.tx_head = sslot;
+      } else {
+        ci.tx_next = sci.tx_hi_tail->client_info.tx_next;
+        sci.tx_hi_tail->client_info.tx_next = sslot;
+      }
+      sci.tx_hi_tail = sslot;
+      if (ci.tx_next == nullptr) sci.tx_tail = sslot;
+      return;
+    }
 
-  /// Enqueue client packets for a sslot that has at least one credit and
-  /// RFR packets to send. Packets may be added to the timing wheel or the
-  /// TX burst; credits are used in both cases.
-  void kick_rfr_st(SSlot *);
+    ci.tx_next = nullptr;
+    if (sci.tx_tail == nullptr) {
+      sci.tx_head = sslot;
+    } else {
+      sci.tx_tail->client_info.tx_next = sslot;
+    }
+    sci.tx_tail = sslot;
+  }
+
+  /// Remove the request at the head of a session's TX queue
+  static inline void tx_queue_pop(Session *session) {
+    auto &sci = session->client_info;
+    auto &ci = sci.tx_head->client_info;
+    ci.in_tx_queue = false;
+    ci.tx_deficit = 0;
+    if (sci.tx_hi_tail == sci.tx_head) sci.tx_hi_tail = nullptr;
+    sci.tx_head = ci.tx_next;
+    if (sci.tx_head == nullptr) sci.tx_tail = nullptr;
+  }
+
+  /// Remove a request from its session's TX queue, if it's in the queue
+  static inline void tx_queue_remove(SSlot *sslot) {
+    if (!sslot->client_info.in_tx_queue) return;
+    Session *session = sslot->session;
+    auto &sci = session->client_info;
+
+    SSlot *prev = nullptr;
+    for (SSlot *s = sci.tx_head; s != sslot; s = s->client_info.tx_next) {
+      prev = s;
+    }
+
+    SSlot *next = sslot->client_info.tx_next;
+    if (prev == nullptr) {
+      sci.tx_head = next;
+    } else {
+      prev->client_info.tx_next = next;
+    }
+    if (sci.tx_tail == sslot) sci.tx_tail = prev;
+    if (sci.tx_hi_tail == sslot) sci.tx_hi_tail = prev;  // prev is high-prio
+
+    sslot->client_info.in_tx_queue = false;
+    sslot->client_info.tx_deficit = 0;
+  }
 
   /// Process a single-packet request message. Using (const pkthdr_t *) instead
   /// of (pkthdr_t *) is messy because of fake MsgBuffer constructor.
@@ -627,6 +974,13 @@ class Rpc {
   /// Process a packet for a multi-packet request
   void process_large_req_one_st(SSlot *, const pkthdr_t *);
 
+  /**
+   * @brief Run the batched request handlers on the requests collected from
+   * this RX batch. This must be called before the RX ring buffers are
+   * reposted, because zero-copy requests live in them.
+   */
+  void process_req_batch_st();
+
   /**
    * @brief Process a single-packet response
    * @param rx_tsc The timestamp at which this packet was received
@@ -634,13 +988,33 @@ class Rpc {
   void process_resp_one_st(SSlot *, const pkthdr_t *, size_t rx_tsc);
 
   /**
-   * @brief Enqueue an explicit credit return
+   * @brief Enqueue an explicit credit return for a request packet of the
+   * sslot's current request. The CR's SACK bitmap also answers the
+   * kSackBits packets before it that the server has received.
    *
    * @param sslot The session slot to send the explicit CR for
-   * @param req_pkthdr The packet header of the request packet that triggered
-   * this explicit CR. The packet number of req_pkthdr is copied to the CR.
+   * @param req_type The request type, copied to the CR
+   * @param pkt_num The request packet number, copied to the CR
+   * @param delayed True iff packet pkt_num was received in an earlier event
+   * loop iteration
+   */
+  void enqueue_cr_st(SSlot *sslot, uint8_t req_type, size_t pkt_num,
+                     bool delayed);
+
+  /**
+   * @brief Count a received request packet toward the sslot's pending
+   * explicit CR, which answers up to kCrBatchPkts packets. The CR is sent
+   * when the count is reached, when a packet falls outside its SACK bitmap,
+   * when the session's pending CRs hold half of its credits, or kCrDelayUs
+   * after the CR's packet was received.
    */
-  void enqueue_cr_st(SSlot *sslot, const pkthdr_t *req_pkthdr);
+  void add_pending_cr_st(SSlot *sslot, const pkthdr_t *req_pkthdr);
+
+  /// Send the sslot's pending explicit CR, if any
+  void send_pending_cr_st(SSlot *sslot);
+
+  /// Send the pending explicit CRs that have waited for kCrDelayUs
+  void process_pending_crs_st();
 
   /**
    * @brief Process an explicit credit return packet
@@ -653,15 +1027,108 @@ class Rpc {
    * sslot's num_tx.
    *
    * @param sslot The session slot to send the RFR for
-   * @param req_pkthdr The packet header of the response packet that triggered
-   * this RFR. Since one response packet can trigger multiple RFRs, the RFR's
-   * packet number should be computed from num_tx, not from resp_pkthdr.
+   * @param resp_pkthdr The header of the first response packet
+   * @param pkt_num The RFR's packet number. One response packet can trigger
+   * multiple RFRs, so this is not derived from resp_pkthdr.
    */
-  void enqueue_rfr_st(SSlot *sslot, const pkthdr_t *resp_pkthdr);
+  void enqueue_rfr_st(SSlot *sslot, const pkthdr_t *resp_pkthdr,
+                      size_t pkt_num);
 
   /// Process a request-for-response
   void process_rfr_st(SSlot *, const pkthdr_t *);
 
+  //
+  // Chunked responses
+  //
+
+  /// Fill in the packet headers of a server's response or response chunk,
+  /// numbering its packets from server_info.resp_pkt_base
+  void format_resp_pkthdrs_st(SSlot *sslot, MsgBuffer *resp_msgbuf,
+                              uint8_t req_type, bool more_chunks);
+
+  /// Send or queue a response chunk that enqueue_response_chunk() accepted
+  void enqueue_response_chunk_st(SSlot *sslot, const MsgBuffer &chunk);
+
+  /// Send the next chunk of a chunked response if the client has asked for it
+  /// and the handler has enqueued it
+  void maybe_advance_resp_chunk_st(SSlot *sslot);
+
+  /// Invoke the continuation for a fully-received response chunk that is not
+  /// the final one, and pull the next chunk
+  void deliver_resp_chunk_st(SSlot *sslot);
+
+  //
+  // Request deadlines and cancellation
+  //
+
+  /**
+   * @brief Fail an active client request with \p status. This frees the sslot
+   * and invokes the continuation, unless some request packets are still in the
+   * timing wheel: then it's done when the last one leaves the wheel, and the
+   * packets are not sent.
+   */
+  void fail_request_st(SSlot *sslot, RespStatus status);
+
+  /// Fail a request that never got an sslot, and invoke its continuation
+  void fail_unsent_request_st(const enq_req_args_t &args, RespStatus status);
+
+  /// Free the sslot of a completed or failed client request, start a
+  /// backlogged request, and invoke the continuation
+  void complete_request_st(SSlot *sslot);
+
+  /// Tell the server that the client has abandoned sslot's request. This is an
+  /// RFR packet with the cancel flag, which doesn't use a credit.
+  void enqueue_cancel_st(SSlot *sslot);
+
+  /// Process a request cancellation notice from the client
+  void process_cancel_st(SSlot *, const pkthdr_t *);
+
+  /// Return the TSC after which the client abandons a new request, computed
+  /// from the time budget in its first received packet, or zero
+  inline size_t req_deadline_server(const pkthdr_t *pkthdr) const {
+    const size_t budget_us = pkthdr->get_budget_us();
+    if (budget_us == 0) return 0;
+    return ev_loop_tsc + us_to_cycles(budget_us, freq_ghz);
+  }
+
+  /// Return true iff the client has abandoned a server sslot's request
+  inline bool req_abandoned_server(const SSlot *sslot) const {
+    const size_t deadline_tsc = sslot->server_info.deadline_tsc;
+    return deadline_tsc != 0 && ev_loop_tsc >= deadline_tsc;
+  }
+
+  /**
+   * @brief Prepare a server sslot for the first packet of a new request.
+   * Return false if the packet must be dropped.
+   *
+   * If the client abandoned the previous request, its handler may still be
+   * running, so the new request is dropped until the client retransmits it.
+   * A partially-received abandoned request is freed.
+   */
+  inline bool start_new_req_server(SSlot *sslot, const pkthdr_t *pkthdr) {
+    auto &si = sslot->server_info;
+    _unused(pkthdr);
+    if (unlikely(si.req_type != kInvalidReqType)) {
+      ERPC_REORDER(
+          "Rpc %u, lsn %u: Received request %zu while the handler for request "
+          "%zu is pending. Dropping.\n",
+          rpc_id, sslot->session->local_session_num, pkthdr->req_num,
+          sslot->cur_req_num);
+      return false;
+    }
+
+    if (unlikely(!si.req_msgbuf.is_buried())) bury_req_msgbuf_server_st(sslot);
+    return true;
+  }
+
+  /// Insert a client request into the RTO wheel to be checked at
+  /// \p check_tsc, or at the request's deadline if that is earlier
+  inline void rto_wheel_insert_st(SSlot *sslot, size_t check_tsc) {
+    const size_t deadline_tsc = sslot->client_info.deadline_tsc;
+    if (deadline_tsc != 0) check_tsc = std::min(check_tsc, deadline_tsc);
+    rto_wheel.insert(sslot, check_tsc);
+  }
+
   /**
    * @brief Enqueue a data packet from sslot's tx_msgbuf for tx_burst
    * @param pkt_idx The index of the packet in tx_msgbuf, not packet number
@@ -671,11 +1138,13 @@ class Rpc {
     assert(in_dispatch());
     const MsgBuffer *tx_msgbuf = sslot->tx_msgbuf;
 
-    Transport::tx_burst_item_t &item = tx_burst_arr[tx_batch_i];
+    const bool hi = is_high_prio(tx_msgbuf->get_pkthdr_0()->req_type);
+    typename TTransport::tx_burst_item_t &item =
+        hi ? tx_burst_hi_arr[tx_batch_hi_i] : tx_burst_arr[tx_batch_i];
     item.routing_info = sslot->session->remote_routing_info;
     item.msg_buffer = const_cast<MsgBuffer *>(tx_msgbuf);
     item.pkt_idx = pkt_idx;
-    if (kCcRTT) item.tx_ts = tx_ts;
+    item.tx_ts = tx_ts;
 
     if (kTesting) {
       item.drop = roll_pkt_drop();
@@ -688,8 +1157,7 @@ class Rpc {
                tx_msgbuf->get_pkthdr_str(pkt_idx).c_str(),
                sslot->progress_str().c_str(), item.drop ? " Drop." : "");
 
-    tx_batch_i++;
-    if (tx_batch_i == Transport::kPostlist) do_tx_burst_st();
+    bump_tx_batch_st(hi);
   }
 
   /// Enqueue a control packet for tx_burst. ctrl_msgbuf can be reused after
@@ -698,11 +1166,13 @@ class Rpc {
                                       size_t *tx_ts) {
     assert(in_dispatch());
 
-    Transport::tx_burst_item_t &item = tx_burst_arr[tx_batch_i];
+    const bool hi = is_high_prio(ctrl_msgbuf->get_pkthdr_0()->req_type);
+    typename TTransport::tx_burst_item_t &item =
+        hi ? tx_burst_hi_arr[tx_batch_hi_i] : tx_burst_arr[tx_batch_i];
     item.routing_info = sslot->session->remote_routing_info;
     item.msg_buffer = ctrl_msgbuf;
     item.pkt_idx = 0;
-    if (kCcRTT) item.tx_ts = tx_ts;
+    item.tx_ts = tx_ts;
 
     if (kTesting) {
       item.drop = roll_pkt_drop();
@@ -715,14 +1185,21 @@ class Rpc {
                ctrl_msgbuf->get_pkthdr_str(0).c_str(),
                sslot->progress_str().c_str(), item.drop ? " Drop." : "");
 
-    tx_batch_i++;
-    if (tx_batch_i == Transport::kPostlist) do_tx_burst_st();
+    bump_tx_batch_st(hi);
+  }
+
+  /// Account for a packet added to the high-priority or the normal TX batch,
+  /// and transmit the batches if it's full
+  inline void bump_tx_batch_st(bool hi) {
+    size_t &batch_i = hi ? tx_batch_hi_i : tx_batch_i;
+    batch_i++;
+    if (batch_i == TTransport::kPostlist) do_tx_burst_st();
   }
 
   /// Enqueue a request packet to the timing wheel
   inline void enqueue_wheel_req_st(SSlot *sslot, size_t pkt_num) {
     const size_t pkt_idx = pkt_num;
-    size_t pktsz = sslot->tx_msgbuf->get_pkt_size<Transport::kMaxDataPerPkt>(pkt_idx);
+    size_t pktsz = sslot->tx_msgbuf->get_pkt_size<TTransport::kMaxDataPerPkt>(pkt_idx);
     size_t ref_tsc = dpath_rdtsc();
     size_t desired_tx_tsc = sslot->session->cc_getupdate_tx_tsc(ref_tsc, pktsz);
 
@@ -737,9 +1214,9 @@ class Rpc {
 
   /// Enqueue an RFR packet to the timing wheel
   inline void enqueue_wheel_rfr_st(SSlot *sslot, size_t pkt_num) {
-    const size_t pkt_idx = resp_ntoi(pkt_num, sslot->tx_msgbuf->num_pkts);
+    const size_t pkt_idx = pkt_num - sslot->client_info.resp_pkt_base;
     const MsgBuffer *resp_msgbuf = sslot->client_info.resp_msgbuf;
-    size_t pktsz = resp_msgbuf->get_pkt_size<Transport::kMaxDataPerPkt>(pkt_idx);
+    size_t pktsz = resp_msgbuf->get_pkt_size<TTransport::kMaxDataPerPkt>(pkt_idx);
     size_t ref_tsc = dpath_rdtsc();
     size_t desired_tx_tsc = sslot->session->cc_getupdate_tx_tsc(ref_tsc, pktsz);
 
@@ -752,42 +1229,59 @@ class Rpc {
     sslot->client_info.wheel_count++;
   }
 
-  /// Transmit packets in the TX batch
+  /// Transmit packets in the TX batches, high-priority packets first
   inline void do_tx_burst_st() {
     assert(in_dispatch());
-    assert(tx_batch_i > 0);
+    assert(tx_batch_i + tx_batch_hi_i > 0);
 
     // Measure TX burst size
     dpath_stat_inc(dpath_stats.tx_burst_calls, 1);
-    dpath_stat_inc(dpath_stats.pkts_tx, tx_batch_i);
+    dpath_stat_inc(dpath_stats.pkts_tx, tx_batch_i + tx_batch_hi_i);
+
+    if (unlikely(tx_batch_hi_i > 0)) {
+      do_tx_burst_one_st(tx_burst_hi_arr, tx_batch_hi_i);
+      tx_batch_hi_i = 0;
+    }
+
+    if (tx_batch_i > 0) {
+      do_tx_burst_one_st(tx_burst_arr, tx_batch_i);
+      tx_batch_i = 0;
+    }
+  }
 
-    if (kCcRTT) {
-      size_t batch_tsc = 0;
-      if (kCcOptBatchTsc) batch_tsc = dpath_rdtsc();
+  /// Transmit \p num_pkts packets from one TX batch array
+  inline void do_tx_burst_one_st(
+      typename TTransport::tx_burst_item_t *burst_arr, size_t num_pkts) {
+    // The RTO needs TX timestamps even if congestion control is disabled
+    size_t batch_tsc = 0;
+    if (kCcOptBatchTsc) batch_tsc = dpath_rdtsc();
 
-      for (size_t i = 0; i < tx_batch_i; i++) {
-        if (tx_burst_arr[i].tx_ts != nullptr) {
-          *tx_burst_arr[i].tx_ts = kCcOptBatchTsc ? batch_tsc : dpath_rdtsc();
-        }
+    for (size_t i = 0; i < num_pkts; i++) {
+      if (burst_arr[i].tx_ts != nullptr) {
+        *burst_arr[i].tx_ts = kCcOptBatchTsc ? batch_tsc : dpath_rdtsc();
       }
     }
 
-    transport->tx_burst(tx_burst_arr, tx_batch_i);
-    tx_batch_i = 0;
+    transport->tx_burst(burst_arr, num_pkts);
   }
 
-  /// Return a credit to this session
-  static inline void bump_credits(Session *session) {
+  /// Return \p num_credits credits to this session, and apply the server's
+  /// grant carried by \p pkthdr
+  static inline void bump_credits(Session *session, const pkthdr_t *pkthdr,
+                                  size_t num_credits) {
     assert(session->is_client());
-    assert(session->client_info.credits < kSessionCredits);
-    session->client_info.credits++;
+    auto &ci = session->client_info;
+    if (unlikely(pkthdr->credit_grant != ci.credit_limit)) {
+      set_credit_limit(session, pkthdr->credit_grant);
+    }
+    ci.credits = std::min(ci.credit_limit, ci.credits + num_credits);
   }
 
   /// Copy the data from a packet to a MsgBuffer at a packet index
   static inline void copy_data_to_msgbuf(MsgBuffer *msgbuf, size_t pkt_idx,
                                          const pkthdr_t *pkthdr) {
-    size_t offset = pkt_idx * Transport::kMaxDataPerPkt;
-    size_t to_copy = std::min(Transport::kMaxDataPerPkt, pkthdr->msg_size - offset);
+    size_t offset = pkt_idx * TTransport::kMaxDataPerPkt;
+    size_t to_copy = std::min(TTransport::kMaxDataPerPkt, pkthdr->msg_size - offset);
     memcpy(&msgbuf->buf[offset], pkthdr + 1, to_copy);  // From end of pkthdr
   }
 
@@ -799,9 +1293,73 @@ class Rpc {
    * NIC until we send at least one response/CR packet back, we do not control
    * the order or time at which these packets are sent, due to constraints like
    * session credits and packet pacing.
+   *
+   * Packets of high-priority requests are processed before the other packets
+   * of the RX batch.
    */
   void process_comps_st();
 
+  /// Process one packet from the RX ring
+  void process_rx_pkt_st(pkthdr_t *pkthdr, size_t batch_rx_tsc);
+
+  /// Return the packet in RX ring entry (i % kNumRxRingEntries)
+  inline pkthdr_t *rx_ring_pkthdr(size_t i) const {
+    return reinterpret_cast<pkthdr_t *>(
+        rx_ring[i % TTransport::kNumRxRingEntries]);
+  }
+
+  /// Return the session of a received packet for prefetching, or nullptr
+  inline const Session *rx_pkt_session(const pkthdr_t *pkthdr) const {
+    if (unlikely(pkthdr->dest_session_num >= session_vec.size())) {
+      return nullptr;
+    }
+    return session_vec[pkthdr->dest_session_num];
+  }
+
+  /// Return the sslot of a received packet in its session
+  static inline const SSlot *rx_pkt_sslot(const Session *session,
+                                          const pkthdr_t *pkthdr) {
+    return &session->sslot_arr[pkthdr->req_num & (session->req_window - 1)];
+  }
+
+  /// Prefetch the cache lines of the bytes [begin, end)
+  static inline void prefetch_range(const void *begin, const void *end) {
+    auto *p = static_cast<const uint8_t *>(begin);
+    for (; p < static_cast<const uint8_t *>(end); p += kCacheLineSize) {
+      __builtin_prefetch(p);
+    }
+  }
+
+  /// Prefetch the session of a received packet. This is the first stage of
+  /// the RX pipeline. The RX path reads the role and state at the start of the
+  /// session, and the request window, sslots, and credits later.
+  inline void prefetch_rx_session(const pkthdr_t *pkthdr) const {
+    const Session *session = rx_pkt_session(pkthdr);
+    if (unlikely(session == nullptr)) return;
+    __builtin_prefetch(session);
+    prefetch_range(&session->req_window, &session->client_info.credit_limit);
+  }
+
+  /// Prefetch the sslot of a received packet, and the routing info that
+  /// replies use. This reads the session.
+  inline void prefetch_rx_sslot(const pkthdr_t *pkthdr) const {
+    const Session *session = rx_pkt_session(pkthdr);
+    if (unlikely(session == nullptr)) return;
+    __builtin_prefetch(session->remote_routing_info);
+    const SSlot *sslot = rx_pkt_sslot(session, pkthdr);
+    prefetch_range(sslot, &sslot->server_info + 1);
+  }
+
+  /// Prefetch the header of the preallocated response msgbuf that a request
+  /// handler usually fills. This reads the sslot.
+  inline void prefetch_rx_msgbufs(const pkthdr_t *pkthdr) const {
+    const Session *session = rx_pkt_session(pkthdr);
+    if (unlikely(session == nullptr)) return;
+    if (pkthdr->pkt_type != PktType::kPktTypeReq) return;
+    const SSlot *sslot = rx_pkt_sslot(session, pkthdr);
+    __builtin_prefetch(sslot->pre_resp_msgbuf.get_pkthdr_0(), 1);
+  }
+
   /**
    * @brief Submit a request work item to a random background thread
    *
@@ -822,12 +1380,21 @@ class Rpc {
    */
   void submit_bg_resp_st(erpc_cont_func_t cont_func, void *tag, size_t bg_etid);
 
+  /// Add a work item to a background thread's queue. If the queue is full, or
+  /// earlier items are still waiting for room, the item waits in the thread's
+  /// overflow list instead, so the dispatch thread never blocks here.
+  void push_bg_work_item_st(size_t bg_etid, const Nexus::BgWorkItem &wi);
+
+  /// Move overflowed work items to their background threads' queues, in
+  /// order, until the lists are empty or the queues are full
+  void process_bg_overflow_st();
+
   //
   // Queue handlers
   //
 
-  /// Try to transmit request packets from sslots that are stalled for credits.
-  void process_credit_stall_queue_st();
+  /// Serve the TX queues of ready sessions in deficit round robin order
+  void process_tx_queues_st();
 
   /// Process the wheel. We have already paid credits for sslots in the wheel.
   void process_wheel_st();
@@ -854,6 +1421,14 @@ class Rpc {
   /// Retransmit packets for an sslot for which we suspect a packet loss
   void pkt_loss_retransmit_st(SSlot *sslot);
 
+  /// Retransmit unanswered packets of an sslot that are kFastRetxThresh or
+  /// more packets older than its newest answered packet, without waiting for
+  /// the RTO. Each packet is fast-retransmitted at most once.
+  void pkt_loss_fast_retransmit_st(SSlot *sslot);
+
+  /// Re-send one unanswered packet, unless it's still in the wheel
+  void pkt_loss_resend_pkt_st(SSlot *sslot, size_t pkt_num);
+
   //
   // Misc private functions
   //
@@ -893,6 +1468,47 @@ class Rpc {
     sslot->session->client_info.cc.timely.update_rate(rx_tsc, rtt_tsc);
   }
 
+  /// Return the RTO of a client request. The reply to packet resp_pkt_base
+  /// waits for the server to produce the response, so a request waiting for
+  /// it uses the initial RTO instead of one based on network RTTs.
+  inline size_t req_rto_tsc(const SSlot *sslot) const {
+    const auto &ci = sslot->client_info;
+    if (ci.num_rx == ci.resp_pkt_base) return rpc_rto_cycles;
+    return sslot->session->client_info.rto.rto_tsc;
+  }
+
+  /**
+   * @brief Update the session's smoothed RTT and RTO on receiving the explicit
+   * CR or response packet for this triggering packet number
+   *
+   * @param sslot The request sslot for which a packet is received
+   * @param pkt_num The received packet's packet number
+   * @param Time at which the explicit CR or response packet was received
+   */
+  inline void update_rto(SSlot *sslot, size_t pkt_num, size_t rx_tsc) {
+    const size_t tx_tsc = sslot->client_info.tx_ts[pkt_num % kSessionCredits];
+    if (sslot->client_info.re_tx || unlikely(rx_tsc < tx_tsc)) return;
+
+    const size_t rtt_tsc = rx_tsc - tx_tsc;
+    auto &rto = sslot->session->client_info.rto;
+    if (unlikely(rto.srtt_tsc == 0)) {
+      rto.srtt_tsc = rtt_tsc;
+      rto.rttvar_tsc = rtt_tsc / 2;
+    } else {
+      const size_t err = rtt_tsc > rto.srtt_tsc ? rtt_tsc - rto.srtt_tsc
+                                                : rto.srtt_tsc - rtt_tsc;
+      rto.rttvar_tsc = (3 * rto.rttvar_tsc + err) / 4;
+      rto.srtt_tsc = (7 * rto.srtt_tsc + rtt_tsc) / 8;
+    }
+
+    // The server may delay a CR by up to the CR delay, and delayed CRs give no
+    // RTT samples, so the samples don't include the delay
+    rto.rto_tsc = rto.srtt_tsc + 4 * rto.rttvar_tsc;
+    rto.rto_tsc = std::max(rto.rto_tsc, rpc_min_rto_cycles);
+    rto.rto_tsc += rpc_cr_delay_cycles;
+    rto.rto_tsc = std::min(rto.rto_tsc, rpc_rto_cycles);
+  }
+
   /// Return true iff a packet should be dropped
   inline bool roll_pkt_drop() {
     static constexpr uint32_t billion = 1000000000;
@@ -906,6 +1522,13 @@ class Rpc {
   /// happens when the server RPC thread has not started.
   bool retry_connect_on_invalid_rpc_id = false;
 
+  /// The largest request window that this Rpc grants to sessions created to
+  /// it. Larger requests are cut down by powers of two.
+  size_t max_session_req_window = kSessionMaxReqWindow;
+
+  /// The largest credit count that this Rpc grants to sessions created to it
+  size_t max_session_credits = kSessionCredits;
+
  private:
   // Constructor args
   Nexus *nexus;
@@ -918,12 +1541,16 @@ class Rpc {
   const size_t creation_tsc;    ///< Timestamp of creation of this Rpc endpoint
   const bool multi_threaded;    ///< True iff there are background threads
   const double freq_ghz;        ///< RDTSC frequency, derived from Nexus
-  const size_t rpc_rto_cycles;  ///< RPC RTO in cycles
+  const size_t rpc_rto_cycles;  ///< Initial and largest RPC RTO in cycles
+  const size_t rpc_min_rto_cycles;  ///< Smallest RPC RTO in cycles
   const size_t rpc_pkt_loss_scan_cycles;  ///< Packet loss scan frequency
+  const size_t rpc_credit_scan_cycles;    ///< Lent credit reclaim frequency
+  const size_t rpc_cr_delay_cycles;       ///< Longest credit return delay
 
   /// A copy of the request/response handlers from the Nexus. We could use
   /// a pointer instead, but an array is faster.
   const std::array<ReqFunc, kReqTypeArraySize> req_func_arr;
+  bool high_prio_enabled;  ///< True iff a request type is high-priority
 
   // Rpc metadata
   size_t creator_etid;        ///< eRPC thread ID of the creator thread
@@ -937,29 +1564,53 @@ class Rpc {
   std::vector<Session *> session_vec;
 
   // Transport
-  Transport *transport = nullptr;  ///< The unreliable transport
+  TTransport *transport = nullptr;  ///< The unreliable transport
+
+  /// Credits that this Rpc can lend to its server sessions beyond
+  /// kSessionMinCredits. The RX ring absorbs that many packets per event loop
+  /// iteration.
+  size_t credit_pool = TTransport::kNumRxRingEntries;
+
+  /// Server sessions holding lent credits
+  std::vector<Session *> credit_borrowers;
 
-  /// Current number of ring buffers available to use for sessions
-  size_t ring_entries_available = Transport::kNumRxRingEntries;
+  /// Server sslots that may have a pending explicit CR
+  std::vector<SSlot *> cr_pending_sslots;
 
-  Transport::tx_burst_item_t tx_burst_arr[Transport::kPostlist];  ///< Tx batch info
+  /// Requests of batched handlers that completed in this RX batch
+  std::vector<ReqHandle *> req_batch;
+
+  /// Work items waiting for room in each background thread's queue
+  std::deque<Nexus::BgWorkItem> bg_overflow[kMaxBgThreads];
+  size_t bg_overflow_size = 0;  ///< Total items in bg_overflow
+
+  typename TTransport::tx_burst_item_t tx_burst_arr[TTransport::kPostlist];  ///< Tx batch info
   size_t tx_batch_i = 0;  ///< The batch index for TX burst array
 
+  /// TX batch for packets of high-priority requests, sent before tx_burst_arr
+  typename TTransport::tx_burst_item_t tx_burst_hi_arr[TTransport::kPostlist];
+  size_t tx_batch_hi_i = 0;  ///< The batch index for tx_burst_hi_arr
+
   /// On calling rx_burst(), Transport fills-in packet buffer pointers into the
   /// RX ring. Some transports such as InfiniBand and Raw reuse RX ring packet
   /// buffers in a circular order, so the ring's pointers remain unchanged
   /// after initialization. Other transports (e.g., DPDK) update rx_ring on
   /// every successful rx_burst.
-  uint8_t *rx_ring[Transport::kNumRxRingEntries];
+  uint8_t *rx_ring[TTransport::kNumRxRingEntries];
   size_t rx_ring_head = 0;  ///< Current unused RX ring buffer
 
-  std::vector<SSlot *> stallq;  ///< Request sslots stalled for credits
+  /// Client sessions with credits and requests in their TX queue
+  std::vector<Session *> tx_ready_sessions;
 
   size_t ev_loop_tsc;  ///< TSC taken at each iteration of the ev loop
 
   // Packet loss
   size_t pkt_loss_scan_tsc;  ///< Timestamp of the previous scan for lost pkts
 
+  /// Active requests by RTO deadline. Ticks once per packet loss scan.
+  RtoWheel rto_wheel;
+  size_t credit_scan_tsc;  ///< Timestamp of the previous lent credit scan
+
   /// The doubly-linked list of active RPCs. An RPC slot is added to this list
   /// when the request is enqueued. The slot is deleted from this list when its
   /// continuation is invoked or queued to a background thread.
@@ -973,7 +1624,7 @@ class Rpc {
   STDAlloc *std_alloc = nullptr;  ///< This thread's hugepage allocator
   std::mutex std_alloc_lock;       ///< A lock to guard the huge allocator
 
-  MsgBuffer ctrl_msgbufs[Transport::kCtrlBufferSize];  ///< Buffers for RFR/CR
+  MsgBuffer ctrl_msgbufs[TTransport::kCtrlBufferSize];  ///< Buffers for RFR/CR
   size_t ctrl_msgbuf_head = 0;
   FastRand fast_rand;  ///< A fast random generator
 
@@ -985,8 +1636,8 @@ class Rpc {
 
   /// Queues for datapath API requests from background threads
   struct {
-    MtQueue<enq_req_args_t> _enqueue_request;
-    MtQueue<enq_resp_args_t> _enqueue_response;
+    MpscQueue<enq_req_args_t, kBgQueueSize> _enqueue_request;
+    MpscQueue<enq_resp_args_t, kBgQueueSize> _enqueue_response;
   } bg_queues;
 
   // Misc
@@ -1035,19 +1686,24 @@ class Rpc {
  public:
   struct {
     size_t num_re_tx = 0;  /// Total retransmissions across all sessions
+    size_t num_fast_re_tx = 0;  /// Total fast retransmissions, before an RTO
 
-    /// Number of times we could not retransmit a request, or we had to drop
-    /// a received packet, because a request reference was still in the wheel.
+    /// Number of unanswered packets that we did not retransmit because they
+    /// were still in the wheel
     size_t still_in_wheel_during_retx = 0;
   } pkt_loss_stats;
 
   /// Size of the preallocated response buffer. This is one packet by default,
   /// but some applications might benefit from a larger preallocated buffer,
   /// at the expense of increased memory utilization.
-  size_t pre_resp_msgbuf_size = Transport::kMaxDataPerPkt;
+  size_t pre_resp_msgbuf_size = TTransport::kMaxDataPerPkt;
 };
 
 // This goes at the end of every Rpc implementation file to force compilation
-// #define FORCE_COMPILE_TRANSPORTS template class Rpc<CTransport>;
-#define FORCE_COMPILE_TRANSPORTS class Rpc;
+#define FORCE_COMPILE_TRANSPORTS \
+  template class Rpc<UDPTransport>;  \
+  template class Rpc<URingTransport>;
+
+/// The transport for applications that don't choose one
+typedef UDPTransport CTransport;
 }  // namespace erpc
@@ -28,7 +28,7 @@ static constexpr size_t kMaxRpcId = UINT8_MAX - 1;
 static constexpr uint16_t kBaseSmUdpPort = 31850;
 
 static_assert(kBaseSmUdpPort + kMaxNumERpcProcesses +
-                      (kMaxNumERpcProcesses * kMaxRpcId) <
+                      (kMaxNumERpcProcesses * (kMaxRpcId + 1)) <
                   UINT16_MAX,
               "");
 
@@ -60,14 +60,16 @@ static constexpr size_t kMaxPhyPorts = 16;
 static constexpr size_t kMachineFailureTimeoutMs = 500;
 
 /**
- * @brief Return the datapath UDP port used for an Rpc object in a process
+ * @brief Return the datapath UDP port used for an Rpc object in a process.
+ * Each process gets (kMaxRpcId + 1) ports, one per valid Rpc ID.
  *
  * @param mgmt_udp_port The management UDP port of the process
  * @param rpc_id The ID of the Rpc object
  */
 static uint16_t get_dpath_udp_port(uint16_t mgmt_udp_port, uint8_t rpc_id) {
   return kBaseSmUdpPort + kMaxNumERpcProcesses +
-         (static_cast<uint16_t>(mgmt_udp_port - kBaseSmUdpPort) * kMaxRpcId) +
+         (static_cast<uint16_t>(mgmt_udp_port - kBaseSmUdpPort) *
+          (kMaxRpcId + 1)) +
          rpc_id;
 }
 
@@ -10,8 +10,9 @@
 
 namespace erpc {
 
-Rpc::Rpc(Nexus *nexus, void *context, uint8_t rpc_id,
-              sm_handler_t sm_handler)
+template <class TTransport>
+Rpc<TTransport>::Rpc(Nexus *nexus, void *context, uint8_t rpc_id,
+                      sm_handler_t sm_handler)
     : nexus(nexus),
       context(context),
       rpc_id(rpc_id),
@@ -21,13 +22,22 @@ Rpc::Rpc(Nexus *nexus, void *context, uint8_t rpc_id,
       multi_threaded(nexus->num_bg_threads > 0),
       freq_ghz(nexus->freq_ghz),
       rpc_rto_cycles(us_to_cycles(kRpcRTOUs, freq_ghz)),
-      rpc_pkt_loss_scan_cycles(rpc_rto_cycles / 10),
-      req_func_arr(nexus->req_func_arr) {
+      rpc_min_rto_cycles(us_to_cycles(kRpcMinRTOUs, freq_ghz)),
+      rpc_pkt_loss_scan_cycles(rpc_min_rto_cycles / 4),
+      rpc_credit_scan_cycles(rpc_rto_cycles / 10),
+      rpc_cr_delay_cycles(us_to_cycles(kCrDelayUs, freq_ghz)),
+      req_func_arr(nexus->req_func_arr),
+      rto_wheel(rpc_pkt_loss_scan_cycles, rdtsc()) {
   // rt_assert(!getuid(), "You need to be root to use eRPC");
   rt_assert(rpc_id != kInvalidRpcId, "Invalid Rpc ID");
   rt_assert(!nexus->rpc_id_exists(rpc_id), "Rpc ID already exists");
   rt_assert(numa_node < kMaxNumaNodes, "Invalid NUMA node");
 
+  high_prio_enabled = false;
+  for (const ReqFunc &req_func : req_func_arr) {
+    if (req_func.req_priority == ReqPriority::kHigh) high_prio_enabled = true;
+  }
+
   tls_registry = &nexus->tls_registry;
   tls_registry->init();  // Initialize thread-local variables for this thread
   creator_etid = get_etid();
@@ -46,7 +56,10 @@ Rpc::Rpc(Nexus *nexus, void *context, uint8_t rpc_id,
   // Partially initialize the transport without using hugepages. This
   // initializes the transport's memory registration functions required for
   // the hugepage allocator.
-  transport = new Transport(nexus->sm_udp_port + 1, rpc_id, numa_node, trace_file);
+  // In shared-port mode, all Rpcs in this process bind the port of Rpc 0
+  transport = new TTransport(
+      get_dpath_udp_port(nexus->sm_udp_port, kSharedDpathPort ? 0 : rpc_id),
+      rpc_id, numa_node, trace_file);
 
   std_alloc = new STDAlloc();
 
@@ -88,10 +101,12 @@ Rpc::Rpc(Nexus *nexus, void *context, uint8_t rpc_id,
 
   // Steps that should be done as late as possible
   pkt_loss_scan_tsc = rdtsc();  // Assign epoch timestamp as late as possible
+  credit_scan_tsc = pkt_loss_scan_tsc;
   if (kCcPacing) wheel->catchup();  // Wheel could be lagging, so catch up
 }
 
-Rpc::~Rpc() {
+template <class TTransport>
+Rpc<TTransport>::~Rpc() {
   assert(in_dispatch());
 
   // XXX: Check if all sessions are disconnected
@@ -0,0 +1,146 @@
+/**
+ * @file rpc_cancel.cc
+ * @brief Request deadlines and cancellation
+ */
+#include "rpc.h"
+
+namespace erpc {
+
+template <class TTransport>
+bool Rpc<TTransport>::cancel_request(int session_num, void *tag) {
+  rt_assert(in_dispatch(), "cancel_request() must run in the creator thread");
+  assert(is_usr_session_num_in_range_st(session_num));
+
+  Session *session = session_vec[static_cast<size_t>(session_num)];
+  assert(session != nullptr && session->is_client());
+
+  for (SSlot &sslot : session->sslot_arr) {
+    auto &ci = sslot.client_info;
+    if (sslot.tx_msgbuf != nullptr && ci.tag == tag &&
+        ci.fail_status == RespStatus::kOk) {
+      fail_request_st(&sslot, RespStatus::kCancelled);
+      return true;
+    }
+  }
+
+  // The request may be waiting for a free sslot
+  auto &backlog = session->client_info.enq_req_backlog;
+  for (auto it = backlog.begin(); it != backlog.end(); it++) {
+    if (it->tag == tag) {
+      const enq_req_args_t args = *it;
+      backlog.erase(it);
+      fail_unsent_request_st(args, RespStatus::kCancelled);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+template <class TTransport>
+void Rpc<TTransport>::fail_request_st(SSlot *sslot, RespStatus status) {
+  assert(in_dispatch());
+  assert(sslot->tx_msgbuf != nullptr);  // sslot has a valid request
+  auto &ci = sslot->client_info;
+
+  // Stop sending packets and checking for loss
+  tx_queue_remove(sslot);
+  rto_wheel.remove(sslot);
+
+  // The wheel references the request until its paced packets leave it
+  if (ci.wheel_count > 0) {
+    ci.fail_status = status;
+    return;
+  }
+
+  ERPC_REORDER("Rpc %u, lsn %u: Failing request %zu (%s). Status %u.\n",
+               rpc_id, sslot->session->local_session_num, sslot->cur_req_num,
+               sslot->progress_str().c_str(), static_cast<unsigned>(status));
+
+  // The TX batch or DMA queue may reference the request
+  drain_tx_batch_and_dma_queue();
+
+  // Unanswered packets will never return their credits
+  Session *session = sslot->session;
+  auto &sci = session->client_info;
+  sci.credits = std::min(sci.credit_limit, sci.credits + ci.num_tx - ci.num_rx);
+  tx_wake_st(session);
+
+  if (ci.num_tx > 0) enqueue_cancel_st(sslot);
+
+  MsgBuffer *resp_msgbuf = ci.resp_msgbuf;
+  resize_msg_buffer(resp_msgbuf, 0);  // 0 response size marks the error
+  resp_msgbuf->resp_status = status;
+  complete_request_st(sslot);
+}
+
+template <class TTransport>
+void Rpc<TTransport>::fail_unsent_request_st(const enq_req_args_t &args,
+                                             RespStatus status) {
+  assert(in_dispatch());
+  resize_msg_buffer(args.resp_msgbuf, 0);
+  args.resp_msgbuf->resp_status = status;
+
+  if (likely(args.cont_etid == kInvalidBgETid)) {
+    args.cont_func(context, args.tag);
+  } else {
+    submit_bg_resp_st(args.cont_func, args.tag, args.cont_etid);
+  }
+}
+
+template <class TTransport>
+void Rpc<TTransport>::enqueue_cancel_st(SSlot *sslot) {
+  assert(in_dispatch());
+
+  MsgBuffer *ctrl_msgbuf = &ctrl_msgbufs[ctrl_msgbuf_head];
+  ctrl_msgbuf_head++;
+  if (ctrl_msgbuf_head == TTransport::kCtrlBufferSize) ctrl_msgbuf_head = 0;
+
+  pkthdr_t *cancel_pkthdr = ctrl_msgbuf->get_pkthdr_0();
+  cancel_pkthdr->format(sslot->tx_msgbuf->get_pkthdr_0()->req_type,
+                        0 /* msg_size */, sslot->session->remote_session_num,
+                        kPktTypeRFR, 0 /* pkt_num */, sslot->cur_req_num);
+  cancel_pkthdr->dest_rpc_id = sslot->session->remote_rpc_id;
+  cancel_pkthdr->cancel = 1;
+
+  enqueue_hdr_tx_burst_st(sslot, ctrl_msgbuf, nullptr);
+}
+
+template <class TTransport>
+void Rpc<TTransport>::process_cancel_st(SSlot *sslot, const pkthdr_t *pkthdr) {
+  assert(in_dispatch());
+  assert(!sslot->is_client);
+  auto &si = sslot->server_info;
+
+  if (pkthdr->req_num != sslot->cur_req_num) {
+    // We haven't seen the request, or we have moved past it
+    ERPC_REORDER(
+        "Rpc %u, lsn %u: Received cancel for req %zu, cur_req_num = %zu. "
+        "Dropping.\n",
+        rpc_id, sslot->session->local_session_num, pkthdr->req_num,
+        sslot->cur_req_num);
+    return;
+  }
+
+  ERPC_REORDER("Rpc %u, lsn %u: Client abandoned req %zu.\n", rpc_id,
+               sslot->session->local_session_num, pkthdr->req_num);
+  si.deadline_tsc = ev_loop_tsc;  // Marks the request as abandoned
+  cancel_pending_cr_st(sslot);    // The client no longer waits for credits
+
+  // Chunks that wait for the client won't be pulled
+  if (si.resp_chunk_q != nullptr) free_waiting_resp_chunks_st(sslot);
+
+  // A running handler owns the request. Its response won't be sent.
+  if (si.req_type != kInvalidReqType) return;
+
+  if (!si.req_msgbuf.is_buried()) {
+    bury_req_msgbuf_server_st(sslot);  // A partially-received request
+  } else if (sslot->tx_msgbuf != nullptr) {
+    drain_tx_batch_and_dma_queue();  // The TX batch may reference the response
+    bury_resp_msgbuf_server_st(sslot);
+  }
+}
+
+FORCE_COMPILE_TRANSPORTS
+
+}  // namespace erpc
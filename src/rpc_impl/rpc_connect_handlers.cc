@@ -2,13 +2,16 @@
  * @file rpc_connect_handlers.cc
  * @brief Handlers for session management connect requests and responses.
  */
+#include <algorithm>
+
 #include "rpc.h"
 
 namespace erpc {
 
 // We need to handle all types of errors in remote arguments that the client can
 // make when calling create_session(), which cannot check for such errors.
-void Rpc::handle_connect_req_st(const SmPkt &sm_pkt) {
+template <class TTransport>
+void Rpc<TTransport>::handle_connect_req_st(const SmPkt &sm_pkt) {
   assert(in_dispatch());
   assert(sm_pkt.pkt_type == SmPktType::kConnectReq &&
          sm_pkt.server.rpc_id == rpc_id);
@@ -40,18 +43,31 @@ void Rpc::handle_connect_req_st(const SmPkt &sm_pkt) {
   // If we're here, this is the first time we're receiving this connect request
 
   // Check if we are allowed to create another session
-  if (!have_ring_entries()) {
-    ERPC_WARN("%s: Ring buffers exhausted. Sending response.\n", issue_msg);
+  if (session_vec.size() >= get_max_num_sessions()) {
+    ERPC_WARN("%s: Sessions exhausted. Sending response.\n", issue_msg);
     sm_pkt_udp_tx_st(sm_construct_resp(sm_pkt, SmErrType::kRingExhausted));
     return;
   }
 
+  // Grant the client's request window and credits within our limits
+  size_t req_window = sm_pkt.client.req_window;
+  if (!is_power_of_two(req_window)) req_window = kSessionReqWindow;
+  while (req_window > 1 && (req_window > max_session_req_window ||
+                            req_window > kSessionMaxReqWindow)) {
+    req_window /= 2;
+  }
+
+  size_t credits = std::min({static_cast<size_t>(sm_pkt.client.credits),
+                             max_session_credits, kSessionCredits});
+  credits = std::max(credits, kSessionMinCredits);
+
   // If we are here, create a new session and fill preallocated MsgBuffers
-  auto *session = new Session(Session::Role::kServer, sm_pkt.uniq_token,
-                              get_freq_ghz(), transport->get_bandwidth());
+  auto *session =
+      new Session(Session::Role::kServer, sm_pkt.uniq_token, get_freq_ghz(),
+                  transport->get_bandwidth(), req_window, credits);
   session->state = SessionState::kConnected;
 
-  for (size_t i = 0; i < kSessionReqWindow; i++) {
+  for (size_t i = 0; i < session->req_window; i++) {
     MsgBuffer &msgbuf_i = session->sslot_arr[i].pre_resp_msgbuf;
     msgbuf_i = alloc_msg_buffer(pre_resp_msgbuf_size);
 
@@ -63,7 +79,7 @@ void Rpc::handle_connect_req_st(const SmPkt &sm_pkt) {
         free_msg_buffer(msgbuf_j);
       }
 
-      free(session);
+      delete session;
       ERPC_WARN("%s: Failed to allocate prealloc MsgBuffer.\n", issue_msg);
       sm_pkt_udp_tx_st(sm_construct_resp(sm_pkt, SmErrType::kOutOfMemory));
       return;
@@ -73,16 +89,37 @@ void Rpc::handle_connect_req_st(const SmPkt &sm_pkt) {
   // Fill-in the server endpoint
   session->server = sm_pkt.server;
   session->server.session_num = session_vec.size();
+  session->server.data_udp_port = transport->data_udp_port;
+  session->server.host_id = transport->host_id;
+  session->server.req_window = req_window;
+  session->server.credits = credits;
+  session->server.dgram_split = transport->splits_dgrams();
   conn_req_token_map[session->uniq_token] = session->server.session_num;
 
   // Fill-in the client endpoint
   session->client = sm_pkt.client;
-  session->client.routing_info = Transport::make_routing_info(sm_pkt.client.hostname, sm_pkt.client.data_udp_port);
+  session->client.routing_info = TTransport::make_routing_info(sm_pkt.client.hostname, sm_pkt.client.data_udp_port);
+  TTransport::set_dgram_split(&session->client.routing_info, sm_pkt.client.dgram_split);
+
+  // Use the client's channel if it's on this host
+  if (sm_pkt.client.shm_channel && sm_pkt.client.host_id == transport->host_id) {
+    std::shared_ptr<uint8_t> region = nexus->take_loopback_region(sm_pkt.uniq_token);
+    size_t chan = TTransport::kInvalidShmChannel;
+    if (region != nullptr) {
+      chan = transport->open_loopback_channel(std::move(region), false);
+    } else if (kShmChannels) {
+      chan = transport->open_shm_channel(shm_channel_name(sm_pkt.uniq_token), false);
+    }
+    if (chan != TTransport::kInvalidShmChannel) {
+      TTransport::set_shm_channel(&session->client.routing_info, chan);
+      session->server.shm_channel = true;
+    }
+  }
 
   session->local_session_num = session->server.session_num;
   session->remote_session_num = session->client.session_num;
+  session->remote_rpc_id = session->client.rpc_id;
 
-  alloc_ring_entries();
   session_vec.push_back(session);  // Add to list of all sessions
 
   // Add server endpoint info created above to resp. No need to add client info.
@@ -94,7 +131,8 @@ void Rpc::handle_connect_req_st(const SmPkt &sm_pkt) {
   return;
 }
 
-void Rpc::handle_connect_resp_st(const SmPkt &sm_pkt) {
+template <class TTransport>
+void Rpc<TTransport>::handle_connect_resp_st(const SmPkt &sm_pkt) {
   assert(in_dispatch());
   assert(sm_pkt.pkt_type == SmPktType::kConnectResp &&
          sm_pkt.client.rpc_id == rpc_id);
@@ -139,7 +177,6 @@ void Rpc::handle_connect_resp_st(const SmPkt &sm_pkt) {
     ERPC_WARN("%s: Error %s.\n", issue_msg,
               sm_err_type_str(sm_pkt.err_type).c_str());
 
-    free_ring_entries();  // Free before callback to allow creating new session
     sm_handler(session->local_session_num, SmEventType::kConnectFailed,
                sm_pkt.err_type, context);
     bury_session_st(session);
@@ -149,13 +186,34 @@ void Rpc::handle_connect_resp_st(const SmPkt &sm_pkt) {
 
   // If we are here, the server has created a session endpoint
 
-  // Save server endpoint metadata
-  Transport::RoutingInfo rrouting_info = session->server.routing_info;
+  // Save server endpoint metadata. The server's datapath port is known only
+  // now, so resolve the routing info here.
+  size_t chan = TTransport::get_shm_channel(&session->server.routing_info);
   session->server = sm_pkt.server;  // This fills most fields
-  session->server.routing_info = rrouting_info;
+  session->server.routing_info = TTransport::make_routing_info(
+      sm_pkt.server.hostname, sm_pkt.server.data_udp_port);
+  TTransport::set_dgram_split(&session->server.routing_info,
+                              sm_pkt.server.dgram_split);
   session->remote_session_num = session->server.session_num;
+  session->remote_rpc_id = session->server.rpc_id;
   session->state = SessionState::kConnected;
 
+  // Adopt the request window and credits that the server granted
+  if (sm_pkt.server.req_window != session->req_window) {
+    session->init_sslots(sm_pkt.server.req_window);
+  }
+  session->max_credits = sm_pkt.server.credits;
+
+  if (chan != TTransport::kInvalidShmChannel) {
+    if (sm_pkt.server.shm_channel) {
+      TTransport::set_shm_channel(&session->server.routing_info, chan);
+    } else {
+      // Fall back to UDP if the server didn't take our shared-memory channel
+      nexus->take_loopback_region(session->uniq_token);  // Drop an untaken offer
+      transport->close_shm_channel(chan);
+    }
+  }
+
   session->client_info.cc.prev_desired_tx_tsc = rdtsc();
 
   ERPC_INFO("%s: None. Session connected.\n", issue_msg);
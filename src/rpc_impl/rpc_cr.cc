@@ -2,35 +2,132 @@
 
 namespace erpc {
 
-void Rpc::enqueue_cr_st(SSlot *sslot, const pkthdr_t *req_pkthdr) {
+// A CR's SACK bitmap must cover all packets it answers, and the largest RTO
+// must cover the CR delay that update_rto() adds
+static_assert(kCrBatchPkts >= 1 && kCrBatchPkts <= kSackBits + 1, "");
+static_assert(kCrDelayUs + kRpcMinRTOUs <= kRpcRTOUs, "");
+
+template <class TTransport>
+void Rpc<TTransport>::enqueue_cr_st(SSlot *sslot, uint8_t req_type,
+                                    size_t pkt_num, bool delayed) {
   assert(in_dispatch());
 
   MsgBuffer *ctrl_msgbuf = &ctrl_msgbufs[ctrl_msgbuf_head];
   ctrl_msgbuf_head++;
-  if (ctrl_msgbuf_head == Transport::kCtrlBufferSize) ctrl_msgbuf_head = 0;
+  if (ctrl_msgbuf_head == TTransport::kCtrlBufferSize) ctrl_msgbuf_head = 0;
 
-  // Fill in the CR packet header. Avoid copying req_pkthdr's headroom.
+  // Fill in the CR packet header
   pkthdr_t *cr_pkthdr = ctrl_msgbuf->get_pkthdr_0();
-  cr_pkthdr->req_type = req_pkthdr->req_type;
+  cr_pkthdr->req_type = req_type;
+  cr_pkthdr->dest_rpc_id = sslot->session->remote_rpc_id;
   cr_pkthdr->msg_size = 0;
   cr_pkthdr->dest_session_num = sslot->session->remote_session_num;
   cr_pkthdr->pkt_type = kPktTypeExplCR;
-  cr_pkthdr->pkt_num = req_pkthdr->pkt_num;
-  cr_pkthdr->req_num = req_pkthdr->req_num;
+  cr_pkthdr->pkt_num = pkt_num;
+  cr_pkthdr->req_num = sslot->cur_req_num;
   cr_pkthdr->magic = kPktHdrMagic;
+  cr_pkthdr->credit_grant = sslot->session->server_info.credits;
+  cr_pkthdr->sack = sack_bitmap_server(sslot, pkt_num);
+  cr_pkthdr->delayed = delayed ? 1 : 0;
 
   enqueue_hdr_tx_burst_st(sslot, ctrl_msgbuf, nullptr);
 }
 
-void Rpc::process_expl_cr_st(SSlot *sslot, const pkthdr_t *pkthdr,
+template <class TTransport>
+void Rpc<TTransport>::add_pending_cr_st(SSlot *sslot,
+                                        const pkthdr_t *req_pkthdr) {
+  assert(in_dispatch());
+  auto &si = sslot->server_info;
+  const size_t pkt_num = req_pkthdr->pkt_num;
+
+  if (si.cr_num_pkts == 0) {
+    si.cr_pkt_lo = pkt_num;
+    si.cr_pkt_hi = pkt_num;
+    si.cr_req_type = req_pkthdr->req_type;
+    si.cr_first_tsc = ev_loop_tsc;
+  } else {
+    // The CR is for the largest packet number, and its SACK bitmap reaches
+    // back kSackBits packets. Send the pending CR if this packet doesn't fit.
+    const size_t lo = std::min(si.cr_pkt_lo, pkt_num);
+    const size_t hi = std::max(si.cr_pkt_hi, pkt_num);
+    if (hi - lo > kSackBits) {
+      send_pending_cr_st(sslot);
+      add_pending_cr_st(sslot, req_pkthdr);
+      return;
+    }
+    si.cr_pkt_lo = lo;
+    si.cr_pkt_hi = hi;
+  }
+  if (pkt_num == si.cr_pkt_hi) si.cr_tsc = ev_loop_tsc;
+
+  Session *session = sslot->session;
+  si.cr_num_pkts++;
+  session->server_info.cr_num_pkts++;
+  if (!si.cr_listed) {
+    si.cr_listed = true;
+    cr_pending_sslots.push_back(sslot);
+  }
+
+  // Answer without delay the first packet, because a client that starts a
+  // request after idling may have reset its credit limit, and a packet that
+  // fills a gap, e.g., a retransmission that the client's window waits for.
+  // A slow (paced) request's CR goes out when a packet arrives after the
+  // delay, so that the client still gets undelayed RTT samples.
+  const bool filled_gap = si.rx_base > pkt_num + 1;
+  const bool aged = ev_loop_tsc - si.cr_first_tsc >= rpc_cr_delay_cycles;
+  if (si.num_rx == 1 || filled_gap || aged ||
+      si.cr_num_pkts == kCrBatchPkts) {
+    send_pending_cr_st(sslot);
+  }
+
+  // Don't let the client run out of credits while its requests' CRs wait
+  const size_t credits = session->server_info.credits;
+  if (session->server_info.cr_num_pkts >=
+      std::max(credits / 2, kSessionMinCredits)) {
+    for (SSlot &s : session->sslot_arr) send_pending_cr_st(&s);
+  }
+}
+
+template <class TTransport>
+void Rpc<TTransport>::send_pending_cr_st(SSlot *sslot) {
+  assert(in_dispatch());
+  auto &si = sslot->server_info;
+  if (si.cr_num_pkts == 0) return;
+
+  const bool delayed = si.cr_tsc != ev_loop_tsc;
+  enqueue_cr_st(sslot, si.cr_req_type, si.cr_pkt_hi, delayed);
+  cancel_pending_cr_st(sslot);
+}
+
+template <class TTransport>
+void Rpc<TTransport>::process_pending_crs_st() {
+  assert(in_dispatch());
+
+  for (size_t i = 0; i < cr_pending_sslots.size();) {
+    SSlot *sslot = cr_pending_sslots[i];
+    auto &si = sslot->server_info;
+    if (si.cr_num_pkts > 0 && ev_loop_tsc - si.cr_tsc < rpc_cr_delay_cycles) {
+      i++;  // Wait for more packets
+      continue;
+    }
+
+    send_pending_cr_st(sslot);
+    si.cr_listed = false;
+    cr_pending_sslots[i] = cr_pending_sslots.back();
+    cr_pending_sslots.pop_back();
+  }
+}
+
+template <class TTransport>
+void Rpc<TTransport>::process_expl_cr_st(SSlot *sslot, const pkthdr_t *pkthdr,
                                   size_t rx_tsc) {
   assert(in_dispatch());
   assert(pkthdr->req_num <= sslot->cur_req_num);
 
-  // Handle reordering
-  if (unlikely(!in_order_client(sslot, pkthdr))) {
+  // Handle reordering and duplicates
+  if (unlikely(!fresh_reply_client(sslot, pkthdr))) {
     ERPC_REORDER(
-        "Rpc %u, lsn %u (%s): Received out-of-order CR. "
+        "Rpc %u, lsn %u (%s): Received stale CR. "
         "Packet %zu/%zu, sslot: %zu/%s. Dropping.\n",
         rpc_id, sslot->session->local_session_num,
         sslot->session->get_remote_hostname().c_str(), pkthdr->req_num,
@@ -38,14 +135,63 @@ void Rpc::process_expl_cr_st(SSlot *sslot, const pkthdr_t *pkthdr,
     return;
   }
 
-  // Update client tracking metadata
-  if (kCcRateComp) update_timely_rate(sslot, pkthdr->pkt_num, rx_tsc);
-  bump_credits(sslot->session);
-  sslot->client_info.num_rx++;
-  sslot->client_info.progress_tsc = ev_loop_tsc;
+  auto &ci = sslot->client_info;
+  const size_t pkt_num = pkthdr->pkt_num;
+
+  // The CR answers its own packet, and through its SACK bitmap, CRs for
+  // earlier request packets that were lost. Shift the SACK bitmap so that bit
+  // i is packet (ack_base + i), and keep only packets that CRs answer.
+  uint64_t mask = 1ull << (pkt_num - ci.ack_base);
+  if (pkt_num >= ci.ack_base + kSackBits) {
+    mask |= static_cast<uint64_t>(pkthdr->sack) << (pkt_num - kSackBits - ci.ack_base);
+  } else {
+    mask |= static_cast<uint64_t>(pkthdr->sack) >> (ci.ack_base + kSackBits - pkt_num);
+  }
+  const size_t cr_end = std::min(ci.num_tx, sslot->tx_msgbuf->num_pkts - 1);
+  mask &= low_bits(cr_end - ci.ack_base);
+
+  // Update client tracking metadata. A delayed CR's RTT is not the network's.
+  if (likely(pkthdr->delayed == 0)) {
+    if (kCcRateComp) update_timely_rate(sslot, pkt_num, rx_tsc);
+    update_rto(sslot, pkt_num, rx_tsc);
+  }
+  ack_pkts_client(sslot, pkthdr, mask);
+  if (unlikely(ci.ack_bitmap != 0)) pkt_loss_fast_retransmit_st(sslot);
+  ci.progress_tsc = ev_loop_tsc;
 
   // If we've transmitted all request pkts, there's nothing more to TX yet
-  if (req_pkts_pending(sslot)) kick_req_st(sslot);  // credits >= 1
+  if (req_pkts_pending(sslot)) tx_sched_st(sslot);
+}
+
+template <class TTransport>
+void Rpc<TTransport>::reclaim_credits_st() {
+  assert(in_dispatch());
+
+  for (size_t i = 0; i < credit_borrowers.size();) {
+    Session *session = credit_borrowers[i];
+    if (session->server_info.active) {
+      session->server_info.active = false;  // Check again next epoch
+      i++;
+      continue;
+    }
+
+    // The client's credit limit has decayed, so it won't use these credits
+    credit_pool += session->server_info.credits - kSessionMinCredits;
+    session->server_info.credits = kSessionMinCredits;
+    credit_borrowers[i] = credit_borrowers.back();
+    credit_borrowers.pop_back();
+  }
+}
+
+template <class TTransport>
+void Rpc<TTransport>::return_lent_credits_st(Session *session) {
+  assert(in_dispatch() && session->is_server());
+  if (session->server_info.credits == kSessionMinCredits) return;
+
+  credit_pool += session->server_info.credits - kSessionMinCredits;
+  session->server_info.credits = kSessionMinCredits;
+  credit_borrowers.erase(
+      std::find(credit_borrowers.begin(), credit_borrowers.end(), session));
 }
 
 FORCE_COMPILE_TRANSPORTS
@@ -8,7 +8,8 @@ namespace erpc {
 
 // We don't need to check remote arguments since the session was already
 // connected successfully.
-void Rpc::handle_disconnect_req_st(const SmPkt &sm_pkt) {
+template <class TTransport>
+void Rpc<TTransport>::handle_disconnect_req_st(const SmPkt &sm_pkt) {
   assert(in_dispatch());
   assert(sm_pkt.pkt_type == SmPktType::kDisconnectReq &&
          sm_pkt.server.rpc_id == rpc_id);
@@ -42,12 +43,10 @@ void Rpc::handle_disconnect_req_st(const SmPkt &sm_pkt) {
 
     // If there's a response in this sslot, we've finished sending it
     if (sslot.tx_msgbuf != nullptr) {
-      assert(si.num_rx == si.sav_num_req_pkts + sslot.tx_msgbuf->num_pkts - 1);
+      assert(si.num_rx == si.resp_pkt_base + sslot.tx_msgbuf->num_pkts);
     }
   }
 
-  free_ring_entries();
-
   ERPC_INFO("%s. None. Sending response.\n", issue_msg);
   sm_pkt_udp_tx_st(sm_construct_resp(sm_pkt, SmErrType::kNoError));
 
@@ -56,7 +55,8 @@ void Rpc::handle_disconnect_req_st(const SmPkt &sm_pkt) {
 
 // We free the session's ring bufs before sending the disconnect request, so
 // not here.
-void Rpc::handle_disconnect_resp_st(const SmPkt &sm_pkt) {
+template <class TTransport>
+void Rpc<TTransport>::handle_disconnect_resp_st(const SmPkt &sm_pkt) {
   assert(in_dispatch());
   assert(sm_pkt.pkt_type == SmPktType::kDisconnectResp &&
          sm_pkt.client.rpc_id == rpc_id);
@@ -84,7 +84,6 @@ void Rpc::handle_disconnect_resp_st(const SmPkt &sm_pkt) {
   assert(session->server == sm_pkt.server);
 
   ERPC_INFO("%s: None. Session disconnected.\n", issue_msg);
-  free_ring_entries();  // Free before callback to allow creating a new session
   sm_handler(session->local_session_num, SmEventType::kDisconnected,
              SmErrType::kNoError, context);
   bury_session_st(session);
@@ -2,28 +2,31 @@
 
 namespace erpc {
 
-void Rpc::run_event_loop_do_one_st() {
+template <class TTransport>
+void Rpc<TTransport>::run_event_loop_do_one_st() {
   assert(in_dispatch());
   dpath_stat_inc(dpath_stats.ev_loop_calls, 1);
 
   // Handle any new session management packets
-  if (unlikely(nexus_hook.sm_rx_queue.size > 0)) handle_sm_rx_st();
+  if (unlikely(!nexus_hook.sm_rx_queue.empty())) handle_sm_rx_st();
 
   // The packet RX code uses ev_loop_tsc as the RX timestamp, so it must be
   // next to ev_loop_tsc stamping.
   ev_loop_tsc = dpath_rdtsc();
   process_comps_st();  // RX
+  if (unlikely(!cr_pending_sslots.empty())) process_pending_crs_st();
 
-  process_credit_stall_queue_st();    // TX
+  process_tx_queues_st();             // TX
   if (kCcPacing) process_wheel_st();  // TX
 
   // Drain all packets
-  if (tx_batch_i > 0) do_tx_burst_st();
+  if (tx_batch_i + tx_batch_hi_i > 0) do_tx_burst_st();
 
   if (unlikely(multi_threaded)) {
     // Process the background queues
     process_bg_queues_enqueue_request_st();
     process_bg_queues_enqueue_response_st();
+    if (unlikely(bg_overflow_size > 0)) process_bg_overflow_st();
   }
 
   // Check for packet loss if we're in a new epoch. ev_loop_tsc is stale by
@@ -32,9 +35,16 @@ void Rpc::run_event_loop_do_one_st() {
     pkt_loss_scan_tsc = ev_loop_tsc;
     pkt_loss_scan_st();
   }
+
+  // Reclaim idle lent credits at a coarser, fixed epoch
+  if (unlikely(ev_loop_tsc - credit_scan_tsc > rpc_credit_scan_cycles)) {
+    credit_scan_tsc = ev_loop_tsc;
+    reclaim_credits_st();
+  }
 }
 
-void Rpc::run_event_loop_timeout_st(size_t timeout_ms) {
+template <class TTransport>
+void Rpc<TTransport>::run_event_loop_timeout_st(size_t timeout_ms) {
   assert(in_dispatch());
 
   size_t timeout_tsc = ms_to_cycles(timeout_ms, freq_ghz);
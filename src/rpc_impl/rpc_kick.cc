@@ -2,13 +2,17 @@
 
 namespace erpc {
 
-void Rpc::kick_req_st(SSlot *sslot) {
+template <class TTransport>
+size_t Rpc<TTransport>::kick_req_st(SSlot *sslot, size_t max_pkts) {
   assert(in_dispatch());
   auto &credits = sslot->session->client_info.credits;
   assert(credits > 0);  // Precondition
 
+  // Don't send past the end of the ack bitmap, even if we have credits
   auto &ci = sslot->client_info;
-  size_t sending = std::min(credits, sslot->tx_msgbuf->num_pkts - ci.num_tx);
+  size_t sending = std::min({credits, max_pkts,
+                             sslot->tx_msgbuf->num_pkts - ci.num_tx,
+                             ci.ack_base + kSessionCredits - ci.num_tx});
   bool bypass = can_bypass_wheel(sslot);
 
   for (size_t _x = 0; _x < sending; _x++) {
@@ -22,28 +26,39 @@ void Rpc::kick_req_st(SSlot *sslot) {
     ci.num_tx++;
     credits--;
   }
+
+  // The request may have waited for credits in the TX queue
+  ci.progress_tsc = ev_loop_tsc;
+  return sending;
 }
 
 // We're asked to send RFRs, which means that we have recieved the first
-// response packet, but not the entire response. The latter implies that a
-// background continuation cannot invalidate resp_msgbuf.
-void Rpc::kick_rfr_st(SSlot *sslot) {
+// response packet, but not the entire response, or that we're pulling the next
+// chunk of a chunked response. Either way, a background continuation cannot
+// invalidate resp_msgbuf.
+template <class TTransport>
+size_t Rpc<TTransport>::kick_rfr_st(SSlot *sslot, size_t max_pkts) {
   assert(in_dispatch());
   auto &credits = sslot->session->client_info.credits;
   auto &ci = sslot->client_info;
 
   assert(credits > 0);  // Precondition
   assert(ci.num_rx >= sslot->tx_msgbuf->num_pkts);
-  assert(ci.num_rx < wire_pkts(sslot->tx_msgbuf, ci.resp_msgbuf));
+  assert(ci.num_tx < resp_end_client(sslot));
 
   // TODO: Pace RFRs
-  size_t rfr_pndng = wire_pkts(sslot->tx_msgbuf, ci.resp_msgbuf) - ci.num_tx;
-  size_t sending = std::min(credits, rfr_pndng);  // > 0
+  size_t rfr_pndng = resp_end_client(sslot) - ci.num_tx;
+  size_t sending = std::min({credits, max_pkts, rfr_pndng,
+                             ci.ack_base + kSessionCredits - ci.num_tx});
   for (size_t _x = 0; _x < sending; _x++) {
-    enqueue_rfr_st(sslot, ci.resp_msgbuf->get_pkthdr_0());
+    enqueue_rfr_st(sslot, ci.resp_msgbuf->get_pkthdr_0(), ci.num_tx);
     ci.num_tx++;
     credits--;
   }
+
+  // The request may have waited for credits in the TX queue
+  ci.progress_tsc = ev_loop_tsc;
+  return sending;
 }
 
 FORCE_COMPILE_TRANSPORTS
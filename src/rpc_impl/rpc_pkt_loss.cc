@@ -6,17 +6,30 @@
 
 namespace erpc {
 
-// This handles both datapath and management packet loss. This is called
-// rarely, so no need to optimize heavily.
-void Rpc::pkt_loss_scan_st() {
+// This handles both datapath and management packet loss. This is called once
+// per RTO wheel tick, and checks only requests whose deadline bucket expired.
+template <class TTransport>
+void Rpc<TTransport>::pkt_loss_scan_st() {
   assert(in_dispatch());
 
-  // Datapath packet loss
-  SSlot *cur = active_rpcs_root_sentinel.client_info.next;  // The iterator
-  while (cur != &active_rpcs_tail_sentinel) {
+  // Datapath packet loss. Only requests whose RTO wheel bucket has expired are
+  // checked, and each is re-inserted at its current deadline.
+  SSlot *cur;
+  while ((cur = rto_wheel.pop_expired(ev_loop_tsc)) != nullptr) {
+    auto &ci = cur->client_info;
+
+    if (unlikely(ci.deadline_tsc != 0 && ev_loop_tsc >= ci.deadline_tsc)) {
+      ERPC_REORDER("Rpc %u, lsn %u: Request %zu timed out (%s). Failing.\n",
+                   rpc_id, cur->session->local_session_num, cur->cur_req_num,
+                   cur->progress_str().c_str());
+      fail_request_st(cur, RespStatus::kTimedOut);
+      continue;
+    }
+
     // Don't re-tx or check for server failure if we're just stalled on credits
-    if (cur->client_info.num_tx == cur->client_info.num_rx) {
-      cur = cur->client_info.next;
+    // or pacing. The RTO starts when the last paced packet leaves the wheel.
+    if (ci.num_tx == ci.num_rx || ci.wheel_count > 0) {
+      rto_wheel_insert_st(cur, ev_loop_tsc + req_rto_tsc(cur));
       continue;
     }
 
@@ -35,6 +48,7 @@ void Rpc::pkt_loss_scan_st() {
         ERPC_REORDER(
             "Rpc %u, lsn %u: Could not reset because packets still in wheel.\n",
             rpc_id, cur->session->local_session_num);
+        rto_wheel_insert_st(cur, ev_loop_tsc + req_rto_tsc(cur));
         continue;
       }
 
@@ -43,20 +57,20 @@ void Rpc::pkt_loss_scan_st() {
                 rpc_id, cur->session->local_session_num);
       drain_tx_batch_and_dma_queue();
 
-      // In this case, we will delete sslots of this session from the active RPC
-      // list, including the current slot. Re-start the scan to handle this.
+      // This deletes sslots of this session from the active RPC list and the
+      // RTO wheel
       handle_reset_client_st(cur->session);
-      cur = active_rpcs_root_sentinel.client_info.next;
       continue;
     }
 
     // If the server hasn't failed, check for packet loss
-    if (ev_loop_tsc - cur->client_info.progress_tsc > rpc_rto_cycles) {
+    if (ev_loop_tsc - ci.progress_tsc > req_rto_tsc(cur)) {
       pkt_loss_retransmit_st(cur);
       drain_tx_batch_and_dma_queue();
     }
 
-    cur = cur->client_info.next;
+    // Retransmission updates progress_tsc and backs off the RTO
+    rto_wheel_insert_st(cur, ci.progress_tsc + req_rto_tsc(cur));
   }
 
   // Management packet loss
@@ -78,12 +92,12 @@ void Rpc::pkt_loss_scan_st() {
   }
 }
 
-void Rpc::pkt_loss_retransmit_st(SSlot *sslot) {
+template <class TTransport>
+void Rpc<TTransport>::pkt_loss_retransmit_st(SSlot *sslot) {
   assert(in_dispatch());
   assert(sslot->tx_msgbuf != nullptr);  // sslot has a valid request
 
   auto &ci = sslot->client_info;
-  auto &credits = sslot->session->client_info.credits;
   MsgBuffer *req_msgbuf = sslot->tx_msgbuf;
 
   char issue_msg[kMaxIssueMsgLen];  // The basic issue message
@@ -93,36 +107,80 @@ void Rpc::pkt_loss_retransmit_st(SSlot *sslot) {
           sslot->session->get_remote_hostname().c_str(),
           req_msgbuf->get_pkthdr_0()->req_num, sslot->progress_str().c_str());
 
-  const size_t delta = ci.num_tx - ci.num_rx;
-  assert(credits + delta <= kSessionCredits);
-
-  if (unlikely(delta == 0)) {
+  if (unlikely(ci.num_tx == ci.num_rx)) {
     ERPC_REORDER("%s: False positive. Ignoring.\n", issue_msg);
     return;
   }
 
-  // We have num_tx > num_rx, so stallq cannot contain sslot
-  assert(std::find(stallq.begin(), stallq.end(), sslot) == stallq.end());
+  // Retransmit only the unanswered packets. They already hold credits, and the
+  // server's replies tell us which ones it received, so there's no roll back.
+  pkt_loss_stats.num_re_tx++;
+  sslot->session->client_info.num_re_tx++;
+  ERPC_REORDER("%s: Retransmitting %zu unanswered packets.\n", issue_msg,
+               ci.num_tx - ci.num_rx);
 
-  // Do not roll back if this request still has packets in the wheel. Deleting
-  // from the wheel is too complex.
-  if (unlikely(sslot->client_info.wheel_count > 0)) {
-    pkt_loss_stats.still_in_wheel_during_retx++;
-    ERPC_REORDER("%s: Packets still in wheel. Ignoring.\n", issue_msg);
-    return;
+  for (size_t pkt_num = ci.ack_base; pkt_num < ci.num_tx; pkt_num++) {
+    if ((ci.ack_bitmap >> (pkt_num - ci.ack_base)) & 1) continue;
+    pkt_loss_resend_pkt_st(sslot, pkt_num);
   }
 
-  // If we're here, we will roll back and retransmit
-  pkt_loss_stats.num_re_tx++;
-  sslot->session->client_info.num_re_tx++;
+  // Back off exponentially until the next valid RTT sample
+  auto &rto = sslot->session->client_info.rto;
+  rto.rto_tsc = std::min(2 * rto.rto_tsc, rpc_rto_cycles);
 
-  ERPC_REORDER("%s: Retransmitting %s.\n", issue_msg,
-               ci.num_rx < req_msgbuf->num_pkts ? "requests" : "RFRs");
-  credits += delta;
-  ci.num_tx = ci.num_rx;
+  ci.re_tx = true;
   ci.progress_tsc = ev_loop_tsc;
+}
+
+template <class TTransport>
+void Rpc<TTransport>::pkt_loss_fast_retransmit_st(SSlot *sslot) {
+  assert(in_dispatch());
+  auto &ci = sslot->client_info;
+  assert(ci.ack_bitmap != 0);  // Packet ack_base is missing
+
+  // Packets before fast_end are considered lost
+  const size_t max_acked = ci.ack_base + 63 -
+                           static_cast<size_t>(__builtin_clzll(ci.ack_bitmap));
+  if (max_acked < kFastRetxThresh) return;
+  const size_t fast_end = max_acked + 1 - kFastRetxThresh;
+  const size_t fast_begin = std::max(ci.ack_base, ci.fast_retx_end);
+  if (fast_end <= fast_begin) return;
+
+  ERPC_REORDER(
+      "Rpc %u, lsn %u: Fast retransmit for req %zu, pkts [%zu, %zu).\n",
+      rpc_id, sslot->session->local_session_num, sslot->cur_req_num,
+      fast_begin, fast_end);
+  pkt_loss_stats.num_fast_re_tx++;
+
+  for (size_t pkt_num = fast_begin; pkt_num < fast_end; pkt_num++) {
+    if ((ci.ack_bitmap >> (pkt_num - ci.ack_base)) & 1) continue;
+    pkt_loss_resend_pkt_st(sslot, pkt_num);
+  }
 
-  req_pkts_pending(sslot) ? kick_req_st(sslot) : kick_rfr_st(sslot);
+  ci.fast_retx_end = fast_end;
+  ci.re_tx = true;
+
+  // The retransmitted packets must not reference the request after completion
+  drain_tx_batch_and_dma_queue();
+}
+
+template <class TTransport>
+void Rpc<TTransport>::pkt_loss_resend_pkt_st(SSlot *sslot, size_t pkt_num) {
+  auto &ci = sslot->client_info;
+  MsgBuffer *req_msgbuf = sslot->tx_msgbuf;
+
+  // Packets in the wheel haven't been sent yet
+  const size_t crd_i = pkt_num % kSessionCredits;
+  if (kCcPacing && ci.in_wheel[crd_i]) {
+    pkt_loss_stats.still_in_wheel_during_retx++;
+    return;
+  }
+
+  if (pkt_num < req_msgbuf->num_pkts) {
+    enqueue_pkt_tx_burst_st(sslot, pkt_num /* pkt_idx */, &ci.tx_ts[crd_i]);
+  } else {
+    enqueue_rfr_st(sslot, ci.resp_msgbuf->get_pkthdr_0(), pkt_num);
+  }
 }
 
 FORCE_COMPILE_TRANSPORTS
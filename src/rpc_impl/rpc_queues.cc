@@ -2,23 +2,40 @@
 
 namespace erpc {
 
-void Rpc::process_credit_stall_queue_st() {
+template <class TTransport>
+void Rpc<TTransport>::process_tx_queues_st() {
   assert(in_dispatch());
-  size_t write_index = 0;  // Re-add incomplete sslots at this index
 
-  for (SSlot *sslot : stallq) {
-    if (sslot->session->client_info.credits > 0) {
-      // sslots in stall queue have packets to send
-      req_pkts_pending(sslot) ? kick_req_st(sslot) : kick_rfr_st(sslot);
-    } else {
-      stallq[write_index++] = sslot;
+  for (Session *session : tx_ready_sessions) {
+    auto &sci = session->client_info;
+    sci.tx_ready = false;
+
+    while (sci.credits > 0 && sci.tx_head != nullptr) {
+      SSlot *sslot = sci.tx_head;
+      auto &ci = sslot->client_info;
+
+      // Requests blocked by their ack window are re-queued by their next ack
+      if (!can_tx(sslot)) {
+        tx_queue_pop(session);
+        continue;
+      }
+
+      // A request keeps the rest of its turn if credits run out mid-turn
+      if (ci.tx_deficit == 0) ci.tx_deficit = kTxQuantumPkts;
+      ci.tx_deficit -= kick_st(sslot, ci.tx_deficit);
+
+      if (ci.tx_deficit == 0 || !can_tx(sslot)) {
+        tx_queue_pop(session);
+        if (can_tx(sslot)) tx_queue_push(session, sslot);  // Next round
+      }
     }
   }
 
-  stallq.resize(write_index);  // Number of sslots left = write_index
+  tx_ready_sessions.clear();
 }
 
-void Rpc::process_wheel_st() {
+template <class TTransport>
+void Rpc<TTransport>::process_wheel_st() {
   assert(in_dispatch());
   size_t cur_tsc = dpath_rdtsc();
   wheel->reap(cur_tsc);
@@ -37,42 +54,76 @@ void Rpc::process_wheel_st() {
             to_usec(cur_tsc - creation_tsc, freq_ghz));
 
     auto &ci = sslot->client_info;
+    if (unlikely(ci.fail_status != RespStatus::kOk)) {
+      // The request is failing, so drop the packet and finish the failure
+      // once the request's last packet leaves the wheel
+      ci.wheel_count--;
+      ci.in_wheel[crd_i] = false;
+      wheel->ready_queue.pop();
+      if (ci.wheel_count == 0) fail_request_st(sslot, ci.fail_status);
+      continue;
+    }
+
     if (pkt_num < sslot->tx_msgbuf->num_pkts) {
       enqueue_pkt_tx_burst_st(sslot, pkt_num /* pkt_idx */, &ci.tx_ts[crd_i]);
     } else {
       MsgBuffer *resp_msgbuf = ci.resp_msgbuf;
-      enqueue_rfr_st(sslot, resp_msgbuf->get_pkthdr_0());
+      enqueue_rfr_st(sslot, resp_msgbuf->get_pkthdr_0(), pkt_num);
     }
 
-    sslot->client_info.wheel_count--;
-    sslot->client_info.in_wheel[crd_i] = false;
+    ci.progress_tsc = ev_loop_tsc;  // The packet is sent only now
+    ci.wheel_count--;
+    ci.in_wheel[crd_i] = false;
     wheel->ready_queue.pop();
   }
 }
 
-void Rpc::process_bg_queues_enqueue_request_st() {
+template <class TTransport>
+void Rpc<TTransport>::process_bg_queues_enqueue_request_st() {
   assert(in_dispatch());
-  auto &queue = bg_queues._enqueue_request;
-  const size_t cmds_to_process = queue.size;  // Reduce cache line traffic
+  enq_req_args_t batch[kBgQueuePopBatch];
+  const size_t num_cmds =
+      bg_queues._enqueue_request.pop_batch(batch, kBgQueuePopBatch);
 
-  for (size_t i = 0; i < cmds_to_process; i++) {
-    enq_req_args_t args = queue.unlocked_pop();
+  for (size_t i = 0; i < num_cmds; i++) {
+    const enq_req_args_t &args = batch[i];
     enqueue_request(args.session_num, args.req_type, args.req_msgbuf,
-                    args.resp_msgbuf, args.cont_func, args.tag, args.cont_etid);
+                    args.resp_msgbuf, args.cont_func, args.tag, args.cont_etid,
+                    args.deadline_tsc);
   }
 }
 
-void Rpc::process_bg_queues_enqueue_response_st() {
+template <class TTransport>
+void Rpc<TTransport>::process_bg_queues_enqueue_response_st() {
   assert(in_dispatch());
-  auto &queue = bg_queues._enqueue_response;
-  const size_t cmds_to_process = queue.size;  // Reduce cache line traffic
+  enq_resp_args_t batch[kBgQueuePopBatch];
+  const size_t num_cmds =
+      bg_queues._enqueue_response.pop_batch(batch, kBgQueuePopBatch);
 
-  for (size_t i = 0; i < cmds_to_process; i++) {
-    enq_resp_args_t enq_resp_args = queue.unlocked_pop();
+  for (size_t i = 0; i < num_cmds; i++) {
+    const enq_resp_args_t &enq_resp_args = batch[i];
+    if (unlikely(enq_resp_args.is_chunk)) {
+      enqueue_response_chunk_st(static_cast<SSlot *>(enq_resp_args.req_handle),
+                                enq_resp_args.chunk);
+      continue;
+    }
     enqueue_response(enq_resp_args.req_handle, enq_resp_args.resp_msgbuf);
   }
 }
 
+template <class TTransport>
+void Rpc<TTransport>::process_bg_overflow_st() {
+  assert(in_dispatch());
+  for (size_t i = 0; i < nexus->num_bg_threads; i++) {
+    auto &overflow = bg_overflow[i];
+    auto *req_queue = nexus_hook.bg_req_queue_arr[i];
+    while (!overflow.empty() && req_queue->try_push(overflow.front())) {
+      overflow.pop_front();
+      bg_overflow_size--;
+    }
+  }
+}
+
 FORCE_COMPILE_TRANSPORTS
 
 }  // namespace erpc
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <stdexcept>
 
 #include "rpc.h"
@@ -6,15 +7,17 @@ namespace erpc {
 
 // The cont_etid parameter is passed only when the event loop processes the
 // background threads' queue of enqueue_request calls.
-void Rpc::enqueue_request(int session_num, uint8_t req_type,
+template <class TTransport>
+void Rpc<TTransport>::enqueue_request(int session_num, uint8_t req_type,
                                MsgBuffer *req_msgbuf, MsgBuffer *resp_msgbuf,
                                erpc_cont_func_t cont_func, void *tag,
-                               size_t cont_etid) {
+                               size_t cont_etid, size_t deadline_tsc) {
   // When called from a background thread, enqueue to the foreground thread
   if (unlikely(!in_dispatch())) {
-    auto req_args = enq_req_args_t(session_num, req_type, req_msgbuf,
-                                   resp_msgbuf, cont_func, tag, get_etid());
-    bg_queues._enqueue_request.unlocked_push(req_args);
+    auto req_args =
+        enq_req_args_t(session_num, req_type, req_msgbuf, resp_msgbuf,
+                       cont_func, tag, get_etid(), deadline_tsc);
+    bg_queues._enqueue_request.push(req_args);
     return;
   }
 
@@ -22,41 +25,84 @@ void Rpc::enqueue_request(int session_num, uint8_t req_type,
   Session *session = session_vec[static_cast<size_t>(session_num)];
   assert(session->is_connected());  // User is notified before we disconnect
 
-  // If a free sslot is unavailable, save to session backlog
+  // Fail requests whose deadline passed, e.g., while they were backlogged
+  if (unlikely(deadline_tsc != 0 && ev_loop_tsc >= deadline_tsc)) {
+    fail_unsent_request_st(
+        enq_req_args_t(session_num, req_type, req_msgbuf, resp_msgbuf,
+                       cont_func, tag, cont_etid, deadline_tsc),
+        RespStatus::kTimedOut);
+    return;
+  }
+
+  // If a free sslot is unavailable, save to session backlog. High-priority
+  // requests wait ahead of normal ones.
   if (unlikely(session->client_info.sslot_free_vec.size() == 0)) {
-    session->client_info.enq_req_backlog.emplace(session_num, req_type,
-                                                 req_msgbuf, resp_msgbuf,
-                                                 cont_func, tag, cont_etid);
+    auto &backlog = session->client_info.enq_req_backlog;
+    auto it = backlog.end();
+    if (unlikely(is_high_prio(req_type))) {
+      it = backlog.begin();
+      while (it != backlog.end() && is_high_prio(it->req_type)) it++;
+    }
+
+    backlog.emplace(it, session_num, req_type, req_msgbuf, resp_msgbuf,
+                    cont_func, tag, cont_etid, deadline_tsc);
     return;
   }
 
+  // The server takes back lent credits after a scan epoch without packets
+  // from us. Assume that it did if we've been idle for half an epoch.
+  auto &sci = session->client_info;
+  if (sci.credit_limit > kSessionMinCredits && sci.credits == sci.credit_limit &&
+      ev_loop_tsc - sci.last_req_tsc > rpc_credit_scan_cycles / 2) {
+    set_credit_limit(session, kSessionMinCredits);
+  }
+  sci.last_req_tsc = ev_loop_tsc;
+
   // Fill in the sslot info
-  size_t sslot_i = session->client_info.sslot_free_vec.pop_back();
+  size_t sslot_i = session->client_info.sslot_free_vec.back();
+  session->client_info.sslot_free_vec.pop_back();
   SSlot &sslot = session->sslot_arr[sslot_i];
   assert(sslot.tx_msgbuf == nullptr);  // Previous response was received
   sslot.tx_msgbuf = req_msgbuf;        // Mark the request as active/incomplete
-  sslot.cur_req_num += kSessionReqWindow;  // Move to next request
+  sslot.cur_req_num += session->req_window;  // Move to next request
 
   auto &ci = sslot.client_info;
   ci.resp_msgbuf = resp_msgbuf;
   ci.cont_func = cont_func;
   ci.tag = tag;
+  ci.resp_pkt_base = req_msgbuf->num_pkts - 1;
   ci.progress_tsc = ev_loop_tsc;
+  ci.deadline_tsc = deadline_tsc;
+  ci.fail_status = RespStatus::kOk;
   add_to_active_rpc_list(sslot);
+  rto_wheel_insert_st(&sslot, ev_loop_tsc + session->client_info.rto.rto_tsc);
 
   ci.num_rx = 0;
   ci.num_tx = 0;
+  ci.ack_base = 0;
+  ci.ack_bitmap = 0;
+  ci.re_tx = false;
+  ci.fast_retx_end = 0;
   ci.cont_etid = cont_etid;
 
   // Fill in packet 0's header
   pkthdr_t *pkthdr_0 = req_msgbuf->get_pkthdr_0();
   pkthdr_0->req_type = req_type;
+  pkthdr_0->dest_rpc_id = session->remote_rpc_id;
   pkthdr_0->msg_size = req_msgbuf->data_size;
   pkthdr_0->dest_session_num = session->remote_session_num;
   pkthdr_0->pkt_type = kPktTypeReq;
   pkthdr_0->pkt_num = 0;
   pkthdr_0->req_num = sslot.cur_req_num;
 
+  // Tell the server the request's remaining time budget, rounded up
+  size_t budget_us = 0;
+  if (deadline_tsc != 0) {
+    budget_us = 1 + static_cast<size_t>(
+                        to_usec(deadline_tsc - ev_loop_tsc, freq_ghz));
+  }
+  pkthdr_0->set_budget_us(budget_us);
+
   // Fill in any non-zeroth packet headers, using pkthdr_0 as the base.
   if (unlikely(req_msgbuf->num_pkts > 1)) {
     for (size_t i = 1; i < req_msgbuf->num_pkts; i++) {
@@ -66,14 +112,11 @@ void Rpc::enqueue_request(int session_num, uint8_t req_type,
     }
   }
 
-  if (likely(session->client_info.credits > 0)) {
-    kick_req_st(&sslot);
-  } else {
-    stallq.push_back(&sslot);
-  }
+  tx_sched_st(&sslot);
 }
 
-void Rpc::process_small_req_st(SSlot *sslot, pkthdr_t *pkthdr) {
+template <class TTransport>
+void Rpc<TTransport>::process_small_req_st(SSlot *sslot, pkthdr_t *pkthdr) {
   assert(in_dispatch());
 
   // Handle reordering
@@ -105,11 +148,14 @@ void Rpc::process_small_req_st(SSlot *sslot, pkthdr_t *pkthdr) {
     }
   }
 
-  // If we're here, this is the first (and only) packet of this new request
-  assert(pkthdr->req_num == sslot->cur_req_num + kSessionReqWindow);
+  // If we're here, this is the first (and only) packet of this new request.
+  // It's usually the next request, but the client skips the request numbers
+  // of requests that it abandoned before we saw them.
+  assert(pkthdr->req_num % sslot->session->req_window ==
+         sslot->cur_req_num % sslot->session->req_window);
+  if (unlikely(!start_new_req_server(sslot, pkthdr))) return;
 
   auto &req_msgbuf = sslot->server_info.req_msgbuf;
-  assert(req_msgbuf.is_buried());  // Buried on prev req's enqueue_response()
 
   // Bury the previous, possibly dynamic response (sslot->tx_msgbuf). This marks
   // the response for cur_req_num as unavailable.
@@ -118,6 +164,7 @@ void Rpc::process_small_req_st(SSlot *sslot, pkthdr_t *pkthdr) {
   // Update sslot tracking
   sslot->cur_req_num = pkthdr->req_num;
   sslot->server_info.num_rx = 1;
+  sslot->server_info.deadline_tsc = req_deadline_server(pkthdr);
 
   const ReqFunc &req_func = req_func_arr[pkthdr->req_type];
 
@@ -138,6 +185,15 @@ void Rpc::process_small_req_st(SSlot *sslot, pkthdr_t *pkthdr) {
       req_msgbuf = alloc_msg_buffer(pkthdr->msg_size);
       memcpy(req_msgbuf.buf, pkthdr + 1, pkthdr->msg_size);  // Omit header
     }
+
+    if (unlikely(req_func.is_streaming())) {
+      req_func.req_chunk_func(static_cast<ReqHandle *>(sslot), req_msgbuf.buf,
+                              0, req_msgbuf.get_data_size(), context);
+    }
+    if (unlikely(req_func.is_batched())) {
+      req_batch.push_back(static_cast<ReqHandle *>(sslot));
+      return;
+    }
     req_func.req_func(static_cast<ReqHandle *>(sslot), context);
     return;
   } else {
@@ -149,29 +205,37 @@ void Rpc::process_small_req_st(SSlot *sslot, pkthdr_t *pkthdr) {
   }
 }
 
-void Rpc::process_large_req_one_st(SSlot *sslot, const pkthdr_t *pkthdr) {
+template <class TTransport>
+void Rpc<TTransport>::process_large_req_one_st(SSlot *sslot, const pkthdr_t *pkthdr) {
   assert(in_dispatch());
 
-  // Handle reordering
-  bool is_next_pkt_same_req =  // Is this the next packet in this request?
-      (pkthdr->req_num == sslot->cur_req_num) &&
-      (pkthdr->pkt_num == sslot->server_info.num_rx);
-  bool is_first_pkt_next_req =  // Is this the first packet in the next request?
-      (pkthdr->req_num == sslot->cur_req_num + kSessionReqWindow) &&
-      (pkthdr->pkt_num == 0);
-
-  bool in_order = is_next_pkt_same_req || is_first_pkt_next_req;
-  if (unlikely(!in_order)) {
+  auto &si = sslot->server_info;
+  MsgBuffer &req_msgbuf = si.req_msgbuf;
+  const size_t pkt_num = pkthdr->pkt_num;
+
+  // Handle reordering. The client retransmits only lost packets, so accept
+  // any packet of this request or a later one, and track received packets.
+  // Packets of an abandoned current request are not new.
+  const bool is_cur_req = pkthdr->req_num == sslot->cur_req_num;
+  const bool is_next_req = pkthdr->req_num > sslot->cur_req_num;
+  const size_t rx_base = is_next_req ? 0 : si.rx_base;
+  const bool in_window = pkt_num < rx_base + kSessionCredits;
+  const bool is_new =
+      in_window &&
+      (is_next_req ||
+       (is_cur_req && !req_msgbuf.is_buried() && pkt_num >= rx_base &&
+        ((si.rx_bitmap >> (pkt_num - rx_base)) & 1) == 0));
+
+  if (unlikely(!is_new)) {
     char issue_msg[kMaxIssueMsgLen];
     sprintf(issue_msg,
             "Rpc %u, lsn %u: Received out-of-order request. "
             "Req/pkt numbers: %zu/%zu (pkt), %zu/%zu (sslot). Action",
             rpc_id, sslot->session->local_session_num, pkthdr->req_num,
-            pkthdr->pkt_num, sslot->cur_req_num, sslot->server_info.num_rx);
+            pkt_num, sslot->cur_req_num, si.rx_base);
 
     // Only past packets belonging to this request are not dropped
-    if (pkthdr->req_num != sslot->cur_req_num ||
-        pkthdr->pkt_num > sslot->server_info.num_rx) {
+    if (!is_cur_req || !in_window || req_abandoned_server(sslot)) {
       ERPC_REORDER("%s: Dropping.\n", issue_msg);
       return;
     }
@@ -180,9 +244,9 @@ void Rpc::process_large_req_one_st(SSlot *sslot, const pkthdr_t *pkthdr) {
     //
     // req_msgbuf could be buried if we have received the entire request and
     // queued the response, so directly compute number of packets in request.
-    if (pkthdr->pkt_num != data_size_to_num_pkts(pkthdr->msg_size) - 1) {
+    if (pkt_num != data_size_to_num_pkts(pkthdr->msg_size) - 1) {
       ERPC_REORDER("%s: Re-sending credit return.\n", issue_msg);
-      enqueue_cr_st(sslot, pkthdr);  // Header only, so tx_flush uneeded
+      enqueue_cr_st(sslot, pkthdr->req_type, pkt_num, false);  // No tx_flush
       return;
     }
 
@@ -200,12 +264,11 @@ void Rpc::process_large_req_one_st(SSlot *sslot, const pkthdr_t *pkthdr) {
     return;
   }
 
-  MsgBuffer &req_msgbuf = sslot->server_info.req_msgbuf;
-
   // Allocate or locate the request MsgBuffer
-  if (pkthdr->pkt_num == 0) {
-    // This is the first packet received for this request
-    assert(req_msgbuf.is_buried());  // Buried on prev req's enqueue_response()
+  if (is_next_req) {
+    // This is the first packet received for this request, though possibly not
+    // packet 0 if that was lost
+    if (unlikely(!start_new_req_server(sslot, pkthdr))) return;
 
     // Bury the previous, possibly dynamic response. This marks the response for
     // cur_req_num as unavailable.
@@ -216,37 +279,93 @@ void Rpc::process_large_req_one_st(SSlot *sslot, const pkthdr_t *pkthdr) {
 
     // Update sslot tracking
     sslot->cur_req_num = pkthdr->req_num;
-    sslot->server_info.num_rx = 1;
-  } else {
-    // This is not the first packet for this request
-    sslot->server_info.num_rx++;
+    si.num_rx = 0;
+    si.rx_base = 0;
+    si.rx_bitmap = 0;
+    cancel_pending_cr_st(sslot);  // The client abandoned the previous request
+    si.deadline_tsc = req_deadline_server(pkthdr);
+  } else if (unlikely(req_abandoned_server(sslot))) {
+    // The client has given up on this request, so don't finish receiving it
+    ERPC_REORDER(
+        "Rpc %u, lsn %u: Request %zu expired with %zu/%zu packets. Dropping.\n",
+        rpc_id, sslot->session->local_session_num, sslot->cur_req_num,
+        si.num_rx, req_msgbuf.num_pkts);
+    bury_req_msgbuf_server_st(sslot);
+    return;
   }
 
-  // Send a credit return for every request packet except the last in sequence
-  if (pkthdr->pkt_num != req_msgbuf.num_pkts - 1) enqueue_cr_st(sslot, pkthdr);
+  // Mark the packet as received, and slide past the received prefix
+  const size_t prev_rx_base = si.rx_base;
+  si.num_rx++;
+  si.rx_bitmap |= 1ull << (pkt_num - si.rx_base);
+  if (si.rx_bitmap == ~0ull) {
+    si.rx_base += 64;
+    si.rx_bitmap = 0;
+  } else {
+    const size_t shift = static_cast<size_t>(__builtin_ctzll(~si.rx_bitmap));
+    si.rx_base += shift;
+    si.rx_bitmap >>= shift;
+  }
 
-  copy_data_to_msgbuf(&req_msgbuf, pkthdr->pkt_num, pkthdr);  // Omits header
+  // Return credits for every request packet except the last in sequence
+  if (pkt_num != req_msgbuf.num_pkts - 1) add_pending_cr_st(sslot, pkthdr);
 
-  // Invoke the request handler iff we have all the request packets
-  if (sslot->server_info.num_rx != req_msgbuf.num_pkts) return;
+  copy_data_to_msgbuf(&req_msgbuf, pkt_num, pkthdr);  // Omits header
 
+  // Pass the part of the request that just became contiguous to a streaming
+  // handler, so it can work on the request while the rest is in flight
   const ReqFunc &req_func = req_func_arr[pkthdr->req_type];
+  if (unlikely(req_func.is_streaming()) && si.rx_base > prev_rx_base) {
+    const size_t offset = prev_rx_base * TTransport::kMaxDataPerPkt;
+    const size_t end = std::min(si.rx_base * TTransport::kMaxDataPerPkt,
+                                req_msgbuf.get_data_size());
+    req_func.req_chunk_func(static_cast<ReqHandle *>(sslot),
+                            &req_msgbuf.buf[offset], offset, end - offset,
+                            context);
+  }
+
+  // Invoke the request handler iff we have all the request packets
+  if (si.num_rx != req_msgbuf.num_pkts) return;
 
   // Remember request metadata for enqueue_response(). req_type was invalidated
   // on previous enqueue_response(). Setting it implies that an enqueue_resp()
   // is now pending; this invariant is used to safely reset sessions.
-  assert(sslot->server_info.req_type == kInvalidReqType);
-  sslot->server_info.req_type = pkthdr->req_type;
-  sslot->server_info.req_func_type = req_func.req_func_type;
+  assert(si.req_type == kInvalidReqType);
+  si.req_type = pkthdr->req_type;
+  si.req_func_type = req_func.req_func_type;
 
   // req_msgbuf here is independent of the RX ring, so don't make another copy
-  if (likely(!req_func.is_background())) {
+  if (unlikely(req_func.is_batched())) {
+    req_batch.push_back(static_cast<ReqHandle *>(sslot));
+  } else if (likely(!req_func.is_background())) {
     req_func.req_func(static_cast<ReqHandle *>(sslot), context);
   } else {
     submit_bg_req_st(sslot);
   }
 }
 
+template <class TTransport>
+void Rpc<TTransport>::process_req_batch_st() {
+  assert(in_dispatch());
+
+  // Give each request type's handler all of its requests in one call. A
+  // stable partition keeps the requests of a type in arrival order.
+  auto it = req_batch.begin();
+  while (it != req_batch.end()) {
+    const uint8_t req_type = static_cast<SSlot *>(*it)->server_info.req_type;
+    auto type_end =
+        std::stable_partition(it, req_batch.end(), [req_type](ReqHandle *h) {
+          return static_cast<SSlot *>(h)->server_info.req_type == req_type;
+        });
+
+    req_func_arr[req_type].req_batch_func(
+        &*it, static_cast<size_t>(type_end - it), context);
+    it = type_end;
+  }
+
+  req_batch.clear();
+}
+
 FORCE_COMPILE_TRANSPORTS
 
 }  // namespace erpc
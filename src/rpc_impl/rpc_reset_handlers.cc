@@ -6,7 +6,8 @@
 
 namespace erpc {
 
-bool Rpc::handle_reset_client_st(Session *session) {
+template <class TTransport>
+bool Rpc<TTransport>::handle_reset_client_st(Session *session) {
   assert(in_dispatch());
 
   char issue_msg[kMaxIssueMsgLen];
@@ -15,40 +16,42 @@ bool Rpc::handle_reset_client_st(Session *session) {
           rpc_id, session->local_session_num,
           session_state_str(session->state).c_str());
 
-  // Erase session slots from credit stall queue
-  for (const SSlot &sslot : session->sslot_arr) {
-    stallq.erase(std::remove(stallq.begin(), stallq.end(), &sslot),
-                 stallq.end());
-  }
+  // Erase the session and its slots from the TX scheduler
+  for (SSlot &sslot : session->sslot_arr) tx_queue_remove(&sslot);
+  tx_ready_sessions.erase(std::remove(tx_ready_sessions.begin(),
+                                      tx_ready_sessions.end(), session),
+                          tx_ready_sessions.end());
 
   // Invoke continuation-with-failure for all active requests
   for (SSlot &sslot : session->sslot_arr) {
-    if (sslot.tx_msgbuf == nullptr) {
+    if (sslot.tx_msgbuf != nullptr) {
       sslot.tx_msgbuf = nullptr;
       delete_from_active_rpc_list(sslot);
+      rto_wheel.remove(&sslot);
       session->client_info.sslot_free_vec.push_back(sslot.index);
 
       MsgBuffer *resp_msgbuf = sslot.client_info.resp_msgbuf;
       resize_msg_buffer(resp_msgbuf, 0);  // 0 response size marks the error
+      resp_msgbuf->resp_status = RespStatus::kSessionReset;
       sslot.client_info.cont_func(context, sslot.client_info.tag);
     }
   }
 
-  assert(session->client_info.sslot_free_vec.size() == kSessionReqWindow);
+  assert(session->client_info.sslot_free_vec.size() == session->req_window);
 
   // Change state before failure continuations
   session->state = SessionState::kDisconnectInProgress;
 
   // Act similar to handling a disconnect response
   ERPC_INFO("%s: None. Session resetted.\n", issue_msg);
-  free_ring_entries();  // Free before callback to allow creating new session
   sm_handler(session->local_session_num, SmEventType::kDisconnected,
              SmErrType::kSrvDisconnected, context);
   bury_session_st(session);
   return true;
 }
 
-bool Rpc::handle_reset_server_st(Session *session) {
+template <class TTransport>
+bool Rpc<TTransport>::handle_reset_server_st(Session *session) {
   assert(in_dispatch());
   assert(session->is_server());
   session->state = SessionState::kResetInProgress;
@@ -67,7 +70,6 @@ bool Rpc::handle_reset_server_st(Session *session) {
   if (pending_enqueue_resps == 0) {
     // Act similar to handling a disconnect request, but don't send SM response
     ERPC_INFO("%s: None. Session resetted.\n", issue_msg);
-    free_ring_entries();
     bury_session_st(session);
     return true;
   } else {
@@ -7,17 +7,19 @@ namespace erpc {
 // which point the event loop buries the request MsgBuffer.
 //
 // So sslot->rx_msgbuf may or may not be valid at this point.
-void Rpc::enqueue_response(ReqHandle *req_handle, MsgBuffer *resp_msgbuf) {
+template <class TTransport>
+void Rpc<TTransport>::enqueue_response(ReqHandle *req_handle, MsgBuffer *resp_msgbuf) {
   // When called from a background thread, enqueue to the foreground thread
   if (unlikely(!in_dispatch())) {
-    bg_queues._enqueue_response.unlocked_push(
-        enq_resp_args_t(req_handle, resp_msgbuf));
+    bg_queues._enqueue_response.push(enq_resp_args_t(req_handle, resp_msgbuf));
     return;
   }
 
   // If we're here, we're in the dispatch thread
   SSlot *sslot = static_cast<SSlot *>(req_handle);
-  sslot->server_info.sav_num_req_pkts = sslot->server_info.req_msgbuf.num_pkts;
+  auto &si = sslot->server_info;
+  const bool chunked = si.resp_chunk_q != nullptr;
+  if (likely(!chunked)) si.resp_pkt_base = si.req_msgbuf.num_pkts - 1;
   bury_req_msgbuf_server_st(sslot);  // Bury the possibly-dynamic req MsgBuffer
 
   Session *session = sslot->session;
@@ -29,20 +31,124 @@ void Rpc::enqueue_response(ReqHandle *req_handle, MsgBuffer *resp_msgbuf) {
               rpc_id, session->local_session_num);
 
     // Mark enqueue_response() as completed
-    assert(sslot->server_info.req_type != kInvalidReqType);
-    sslot->server_info.req_type = kInvalidReqType;
+    assert(si.req_type != kInvalidReqType);
+    si.req_type = kInvalidReqType;
 
     return;  // During session reset, don't add packets to TX burst
   }
 
+  if (unlikely(chunked)) {
+    // The final chunk is sent when the client pulls it
+    assert(si.req_type != kInvalidReqType);
+    si.req_type = kInvalidReqType;
+    si.resp_final = resp_msgbuf;
+    if (!req_abandoned_server(sslot)) maybe_advance_resp_chunk_st(sslot);
+    return;
+  }
+
+  format_resp_pkthdrs_st(sslot, resp_msgbuf, si.req_type, false);
+
+  // Fill in the slot and reset queueing progress
+  assert(sslot->tx_msgbuf == nullptr);  // Buried before calling request handler
+  sslot->tx_msgbuf = resp_msgbuf;       // Mark response as valid
+
+  // The response answers all request packets, so a pending CR is moot. This
+  // covers foreground, batched, and background request handlers.
+  cancel_pending_cr_st(sslot);
+
+  // Mark enqueue_response() as completed
+  assert(si.req_type != kInvalidReqType);
+  si.req_type = kInvalidReqType;
+
+  // Don't send responses that the client has given up on
+  if (unlikely(req_abandoned_server(sslot))) {
+    ERPC_REORDER("Rpc %u, lsn %u: Request %zu expired. Not sending response.\n",
+                 rpc_id, session->local_session_num, sslot->cur_req_num);
+    return;
+  }
+
+  enqueue_pkt_tx_burst_st(sslot, 0, nullptr);  // 0 = packet index, not pkt_num
+}
+
+template <class TTransport>
+bool Rpc<TTransport>::enqueue_response_chunk(ReqHandle *req_handle,
+                                             MsgBuffer *chunk_msgbuf) {
+  SSlot *sslot = static_cast<SSlot *>(req_handle);
+  auto &si = sslot->server_info;
+
+  // Refuse the chunk if too many chunks wait for the client to pull them
+  if (__atomic_add_fetch(&si.resp_chunks_waiting, 1, __ATOMIC_RELAXED) >
+      kMaxRespChunks) {
+    release_resp_chunks(sslot, 1);
+    return false;
+  }
+
+  // When called from a background thread, enqueue to the foreground thread.
+  // The caller may reuse its MsgBuffer struct, so pass a copy.
+  if (unlikely(!in_dispatch())) {
+    bg_queues._enqueue_response.push(
+        enq_resp_args_t(req_handle, *chunk_msgbuf));
+    return true;
+  }
+
+  enqueue_response_chunk_st(sslot, *chunk_msgbuf);
+  return true;
+}
+
+template <class TTransport>
+void Rpc<TTransport>::enqueue_response_chunk_st(SSlot *sslot,
+                                                const MsgBuffer &chunk) {
+  assert(in_dispatch());
+  auto &si = sslot->server_info;
+  assert(si.req_type != kInvalidReqType);  // The final chunk isn't enqueued yet
+
+  Session *session = sslot->session;
+  if (unlikely(!session->is_connected() || req_abandoned_server(sslot))) {
+    ERPC_REORDER("Rpc %u, lsn %u: Dropping response chunk for req %zu.\n",
+                 rpc_id, session->local_session_num, sslot->cur_req_num);
+    free_msg_buffer(chunk);
+    release_resp_chunks(sslot, 1);
+    return;
+  }
+
+  if (si.resp_chunk_q != nullptr) {
+    si.resp_chunk_q->push_back(chunk);
+    maybe_advance_resp_chunk_st(sslot);
+    return;
+  }
+
+  // This is the first chunk. Send it right away, like a response.
+  assert(sslot->tx_msgbuf == nullptr);
+  release_resp_chunks(sslot, 1);
+  si.resp_chunk_q = new std::deque<MsgBuffer>();
+  si.resp_final = nullptr;
+  si.resp_pkt_base = si.req_msgbuf.num_pkts - 1;
+  si.resp_chunk = chunk;
+
+  format_resp_pkthdrs_st(sslot, &si.resp_chunk, si.req_type, true);
+  sslot->tx_msgbuf = &si.resp_chunk;
+  cancel_pending_cr_st(sslot);  // The chunk answers all request packets
+  enqueue_pkt_tx_burst_st(sslot, 0, nullptr);
+}
+
+template <class TTransport>
+void Rpc<TTransport>::format_resp_pkthdrs_st(SSlot *sslot,
+                                             MsgBuffer *resp_msgbuf,
+                                             uint8_t req_type,
+                                             bool more_chunks) {
+  Session *session = sslot->session;
+
   // Fill in packet 0's header
   pkthdr_t *resp_pkthdr_0 = resp_msgbuf->get_pkthdr_0();
-  resp_pkthdr_0->req_type = sslot->server_info.req_type;
+  resp_pkthdr_0->req_type = req_type;
+  resp_pkthdr_0->dest_rpc_id = session->remote_rpc_id;
   resp_pkthdr_0->msg_size = resp_msgbuf->data_size;
   resp_pkthdr_0->dest_session_num = session->remote_session_num;
   resp_pkthdr_0->pkt_type = kPktTypeResp;
-  resp_pkthdr_0->pkt_num = sslot->server_info.sav_num_req_pkts - 1;
+  resp_pkthdr_0->pkt_num = sslot->server_info.resp_pkt_base;
   resp_pkthdr_0->req_num = sslot->cur_req_num;
+  resp_pkthdr_0->credit_grant = session->server_info.credits;
+  resp_pkthdr_0->more_chunks = more_chunks ? 1 : 0;
 
   // Fill in non-zeroth packet headers, if any
   if (resp_msgbuf->num_pkts > 1) {
@@ -54,27 +160,53 @@ void Rpc::enqueue_response(ReqHandle *req_handle, MsgBuffer *resp_msgbuf) {
       resp_pkthdr_i->pkt_num = resp_pkthdr_0->pkt_num + i;
     }
   }
+}
 
-  // Fill in the slot and reset queueing progress
-  assert(sslot->tx_msgbuf == nullptr);  // Buried before calling request handler
-  sslot->tx_msgbuf = resp_msgbuf;       // Mark response as valid
+template <class TTransport>
+void Rpc<TTransport>::maybe_advance_resp_chunk_st(SSlot *sslot) {
+  assert(in_dispatch());
+  auto &si = sslot->server_info;
+  assert(sslot->tx_msgbuf == &si.resp_chunk);
 
-  // Mark enqueue_response() as completed
-  assert(sslot->server_info.req_type != kInvalidReqType);
-  sslot->server_info.req_type = kInvalidReqType;
+  // The client pulls the next chunk with an RFR for the packet after the
+  // current chunk, once it has received the whole current chunk
+  const size_t resp_end = si.resp_pkt_base + sslot->tx_msgbuf->num_pkts;
+  if (si.num_rx <= resp_end) return;
+  if (si.resp_chunk_q->empty() && si.resp_final == nullptr) return;
 
-  enqueue_pkt_tx_burst_st(sslot, 0, nullptr);  // 0 = packet index, not pkt_num
+  // The TX batch may reference the current chunk
+  drain_tx_batch_and_dma_queue();
+  const uint8_t req_type = si.resp_chunk.get_pkthdr_0()->req_type;
+  free_msg_buffer(si.resp_chunk);
+  si.resp_pkt_base = resp_end;
+
+  if (!si.resp_chunk_q->empty()) {
+    si.resp_chunk = si.resp_chunk_q->front();
+    si.resp_chunk_q->pop_front();
+    release_resp_chunks(sslot, 1);
+    format_resp_pkthdrs_st(sslot, &si.resp_chunk, req_type, true);
+    sslot->tx_msgbuf = &si.resp_chunk;
+  } else {
+    delete si.resp_chunk_q;
+    si.resp_chunk_q = nullptr;
+    format_resp_pkthdrs_st(sslot, si.resp_final, req_type, false);
+    sslot->tx_msgbuf = si.resp_final;
+    si.resp_final = nullptr;
+  }
+
+  enqueue_pkt_tx_burst_st(sslot, 0, nullptr);
 }
 
-void Rpc::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
+template <class TTransport>
+void Rpc<TTransport>::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
                                    size_t rx_tsc) {
   assert(in_dispatch());
   assert(pkthdr->req_num <= sslot->cur_req_num);
 
-  // Handle reordering
-  if (unlikely(!in_order_client(sslot, pkthdr))) {
+  // Handle reordering and duplicates
+  if (unlikely(!fresh_reply_client(sslot, pkthdr))) {
     ERPC_REORDER(
-        "Rpc %u, lsn %u (%s): Received out-of-order response. "
+        "Rpc %u, lsn %u (%s): Received stale response. "
         "Packet %zu/%zu, sslot %zu/%s. Dropping.\n",
         rpc_id, sslot->session->local_session_num,
         sslot->session->get_remote_hostname().c_str(), pkthdr->req_num,
@@ -85,14 +217,25 @@ void Rpc::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
   auto &ci = sslot->client_info;
   MsgBuffer *resp_msgbuf = ci.resp_msgbuf;
 
-  // Update client tracking metadata
+  // The server sends the first response packet only after receiving the whole
+  // request, so it also answers request packets whose CRs were lost
+  const size_t num_req_pkts = sslot->tx_msgbuf->num_pkts;
+  const uint64_t ack_mask = pkthdr->pkt_num == num_req_pkts - 1
+                                ? low_bits(num_req_pkts - ci.ack_base)
+                                : 1ull << (pkthdr->pkt_num - ci.ack_base);
+
+  // Update client tracking metadata. The first packet of a response or chunk
+  // waited for the server to produce it, so its RTT is not the network's.
   if (kCcRateComp) update_timely_rate(sslot, pkthdr->pkt_num, rx_tsc);
-  bump_credits(sslot->session);
-  ci.num_rx++;
+  if (pkthdr->pkt_num != ci.resp_pkt_base) {
+    update_rto(sslot, pkthdr->pkt_num, rx_tsc);
+  }
+  ack_pkts_client(sslot, pkthdr, ack_mask);
+  if (unlikely(ci.ack_bitmap != 0)) pkt_loss_fast_retransmit_st(sslot);
   ci.progress_tsc = ev_loop_tsc;
 
   // Special handling for single-packet responses
-  if (likely(pkthdr->msg_size <= Transport::kMaxDataPerPkt)) {
+  if (likely(pkthdr->msg_size <= TTransport::kMaxDataPerPkt)) {
     resize_msg_buffer(resp_msgbuf, pkthdr->msg_size);
 
     // Copy eRPC header and data.
@@ -100,23 +243,21 @@ void Rpc::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
 
     // Fall through to invoke continuation
   } else {
-    // This is an in-order response packet. So, we still have the request.
-    MsgBuffer *req_msgbuf = sslot->tx_msgbuf;
-
-    if (pkthdr->pkt_num == req_msgbuf->num_pkts - 1) {
-      // This is the first response packet. Size the response and copy header.
+    if (pkthdr->pkt_num == ci.resp_pkt_base) {
+      // This is the first packet of the response or response chunk. Size the
+      // response and copy header.
       resize_msg_buffer(resp_msgbuf, pkthdr->msg_size);
       memcpy(resp_msgbuf->get_pkthdr_0(), pkthdr, sizeof(pkthdr_t));
     }
 
-    // Transmit remaining RFRs before response memcpy. We have credits.
-    if (ci.num_tx != wire_pkts(req_msgbuf, resp_msgbuf)) kick_rfr_st(sslot);
+    // Transmit remaining RFRs before response memcpy
+    if (ci.num_tx != resp_end_client(sslot)) tx_sched_st(sslot);
 
     // Hdr 0 was copied earlier, other headers are unneeded, so copy just data.
-    const size_t pkt_idx = resp_ntoi(pkthdr->pkt_num, req_msgbuf->num_pkts);
+    const size_t pkt_idx = pkthdr->pkt_num - ci.resp_pkt_base;
     copy_data_to_msgbuf(resp_msgbuf, pkt_idx, pkthdr);
 
-    if (ci.num_rx != wire_pkts(req_msgbuf, resp_msgbuf)) return;
+    if (ci.num_rx != ci.resp_pkt_base + resp_msgbuf->num_pkts) return;
     // Else fall through to invoke continuation
   }
 
@@ -124,13 +265,48 @@ void Rpc::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
   // have been removed previously, before invalidating the sslot (done next).
   // 1. The TX batch or DMA queue cannot contain a reference because we drain
   //    it after retransmission.
-  // 2. The wheel cannot contain a reference because we (a) wait for sslot to
-  //    drain from the wheel before retransmitting, and (b) discard spurious
-  //    corresponding packets received for packets in the wheel.
+  // 2. The wheel cannot contain a reference because the server answers only
+  //    packets that have left the wheel, and we answered all packets.
   assert(ci.wheel_count == 0);
 
+  resp_msgbuf->resp_status = RespStatus::kOk;
+  if (unlikely(resp_msgbuf->get_pkthdr_0()->more_chunks == 1)) {
+    deliver_resp_chunk_st(sslot);
+    return;
+  }
+  complete_request_st(sslot);
+}
+
+template <class TTransport>
+void Rpc<TTransport>::deliver_resp_chunk_st(SSlot *sslot) {
+  assert(in_dispatch());
+  auto &ci = sslot->client_info;
+  ci.resp_pkt_base += ci.resp_msgbuf->num_pkts;
+
+  // The next chunk overwrites resp_msgbuf, so the continuation runs here even
+  // if the request asked for a background continuation
+  const size_t req_num = sslot->cur_req_num;
+  ci.cont_func(context, ci.tag);
+
+  // The continuation may have cancelled the request
+  if (sslot->tx_msgbuf == nullptr || sslot->cur_req_num != req_num ||
+      ci.fail_status != RespStatus::kOk) {
+    return;
+  }
+
+  tx_sched_st(sslot);  // Pull the next chunk
+}
+
+template <class TTransport>
+void Rpc<TTransport>::complete_request_st(SSlot *sslot) {
+  assert(in_dispatch());
+  auto &ci = sslot->client_info;
+
   sslot->tx_msgbuf = nullptr;  // Mark response as received
   delete_from_active_rpc_list(*sslot);
+  rto_wheel.remove(sslot);
+  tx_queue_remove(sslot);
+  assert(!ci.in_tx_queue);  // A free sslot must not be linked in the TX queue
 
   // Free-up this sslot by copying-out needed fields. The sslot may get re-used
   // immediately if there are backlogged requests, or much later from a request
@@ -142,14 +318,15 @@ void Rpc::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
   Session *session = sslot->session;
   session->client_info.sslot_free_vec.push_back(sslot->index);
 
-  // Clear up one request from the backlog if needed
-  if (!session->client_info.enq_req_backlog.empty()) {
-    // We just got a new sslot, and we should have no more if there's backlog
-    assert(session->client_info.sslot_free_vec.size() == 1);
-    enq_req_args_t &args = session->client_info.enq_req_backlog.front();
+  // Clear up the backlog while we have free sslots. A backlogged request whose
+  // deadline passed fails without using the sslot.
+  auto &backlog = session->client_info.enq_req_backlog;
+  while (!backlog.empty() && !session->client_info.sslot_free_vec.empty()) {
+    const enq_req_args_t args = backlog.front();
+    backlog.pop_front();
     enqueue_request(args.session_num, args.req_type, args.req_msgbuf,
-                    args.resp_msgbuf, args.cont_func, args.tag, args.cont_etid);
-    session->client_info.enq_req_backlog.pop();
+                    args.resp_msgbuf, args.cont_func, args.tag, args.cont_etid,
+                    args.deadline_tsc);
   }
 
   if (likely(_cont_etid == kInvalidBgETid)) {
@@ -157,7 +334,6 @@ void Rpc::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
   } else {
     submit_bg_resp_st(_cont_func, _tag, _cont_etid);
   }
-  return;
 }
 
 FORCE_COMPILE_TRANSPORTS
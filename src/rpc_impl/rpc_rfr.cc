@@ -2,21 +2,25 @@
 
 namespace erpc {
 
-void Rpc::enqueue_rfr_st(SSlot *sslot, const pkthdr_t *resp_pkthdr) {
+template <class TTransport>
+void Rpc<TTransport>::enqueue_rfr_st(SSlot *sslot, const pkthdr_t *resp_pkthdr,
+                                     size_t pkt_num) {
   assert(in_dispatch());
 
   MsgBuffer *ctrl_msgbuf = &ctrl_msgbufs[ctrl_msgbuf_head];
   ctrl_msgbuf_head++;
-  if (ctrl_msgbuf_head == Transport::kCtrlBufferSize) ctrl_msgbuf_head = 0;
+  if (ctrl_msgbuf_head == TTransport::kCtrlBufferSize) ctrl_msgbuf_head = 0;
 
   // Fill in the RFR packet header. Avoid copying resp_pkthdr's headroom.
   pkthdr_t *rfr_pkthdr = ctrl_msgbuf->get_pkthdr_0();
   rfr_pkthdr->req_type = resp_pkthdr->req_type;
+  rfr_pkthdr->dest_rpc_id = sslot->session->remote_rpc_id;
   rfr_pkthdr->msg_size = 0;
   rfr_pkthdr->dest_session_num = sslot->session->remote_session_num;
   rfr_pkthdr->pkt_type = kPktTypeRFR;
-  rfr_pkthdr->pkt_num = sslot->client_info.num_tx;
+  rfr_pkthdr->pkt_num = pkt_num;
   rfr_pkthdr->req_num = resp_pkthdr->req_num;
+  rfr_pkthdr->cancel = 0;
   rfr_pkthdr->magic = kPktHdrMagic;
 
   enqueue_hdr_tx_burst_st(
@@ -24,42 +28,59 @@ void Rpc::enqueue_rfr_st(SSlot *sslot, const pkthdr_t *resp_pkthdr) {
       &sslot->client_info.tx_ts[rfr_pkthdr->pkt_num % kSessionCredits]);
 }
 
-void Rpc::process_rfr_st(SSlot *sslot, const pkthdr_t *pkthdr) {
+template <class TTransport>
+void Rpc<TTransport>::process_rfr_st(SSlot *sslot, const pkthdr_t *pkthdr) {
   assert(in_dispatch());
   assert(!sslot->is_client);
   auto &si = sslot->server_info;
 
-  // Handle reordering. If request numbers match, then we have not reset num_rx.
+  // Handle reordering. RFRs for this request arrive only after the client has
+  // the first response packet, so we still have the response.
   assert(pkthdr->req_num <= sslot->cur_req_num);
-  bool in_order =
-      (pkthdr->req_num == sslot->cur_req_num) && (pkthdr->pkt_num == si.num_rx);
-  if (unlikely(!in_order)) {
-    char issue_msg[kMaxIssueMsgLen];
-    sprintf(issue_msg,
-            "Rpc %u, lsn %u (%s): Received out-of-order RFR. "
-            "Pkt = %zu/%zu. cur_req_num = %zu, num_rx = %zu. Action",
-            rpc_id, sslot->session->local_session_num,
-            sslot->session->get_remote_hostname().c_str(), pkthdr->req_num,
-            pkthdr->pkt_num, sslot->cur_req_num, si.num_rx);
+  const size_t resp_end =  // One past the packet number of the last RFR
+      sslot->tx_msgbuf == nullptr
+          ? 0
+          : si.resp_pkt_base + sslot->tx_msgbuf->num_pkts;
+  if (unlikely(sslot->tx_msgbuf == nullptr ||
+               pkthdr->req_num != sslot->cur_req_num ||
+               pkthdr->pkt_num < si.resp_pkt_base ||
+               pkthdr->pkt_num > resp_end ||
+               (pkthdr->pkt_num == resp_end &&
+                sslot->tx_msgbuf->get_pkthdr_0()->more_chunks == 0))) {
+    // Reject RFRs for old requests or for packets outside the response
+    ERPC_REORDER(
+        "Rpc %u, lsn %u (%s): Received invalid RFR. Pkt = %zu/%zu. "
+        "cur_req_num = %zu, num_rx = %zu. Dropping.\n",
+        rpc_id, sslot->session->local_session_num,
+        sslot->session->get_remote_hostname().c_str(), pkthdr->req_num,
+        static_cast<size_t>(pkthdr->pkt_num), sslot->cur_req_num, si.num_rx);
+    return;
+  }
 
-    if (pkthdr->req_num < sslot->cur_req_num || pkthdr->pkt_num > si.num_rx) {
-      // Reject RFR for old requests or future packets in this request
-      ERPC_REORDER("%s: Dropping.\n", issue_msg);
-      return;
-    }
+  // An RFR past the current response chunk pulls the next chunk
+  if (unlikely(pkthdr->pkt_num == resp_end)) {
+    si.num_rx = std::max(si.num_rx, resp_end + 1);
+    if (!req_abandoned_server(sslot)) maybe_advance_resp_chunk_st(sslot);
+    return;
+  }
 
-    // If we're here, this is a past RFR packet for this request. So, we still
-    // have the response, and we saved request packet count.
-    ERPC_REORDER("%s: Re-sending response.\n", issue_msg);
-    enqueue_pkt_tx_burst_st(
-        sslot, resp_ntoi(pkthdr->pkt_num, si.sav_num_req_pkts), nullptr);
-    drain_tx_batch_and_dma_queue();
+  // Answer RFRs in any order, since the client retransmits only lost RFRs
+  const size_t resp_idx = pkthdr->pkt_num - si.resp_pkt_base;
+  if (likely(pkthdr->pkt_num >= si.num_rx)) {
+    si.num_rx = pkthdr->pkt_num + 1;
+    enqueue_pkt_tx_burst_st(sslot, resp_idx, nullptr);
     return;
   }
 
-  sslot->server_info.num_rx++;
-  enqueue_pkt_tx_burst_st(
-      sslot, resp_ntoi(pkthdr->pkt_num, si.sav_num_req_pkts), nullptr);
+  // If we're here, this is likely a retransmitted RFR
+  ERPC_REORDER(
+      "Rpc %u, lsn %u (%s): Received past RFR. Pkt = %zu/%zu. num_rx = %zu. "
+      "Re-sending response.\n",
+      rpc_id, sslot->session->local_session_num,
+      sslot->session->get_remote_hostname().c_str(), pkthdr->req_num,
+      static_cast<size_t>(pkthdr->pkt_num), si.num_rx);
+  enqueue_pkt_tx_burst_st(sslot, resp_idx, nullptr);
+  drain_tx_batch_and_dma_queue();
 }
 
 FORCE_COMPILE_TRANSPORTS
@@ -2,7 +2,8 @@
 
 namespace erpc {
 
-void Rpc::process_comps_st() {
+template <class TTransport>
+void Rpc<TTransport>::process_comps_st() {
   assert(in_dispatch());
   size_t num_pkts = transport->rx_burst();
   if (num_pkts == 0) return;
@@ -14,80 +15,145 @@ void Rpc::process_comps_st() {
   // ev_loop_tsc was taken just before calling the packet RX code
   const size_t &batch_rx_tsc = ev_loop_tsc;
 
-  for (size_t i = 0; i < num_pkts; i++) {
-    auto *pkthdr = reinterpret_cast<pkthdr_t *>(rx_ring[rx_ring_head]);
-    rx_ring_head = (rx_ring_head + 1) % Transport::kNumRxRingEntries;
-
-    assert(pkthdr->check_magic());
-    assert(pkthdr->msg_size <= kMaxMsgSize);  // msg_size can be 0 here
-
-    Session *session = session_vec[pkthdr->dest_session_num];
-    if (unlikely(session == nullptr)) {
-      ERPC_WARN("Rpc %u: Received %s for buried session. Dropping.\n", rpc_id,
-                pkthdr->to_string().c_str());
-      continue;
+  // Packets of high-priority requests go first, e.g., so that Raft heartbeats
+  // aren't delayed by a batch of bulk request packets
+  if (unlikely(high_prio_enabled)) {
+    for (size_t i = 0; i < num_pkts; i++) {
+      auto *pkthdr = rx_ring_pkthdr(rx_ring_head + i);
+      if (is_high_prio(pkthdr->req_type)) {
+        process_rx_pkt_st(pkthdr, batch_rx_tsc);
+      }
     }
+  }
 
-    if (unlikely(!session->is_connected())) {
-      ERPC_WARN(
-          "Rpc %u: Received %s for unconnected session (state %s). Dropping.\n",
-          rpc_id, pkthdr->to_string().c_str(),
-          session_state_str(session->state).c_str());
-      continue;
+  // Software-pipelined RX. With many sessions, a packet's session, sslot, and
+  // msgbufs are dependent cache misses. While processing packet i, we prefetch
+  // them for packets (i + 3D), (i + 2D), and (i + D), so that each stage reads
+  // lines prefetched D packets earlier.
+  const size_t head = rx_ring_head;
+  const size_t d = kRxPrefetchDist;
+  for (size_t i = 0; i < num_pkts + 3 * d; i++) {
+    if (i < num_pkts) prefetch_rx_session(rx_ring_pkthdr(head + i));
+    if (i >= d && i - d < num_pkts) {
+      prefetch_rx_sslot(rx_ring_pkthdr(head + i - d));
+    }
+    if (i >= 2 * d && i - 2 * d < num_pkts) {
+      prefetch_rx_msgbufs(rx_ring_pkthdr(head + i - 2 * d));
     }
+    if (i < 3 * d) continue;
 
-    // If we are here, we have a valid packet for a connected session
-    ERPC_TRACE(
-        "Rpc %u, lsn %u (%s): RX %s.\n", rpc_id, session->local_session_num,
-        session->get_remote_hostname().c_str(), pkthdr->to_string().c_str());
-
-    size_t sslot_i = pkthdr->req_num % kSessionReqWindow;  // Bit shift
-    SSlot *sslot = &session->sslot_arr[sslot_i];
-
-    switch (pkthdr->pkt_type) {
-      case PktType::kPktTypeReq:
-        pkthdr->msg_size <= Transport::kMaxDataPerPkt
-            ? process_small_req_st(sslot, pkthdr)
-            : process_large_req_one_st(sslot, pkthdr);
-        break;
-      case PktType::kPktTypeResp: {
-        size_t rx_tsc = kCcOptBatchTsc ? batch_rx_tsc : dpath_rdtsc();
-        process_resp_one_st(sslot, pkthdr, rx_tsc);
-        break;
-      }
-      case PktType::kPktTypeRFR: process_rfr_st(sslot, pkthdr); break;
-      case PktType::kPktTypeExplCR: {
-        size_t rx_tsc = kCcOptBatchTsc ? batch_rx_tsc : dpath_rdtsc();
-        process_expl_cr_st(sslot, pkthdr, rx_tsc);
-        break;
-      }
+    auto *pkthdr = rx_ring_pkthdr(rx_ring_head);
+    rx_ring_head = (rx_ring_head + 1) % TTransport::kNumRxRingEntries;
+
+    if (unlikely(high_prio_enabled) && is_high_prio(pkthdr->req_type)) {
+      continue;
     }
+    process_rx_pkt_st(pkthdr, batch_rx_tsc);
   }
 
+  // Zero-copy requests are valid only until we post RECVs
+  if (unlikely(!req_batch.empty())) process_req_batch_st();
+
   // Technically, these RECVs can be posted immediately after rx_burst(), or
   // even in the rx_burst() code.
   transport->post_recvs(num_pkts);
 }
 
-void Rpc::submit_bg_req_st(SSlot *sslot) {
+template <class TTransport>
+void Rpc<TTransport>::process_rx_pkt_st(pkthdr_t *pkthdr,
+                                        size_t batch_rx_tsc) {
+  assert(pkthdr->check_magic());
+  assert(pkthdr->msg_size <= kMaxMsgSize);  // msg_size can be 0 here
+
+  // The kernel may hand us another Rpc's packet while the steering program
+  // of a shared datapath port is being replaced
+  if (kSharedDpathPort && unlikely(pkthdr->dest_rpc_id != rpc_id)) {
+    ERPC_WARN("Rpc %u: Received %s for another Rpc. Dropping.\n", rpc_id,
+              pkthdr->to_string().c_str());
+    return;
+  }
+
+  Session *session = session_vec[pkthdr->dest_session_num];
+  if (unlikely(session == nullptr)) {
+    ERPC_WARN("Rpc %u: Received %s for buried session. Dropping.\n", rpc_id,
+              pkthdr->to_string().c_str());
+    return;
+  }
+
+  if (unlikely(!session->is_connected())) {
+    ERPC_WARN(
+        "Rpc %u: Received %s for unconnected session (state %s). Dropping.\n",
+        rpc_id, pkthdr->to_string().c_str(),
+        session_state_str(session->state).c_str());
+    return;
+  }
+
+  // If we are here, we have a valid packet for a connected session
+  if (session->is_server()) lend_credits_st(session);
+  ERPC_TRACE(
+      "Rpc %u, lsn %u (%s): RX %s.\n", rpc_id, session->local_session_num,
+      session->get_remote_hostname().c_str(), pkthdr->to_string().c_str());
+
+  size_t sslot_i = pkthdr->req_num & (session->req_window - 1);
+  SSlot *sslot = &session->sslot_arr[sslot_i];
+
+  switch (pkthdr->pkt_type) {
+    case PktType::kPktTypeReq:
+      pkthdr->msg_size <= TTransport::kMaxDataPerPkt
+          ? process_small_req_st(sslot, pkthdr)
+          : process_large_req_one_st(sslot, pkthdr);
+      break;
+    case PktType::kPktTypeResp: {
+      size_t rx_tsc = kCcOptBatchTsc ? batch_rx_tsc : dpath_rdtsc();
+      process_resp_one_st(sslot, pkthdr, rx_tsc);
+      break;
+    }
+    case PktType::kPktTypeRFR:
+      unlikely(pkthdr->cancel) ? process_cancel_st(sslot, pkthdr)
+                               : process_rfr_st(sslot, pkthdr);
+      break;
+    case PktType::kPktTypeExplCR: {
+      size_t rx_tsc = kCcOptBatchTsc ? batch_rx_tsc : dpath_rdtsc();
+      process_expl_cr_st(sslot, pkthdr, rx_tsc);
+      break;
+    }
+  }
+}
+
+template <class TTransport>
+void Rpc<TTransport>::submit_bg_req_st(SSlot *sslot) {
   assert(in_dispatch());
   assert(nexus->num_bg_threads > 0);
 
   const size_t bg_etid = fast_rand.next_u32() % nexus->num_bg_threads;
-  auto *req_queue = nexus_hook.bg_req_queue_arr[bg_etid];
-
-  req_queue->unlocked_push(Nexus::BgWorkItem::make_req_item(context, sslot));
+  push_bg_work_item_st(bg_etid,
+                       Nexus::BgWorkItem::make_req_item(context, sslot));
 }
 
-void Rpc::submit_bg_resp_st(erpc_cont_func_t cont_func, void *tag,
+template <class TTransport>
+void Rpc<TTransport>::submit_bg_resp_st(erpc_cont_func_t cont_func, void *tag,
                                  size_t bg_etid) {
   assert(in_dispatch());
   assert(nexus->num_bg_threads > 0);
   assert(bg_etid < nexus->num_bg_threads);
 
-  auto *req_queue = nexus_hook.bg_req_queue_arr[bg_etid];
-  req_queue->unlocked_push(
-      Nexus::BgWorkItem::make_resp_item(context, cont_func, tag));
+  push_bg_work_item_st(
+      bg_etid, Nexus::BgWorkItem::make_resp_item(context, cont_func, tag));
+}
+
+template <class TTransport>
+void Rpc<TTransport>::push_bg_work_item_st(size_t bg_etid,
+                                           const Nexus::BgWorkItem &wi) {
+  // Items that find earlier ones in the overflow list queue behind them, so
+  // that each background thread gets its items in order
+  auto &overflow = bg_overflow[bg_etid];
+  if (likely(overflow.empty()) &&
+      likely(nexus_hook.bg_req_queue_arr[bg_etid]->try_push(wi))) {
+    return;
+  }
+
+  overflow.push_back(wi);
+  bg_overflow_size++;
 }
 
 FORCE_COMPILE_TRANSPORTS
@@ -11,7 +11,9 @@ namespace erpc {
 
 // This function is not on the critical path and is exposed to the user,
 // so the args checking is always enabled.
-int Rpc::create_session_st(std::string remote_uri, uint8_t rem_rpc_id) {
+template <class TTransport>
+int Rpc<TTransport>::create_session_st(std::string remote_uri, uint8_t rem_rpc_id,
+                                      size_t req_window, size_t credits) {
   char issue_msg[kMaxIssueMsgLen];  // The basic issue message
   sprintf(issue_msg, "Rpc %u: create_session() failed. Issue", rpc_id);
 
@@ -37,14 +39,25 @@ int Rpc::create_session_st(std::string remote_uri, uint8_t rem_rpc_id) {
     return -EINVAL;
   }
 
-  // Ensure that we have ring buffers for this session
-  if (!have_ring_entries()) {
-    ERPC_WARN("%s: Ring buffers exhausted.\n", issue_msg);
+  if (!is_power_of_two(req_window) || req_window > kSessionMaxReqWindow) {
+    ERPC_WARN("%s: Invalid request window %zu.\n", issue_msg, req_window);
+    return -EINVAL;
+  }
+
+  if (credits < kSessionMinCredits || credits > kSessionCredits) {
+    ERPC_WARN("%s: Invalid credits %zu.\n", issue_msg, credits);
+    return -EINVAL;
+  }
+
+  // Ensure that we have a session number for this session
+  if (session_vec.size() >= get_max_num_sessions()) {
+    ERPC_WARN("%s: Sessions exhausted.\n", issue_msg);
     return -ENOMEM;
   }
 
-  auto *session = new Session(Session::Role::kClient, slow_rand.next_u64(),
-                              get_freq_ghz(), transport->get_bandwidth());
+  auto *session =
+      new Session(Session::Role::kClient, slow_rand.next_u64(), get_freq_ghz(),
+                  transport->get_bandwidth(), req_window, credits);
   session->state = SessionState::kConnectInProgress;
   session->local_session_num = session_vec.size();
 
@@ -53,27 +66,53 @@ int Rpc::create_session_st(std::string remote_uri, uint8_t rem_rpc_id) {
   SessionEndpoint &client_endpoint = session->client;
   strcpy(client_endpoint.hostname, nexus->hostname.c_str());
   client_endpoint.sm_udp_port = nexus->sm_udp_port;
-  client_endpoint.data_udp_port = nexus->sm_udp_port + 1;
+  client_endpoint.data_udp_port = transport->data_udp_port;
   client_endpoint.rpc_id = rpc_id;
   client_endpoint.session_num = session->local_session_num;
+  client_endpoint.host_id = transport->host_id;
+  client_endpoint.req_window = req_window;
+  client_endpoint.credits = credits;
+  client_endpoint.dgram_split = transport->splits_dgrams();
   // client_endpoint.routing_info = ??
 
   SessionEndpoint &server_endpoint = session->server;
   strcpy(server_endpoint.hostname, rem_hostname.c_str());
   server_endpoint.sm_udp_port = rem_sm_udp_port;
-  server_endpoint.data_udp_port = rem_sm_udp_port + 1;
+  // server_endpoint.data_udp_port = ??
   server_endpoint.rpc_id = rem_rpc_id;
   // server_endpoint.session_num = ??
-  server_endpoint.routing_info = Transport::make_routing_info(rem_hostname, rem_sm_udp_port + 1);
+  // server_endpoint.routing_info = ??
+
+  // We don't know yet if the server is on this host, so offer it a channel.
+  // The server uses it only if it has our host ID. A server in our Nexus
+  // picks up an in-process channel from the Nexus instead.
+  const bool same_nexus =
+      rem_hostname == nexus->hostname && rem_sm_udp_port == nexus->sm_udp_port;
+  if ((same_nexus ? kLoopbackChannels : kShmChannels) &&
+      transport->can_open_shm_channel()) {
+    size_t chan;
+    if (same_nexus) {
+      std::shared_ptr<uint8_t> region = TTransport::alloc_loopback_region();
+      chan = transport->open_loopback_channel(region, true);
+      nexus->offer_loopback_region(session->uniq_token, region);
+    } else {
+      chan = transport->open_shm_channel(shm_channel_name(session->uniq_token), true);
+    }
+
+    if (chan != TTransport::kInvalidShmChannel) {
+      TTransport::set_shm_channel(&server_endpoint.routing_info, chan);
+      client_endpoint.shm_channel = true;
+    }
+  }
 
-  alloc_ring_entries();
   session_vec.push_back(session);  // Add to list of all sessions
 
   send_sm_req_st(session);
   return client_endpoint.session_num;
 }
 
-int Rpc::destroy_session_st(int session_num) {
+template <class TTransport>
+int Rpc<TTransport>::destroy_session_st(int session_num) {
   char issue_msg[kMaxIssueMsgLen];  // The basic issue message
   sprintf(issue_msg, "Rpc %u, lsn %u: destroy_session() failed. Issue", rpc_id,
           session_num);
@@ -100,7 +139,7 @@ int Rpc::destroy_session_st(int session_num) {
   }
 
   // A session can be destroyed only when all its sslots are free
-  if (session->client_info.sslot_free_vec.size() != kSessionReqWindow) {
+  if (session->client_info.sslot_free_vec.size() != session->req_window) {
     ERPC_WARN("%s: Session has pending RPC requests.\n", issue_msg);
     return -EBUSY;
   }
@@ -138,7 +177,8 @@ int Rpc::destroy_session_st(int session_num) {
   }
 }
 
-size_t Rpc::num_active_sessions_st() {
+template <class TTransport>
+size_t Rpc<TTransport>::num_active_sessions_st() {
   assert(in_dispatch());
 
   size_t ret = 0;
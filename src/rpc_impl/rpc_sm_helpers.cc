@@ -6,12 +6,13 @@
 
 namespace erpc {
 
-void Rpc::handle_sm_rx_st() {
+template <class TTransport>
+void Rpc<TTransport>::handle_sm_rx_st() {
   assert(in_dispatch());
-  MtQueue<SmWorkItem> &queue = nexus_hook.sm_rx_queue;
+  auto &queue = nexus_hook.sm_rx_queue;
 
-  while (queue.size > 0) {
-    const SmWorkItem wi = queue.unlocked_pop();
+  while (!queue.empty()) {
+    const SmWorkItem wi = queue.pop();
     assert(!wi.is_reset());
 
     // Here, it's not a reset item, so we have a valid SM packet
@@ -36,7 +37,8 @@ void Rpc::handle_sm_rx_st() {
   }
 }
 
-void Rpc::bury_session_st(Session *session) {
+template <class TTransport>
+void Rpc<TTransport>::bury_session_st(Session *session) {
   assert(in_dispatch());
 
   // Free session resources
@@ -45,16 +47,29 @@ void Rpc::bury_session_st(Session *session) {
   // guaranteed to have been freed at this point?
 
   if (session->is_server()) {
-    for (const SSlot &sslot : session->sslot_arr) {
+    for (SSlot &sslot : session->sslot_arr) {
       free_msg_buffer(sslot.pre_resp_msgbuf);  // Prealloc buf is always valid
+      bury_resp_msgbuf_server_st(&sslot);
+      if (sslot.server_info.cr_listed) {
+        cr_pending_sslots.erase(std::find(cr_pending_sslots.begin(),
+                                          cr_pending_sslots.end(), &sslot));
+      }
     }
+    return_lent_credits_st(session);
+  }
+
+  size_t chan = TTransport::get_shm_channel(session->remote_routing_info);
+  if (chan != TTransport::kInvalidShmChannel) {
+    if (session->is_client()) nexus->take_loopback_region(session->uniq_token);
+    transport->close_shm_channel(chan);
   }
 
   session_vec.at(session->local_session_num) = nullptr;
   delete session;  // This does nothing except free the session memory
 }
 
-void Rpc::sm_pkt_udp_tx_st(const SmPkt &sm_pkt) {
+template <class TTransport>
+void Rpc<TTransport>::sm_pkt_udp_tx_st(const SmPkt &sm_pkt) {
   ERPC_INFO("Rpc %u: Sending packet %s.\n", rpc_id, sm_pkt.to_string().c_str());
   const std::string rem_hostname =
       sm_pkt.is_req() ? sm_pkt.server.hostname : sm_pkt.client.hostname;
@@ -64,7 +79,8 @@ void Rpc::sm_pkt_udp_tx_st(const SmPkt &sm_pkt) {
   udp_client.send(rem_hostname, rem_sm_udp_port, sm_pkt);
 }
 
-void Rpc::send_sm_req_st(Session *session) {
+template <class TTransport>
+void Rpc<TTransport>::send_sm_req_st(Session *session) {
   assert(in_dispatch());
 
   sm_pending_reqs.insert(session->local_session_num);  // Duplicates are fine
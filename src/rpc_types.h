@@ -36,6 +36,47 @@ class ReqHandle;
  */
 typedef void (*erpc_req_func_t)(ReqHandle *req_handle, void *context);
 
+/**
+ * @relates Rpc
+ *
+ * @brief The type of the chunk callback of a streaming request handler. It
+ * runs in the foreground as the request's packets arrive, once for each
+ * newly contiguous range of the request, in order. Together the chunks cover
+ * the whole request, and the request handler runs after the last chunk.
+ *
+ * The callback must not enqueue a response. A chunk with offset zero starts a
+ * new request on the handle. If the client abandons a request, its handler
+ * never runs.
+ *
+ * @param req_handle A handle to the partially received request
+ * @param chunk The chunk's data, valid only during the callback. The request
+ * handler finds the whole request in the request msgbuf.
+ * @param offset The offset of the chunk in the request
+ * @param size The size of the chunk
+ * @param context The context that was used while creating the Rpc object
+ */
+typedef void (*erpc_req_chunk_func_t)(ReqHandle *req_handle,
+                                      const uint8_t *chunk, size_t offset,
+                                      size_t size, void *context);
+
+/**
+ * @relates Rpc
+ *
+ * @brief The type of a batched request handler. It runs in the foreground,
+ * once per RX batch, with all requests of its type that completed in the
+ * batch, in arrival order. The application can, e.g., prefetch the data of
+ * every request before working on any of them.
+ *
+ * Request buffer ownership is as for erpc_req_func_t, with the duration of
+ * the batched handler in place of the request handler's.
+ *
+ * @param req_handles Handles to the received requests
+ * @param num_reqs The number of handles in \p req_handles
+ * @param context The context that was used while creating the Rpc object
+ */
+typedef void (*erpc_req_batch_func_t)(ReqHandle *const *req_handles,
+                                      size_t num_reqs, void *context);
+
 /**
  * @relates Rpc
  *
@@ -48,6 +89,19 @@ typedef void (*erpc_req_func_t)(ReqHandle *req_handle, void *context);
  */
 typedef void (*erpc_cont_func_t)(void *context, void *tag);
 
+/**
+ * @relates Rpc
+ * @brief The outcome of a request, available in its continuation from
+ * MsgBuffer::get_resp_status() of the response. The response of a failed
+ * request has zero size.
+ */
+enum class RespStatus : uint8_t {
+  kOk,           ///< The response was received
+  kTimedOut,     ///< The request's deadline expired
+  kCancelled,    ///< The application cancelled the request
+  kSessionReset  ///< The session was reset, e.g., because the server failed
+};
+
 /**
  * @relates Rpc
  * @brief The possible kinds of request handlers. Foreground-mode handlers run
@@ -56,6 +110,15 @@ typedef void (*erpc_cont_func_t)(void *context, void *tag);
  */
 enum class ReqFuncType : uint8_t { kForeground, kBackground };
 
+/**
+ * @relates Rpc
+ * @brief The priority class of a request type. Packets of high-priority
+ * requests bypass the timing wheel, are sent ahead of normal packets, and are
+ * processed first from an RX batch. The class applies to both the client and
+ * the server, so both must register the request type with the same class.
+ */
+enum class ReqPriority : uint8_t { kNormal, kHigh };
+
 /**
  * @relates Rpc
  * @brief The request handler registered by applications
@@ -64,19 +127,54 @@ class ReqFunc {
  public:
   erpc_req_func_t req_func;   ///< The handler function
   ReqFuncType req_func_type;  ///< The handlers's mode (foreground/background)
+  ReqPriority req_priority;   ///< The priority class of this request type
+
+  /// The chunk callback of a streaming handler, or nullptr
+  erpc_req_chunk_func_t req_chunk_func;
+
+  /// The batched handler, or nullptr. If set, req_func is unused.
+  erpc_req_batch_func_t req_batch_func;
 
   inline bool is_background() const {
     return req_func_type == ReqFuncType::kBackground;
   }
 
-  ReqFunc() { req_func = nullptr; }
+  /// Check if this is a streaming request handler
+  inline bool is_streaming() const { return req_chunk_func != nullptr; }
+
+  /// Check if this is a batched request handler
+  inline bool is_batched() const { return req_batch_func != nullptr; }
+
+  ReqFunc() {
+    req_func = nullptr;
+    req_priority = ReqPriority::kNormal;
+    req_chunk_func = nullptr;
+    req_batch_func = nullptr;
+  }
 
-  ReqFunc(erpc_req_func_t req_func, ReqFuncType req_func_type)
-      : req_func(req_func), req_func_type(req_func_type) {
+  ReqFunc(erpc_req_func_t req_func, ReqFuncType req_func_type,
+          ReqPriority req_priority = ReqPriority::kNormal,
+          erpc_req_chunk_func_t req_chunk_func = nullptr)
+      : req_func(req_func),
+        req_func_type(req_func_type),
+        req_priority(req_priority),
+        req_chunk_func(req_chunk_func),
+        req_batch_func(nullptr) {
     rt_assert(req_func != nullptr, "Invalid Ops with null handler function");
   }
 
+  ReqFunc(erpc_req_batch_func_t req_batch_func, ReqPriority req_priority)
+      : req_func(nullptr),
+        req_func_type(ReqFuncType::kForeground),
+        req_priority(req_priority),
+        req_chunk_func(nullptr),
+        req_batch_func(req_batch_func) {
+    rt_assert(req_batch_func != nullptr, "Invalid Ops with null handler");
+  }
+
   /// Check if this request handler is registered
-  inline bool is_registered() const { return req_func != nullptr; }
+  inline bool is_registered() const {
+    return req_func != nullptr || req_batch_func != nullptr;
+  }
 };
 }  // namespace erpc
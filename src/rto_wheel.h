@@ -0,0 +1,107 @@
+/**
+ * @file rto_wheel.h
+ * @brief A hashed timer wheel for client request retransmission timeouts
+ *
+ * Each active client request is in the bucket of its approximate RTO
+ * deadline. Progress on a request only updates its progress_tsc, so re-arming
+ * the timer is free. When a bucket expires, the owner re-checks the real
+ * deadline of each request in it and re-inserts those that made progress. Loss
+ * detection therefore costs O(expired requests) per tick, instead of a scan of
+ * all active requests.
+ */
+
+#pragma once
+
+#include "common.h"
+#include "sslot.h"
+
+namespace erpc {
+
+class RtoWheel {
+ public:
+  static constexpr size_t kNumBuckets = 256;  ///< Wheel size, a power of two
+  static_assert(is_power_of_two(kNumBuckets), "");
+
+  /**
+   * @brief Construct an empty wheel
+   *
+   * @param tick_cycles The time covered by one bucket, in TSC cycles
+   * @param start_tsc The TSC at which the wheel starts ticking
+   */
+  RtoWheel(size_t tick_cycles, size_t start_tsc)
+      : tick_cycles(tick_cycles), next_tick_tsc(start_tsc + tick_cycles) {
+    for (SSlot *&bucket : buckets) bucket = nullptr;
+  }
+
+  /// Insert a request that must be checked at or after \p deadline_tsc.
+  /// Deadlines past the wheel's horizon are placed in the farthest bucket.
+  inline void insert(SSlot *sslot, size_t deadline_tsc) {
+    size_t ticks = 0;
+    if (deadline_tsc > next_tick_tsc) {
+      ticks = (deadline_tsc - next_tick_tsc + tick_cycles - 1) / tick_cycles;
+      ticks = std::min(ticks, kNumBuckets - 1);
+    }
+
+    link(&buckets[(cur_bucket + ticks) % kNumBuckets], sslot);
+  }
+
+  /// Remove a request from the wheel. This is a no-op if it's not in the wheel.
+  static inline void remove(SSlot *sslot) {
+    auto &ci = sslot->client_info;
+    if (ci.rto_pprev == nullptr) return;
+
+    *ci.rto_pprev = ci.rto_next;
+    if (ci.rto_next != nullptr) {
+      ci.rto_next->client_info.rto_pprev = ci.rto_pprev;
+    }
+    ci.rto_pprev = nullptr;
+  }
+
+  /// Remove and return one request whose bucket has expired at \p now_tsc, or
+  /// nullptr if there is none. The caller re-inserts requests as needed.
+  inline SSlot *pop_expired(size_t now_tsc) {
+    // After a long pause, one pass over the buckets expires everything
+    if (now_tsc > next_tick_tsc + kNumBuckets * tick_cycles) {
+      next_tick_tsc = now_tsc - kNumBuckets * tick_cycles;
+    }
+
+    while (expired == nullptr && next_tick_tsc <= now_tsc) {
+      SSlot *&bucket = buckets[cur_bucket];
+      if (bucket != nullptr) {
+        expired = bucket;
+        expired->client_info.rto_pprev = &expired;
+        bucket = nullptr;
+      }
+
+      cur_bucket = (cur_bucket + 1) % kNumBuckets;
+      next_tick_tsc += tick_cycles;
+    }
+
+    SSlot *sslot = expired;
+    if (sslot != nullptr) remove(sslot);
+    return sslot;
+  }
+
+ private:
+  /// Add \p sslot to the head of the list at \p head
+  static inline void link(SSlot **head, SSlot *sslot) {
+    auto &ci = sslot->client_info;
+    assert(ci.rto_pprev == nullptr);
+
+    ci.rto_next = *head;
+    ci.rto_pprev = head;
+    if (*head != nullptr) (*head)->client_info.rto_pprev = &ci.rto_next;
+    *head = sslot;
+  }
+
+  const size_t tick_cycles;  ///< Time covered by one bucket
+  size_t next_tick_tsc;      ///< Expiry time of the current bucket
+  size_t cur_bucket = 0;     ///< The next bucket to expire
+
+  /// Requests from the buckets that expired, but that were not popped yet
+  SSlot *expired = nullptr;
+
+  std::array<SSlot *, kNumBuckets> buckets;  ///< Singly-linked bucket lists
+};
+
+}  // namespace erpc
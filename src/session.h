@@ -2,7 +2,9 @@
 
 #include <limits>
 #include <mutex>
+#include <deque>
 #include <queue>
+#include <vector>
 
 #include "cc/timely.h"
 #include "cc/timing_wheel.h"
@@ -12,7 +14,6 @@
 #include "sm_types.h"
 #include "sslot.h"
 #include "util/buffer.h"
-#include "util/fixed_vector.h"
 
 namespace erpc {
 
@@ -25,32 +26,45 @@ struct enq_req_args_t {
   erpc_cont_func_t cont_func;
   void *tag;
   size_t cont_etid;
+  size_t deadline_tsc;
 
   enq_req_args_t() {}
   enq_req_args_t(int session_num, uint8_t req_type, MsgBuffer *req_msgbuf,
                  MsgBuffer *resp_msgbuf, erpc_cont_func_t cont_func, void *tag,
-                 size_t cont_etid)
+                 size_t cont_etid, size_t deadline_tsc)
       : session_num(session_num),
         req_type(req_type),
         req_msgbuf(req_msgbuf),
         resp_msgbuf(resp_msgbuf),
         cont_func(cont_func),
         tag(tag),
-        cont_etid(cont_etid) {}
+        cont_etid(cont_etid),
+        deadline_tsc(deadline_tsc) {}
 };
 
-/// The arguments to enqueue_response()
+/// The arguments to enqueue_response() and enqueue_response_chunk()
 struct enq_resp_args_t {
   ReqHandle *req_handle;
   MsgBuffer *resp_msgbuf;
 
+  /// True for enqueue_response_chunk(). The chunk is then passed in chunk,
+  /// because the caller may reuse its MsgBuffer struct.
+  bool is_chunk;
+  MsgBuffer chunk;
+
   enq_resp_args_t() {}
   enq_resp_args_t(ReqHandle *req_handle, MsgBuffer *resp_msgbuf)
-      : req_handle(req_handle), resp_msgbuf(resp_msgbuf) {}
+      : req_handle(req_handle), resp_msgbuf(resp_msgbuf), is_chunk(false) {}
+  enq_resp_args_t(ReqHandle *req_handle, const MsgBuffer &chunk)
+      : req_handle(req_handle),
+        resp_msgbuf(nullptr),
+        is_chunk(true),
+        chunk(chunk) {}
 };
 
 /// A one-to-one session class for all transports
 class Session {
+  template <class T>
   friend class Rpc;
 
  public:
@@ -58,20 +72,36 @@ class Session {
 
  private:
   Session(Role role, conn_req_uniq_token_t uniq_token, double freq_ghz,
-          double link_bandwidth)
+          double link_bandwidth, size_t req_window = kSessionReqWindow,
+          size_t max_credits = kSessionCredits)
       : role(role),
         uniq_token(uniq_token),
         freq_ghz(freq_ghz),
-        link_bandwidth(link_bandwidth) {
+        link_bandwidth(link_bandwidth),
+        max_credits(max_credits) {
     remote_routing_info =
         is_client() ? &server.routing_info : &client.routing_info;
 
-    if (is_client()) client_info.cc.timely = Timely(freq_ghz, link_bandwidth);
+    if (is_client()) {
+      client_info.cc.timely = Timely(freq_ghz, link_bandwidth);
+      client_info.rto.rto_tsc = us_to_cycles(kRpcRTOUs, freq_ghz);
+    }
+    init_sslots(req_window);
+  }
+
+  /// (Re)create the session slots for a request window. This must be done
+  /// before the session's first request.
+  void init_sslots(size_t _req_window) {
+    assert(is_power_of_two(_req_window) && _req_window <= kSessionMaxReqWindow);
+    req_window = _req_window;
+    sslot_arr.resize(req_window);
+    client_info.sslot_free_vec.clear();
+    client_info.sslot_free_vec.reserve(req_window);
 
     // Arrange the free slot vector so that slots are popped in order
-    for (size_t i = 0; i < kSessionReqWindow; i++) {
+    for (size_t i = 0; i < req_window; i++) {
       // Initialize session slot with index = sslot_i
-      const size_t sslot_i = (kSessionReqWindow - 1 - i);
+      const size_t sslot_i = (req_window - 1 - i);
       SSlot &sslot = sslot_arr[sslot_i];
 
       // This buries all MsgBuffers
@@ -80,7 +110,7 @@ class Session {
       sslot.session = this;
       sslot.is_client = is_client();
       sslot.index = sslot_i;
-      sslot.cur_req_num = sslot_i;  // 1st req num = (+kSessionReqWindow)
+      sslot.cur_req_num = sslot_i;  // 1st req num = (+req_window)
 
       if (is_client()) {
         for (auto &x : sslot.client_info.in_wheel) x = false;
@@ -136,27 +166,54 @@ class Session {
   SessionState state;  ///< The management state of this session endpoint
   SessionEndpoint client, server;  ///< Read-only endpoint metadata
 
-  std::array<SSlot, kSessionReqWindow> sslot_arr;  ///< The session slots
+  size_t req_window;  ///< Request window, a power of two
+  size_t max_credits;  ///< Most credits that the server lends to the session
+  std::vector<SSlot> sslot_arr;  ///< The session slots, req_window of them
 
   ///@{ Info saved for faster unconditional access
   Transport::RoutingInfo *remote_routing_info;
   uint16_t local_session_num;
   uint16_t remote_session_num;
+  uint8_t remote_rpc_id;
   ///@}
 
+  /// Information that is required only at the server endpoint
+  struct {
+    size_t credits = kSessionMinCredits;  ///< Credits lent to the client
+    bool active = false;  ///< True iff the client sent a packet this scan epoch
+    size_t cr_num_pkts = 0;  ///< Packets awaiting the sslots' pending CRs
+  } server_info;
+
   /// Information that is required only at the client endpoint
   struct {
-    size_t credits = kSessionCredits;  ///< Currently available credits
+    size_t credits = kSessionMinCredits;  ///< Currently available credits
+    size_t credit_limit = kSessionMinCredits;  ///< Credits granted by server
+    size_t last_req_tsc = 0;  ///< Timestamp of the last enqueued request
 
     /// Free session slots. We could use sslot pointers, but indices are useful
     /// in request number calculation.
-    FixedVector<size_t, kSessionReqWindow> sslot_free_vec;
+    std::vector<size_t> sslot_free_vec;
 
-    /// Requests that spill over kSessionReqWindow are queued here
-    std::queue<enq_req_args_t> enq_req_backlog;
+    /// Requests that spill over the request window are queued here
+    std::deque<enq_req_args_t> enq_req_backlog;
 
     size_t num_re_tx = 0;  ///< Number of retransmissions for this session
 
+    /// Requests with packets to send that wait for credits or for their turn,
+    /// served in deficit round robin order. Intrusive FIFO through tx_next.
+    /// High-priority requests form a FIFO segment at the front of the queue,
+    /// which ends at tx_hi_tail.
+    SSlot *tx_head = nullptr, *tx_tail = nullptr;
+    SSlot *tx_hi_tail = nullptr;  ///< Last high-priority request in the queue
+    bool tx_ready = false;  ///< True iff in the Rpc's ready session list
+
+    /// Retransmission timeout, computed from RTT samples as in RFC 6298
+    struct {
+      size_t srtt_tsc = 0;    ///< Smoothed RTT in cycles, zero before a sample
+      size_t rttvar_tsc = 0;  ///< RTT variation in cycles
+      size_t rto_tsc;         ///< Current retransmission timeout in cycles
+    } rto;
+
     // Congestion control
     struct {
       Timely timely;
@@ -6,23 +6,41 @@
 
 namespace erpc {
 
-/// Packet credits. This must be a power of two for fast matching of packet
-/// numbers to their position in the TX timestamp array.
+/// Default and maximum packet credits of a session. This must be a power of
+/// two for fast matching of packet numbers to their position in the TX
+/// timestamp array.
 static constexpr size_t kSessionCredits = 64;
 static_assert(is_power_of_two(kSessionCredits), "");
+static_assert(kSessionCredits <= UINT8_MAX, "Credit counts are sent in 8 bits");
+static_assert(kSessionCredits <= 64, "Packet ack bitmaps are 64 bits");
 
-/// Request window size. This must be a power of two for fast multiplication and
-/// modulo calculation during request number assignment and slot number
-/// decoding, respectively.
+/// Credits that a session always holds. The server lends more credits, up to
+/// the session's credit count, from a pool shared by all its sessions.
+static constexpr size_t kSessionMinCredits = 1;
+static_assert(kSessionMinCredits >= 1 && kSessionMinCredits <= kSessionCredits, "");
+
+/// Default request window size. Windows must be powers of two for fast
+/// multiplication and modulo calculation during request number assignment and
+/// slot number decoding, respectively.
 static constexpr size_t kSessionReqWindow = 8;
 static_assert(is_power_of_two(kSessionReqWindow), "");
 
+/// Maximum request window size of a session
+static constexpr size_t kSessionMaxReqWindow = 256;
+static_assert(is_power_of_two(kSessionMaxReqWindow), "");
+static_assert(kSessionReqWindow <= kSessionMaxReqWindow, "");
+
 // Invalid metadata values for session endpoint initialization
 static constexpr uint16_t kInvalidSessionNum = UINT16_MAX;
 
 // A cluster-wide unique token for each session, generated on session creation
 typedef size_t conn_req_uniq_token_t;
 
+/// Return the name of the shared-memory channel of the session with this token
+static inline std::string shm_channel_name(conn_req_uniq_token_t uniq_token) {
+  return "/erpc-shm-" + std::to_string(uniq_token);
+}
+
 enum class SessionState {
   kConnectInProgress,     ///< Client-only state, connect request is in flight
   kConnected,             ///< Session is successfully connected
@@ -44,7 +62,7 @@ enum class SmPktType : int {
 enum class SmErrType : int {
   kNoError,          ///< The only non-error error type
   kSrvDisconnected,  ///< The control-path connection to the server failed
-  kRingExhausted,    ///< Connect req failed because server is out of ring bufs
+  kRingExhausted,    ///< Connect req failed because server is out of sessions
   kOutOfMemory,      ///< Connect req failed because server is out of memory
   kRoutingResolutionFailure,  ///< Server failed to resolve client routing info
   kInvalidRemoteRpcId,  ///< Connect req failed because remote RPC ID was wrong
@@ -147,7 +165,7 @@ static std::string sm_err_type_str(SmErrType err_type) {
   switch (err_type) {
     case SmErrType::kNoError: return "[No error]";
     case SmErrType::kSrvDisconnected: return "[Server disconnected]";
-    case SmErrType::kRingExhausted: return "[Ring buffers exhausted]";
+    case SmErrType::kRingExhausted: return "[Sessions exhausted]";
     case SmErrType::kOutOfMemory: return "[Out of memory]";
     case SmErrType::kRoutingResolutionFailure:
       return "[Routing resolution failure]";
@@ -173,9 +191,18 @@ class SessionEndpoint {
  public:
   char hostname[kMaxHostnameLen];  ///< DNS-resolvable hostname
   uint16_t sm_udp_port;            ///< Management UDP port
-  uint16_t data_udp_port;            ///< Management UDP port
+  uint16_t data_udp_port;          ///< Datapath UDP port of the owner Rpc
   uint8_t rpc_id;                  ///< ID of the owner
   uint16_t session_num;  ///< The session number of this endpoint in its Rpc
+  size_t host_id;        ///< Transport::host_id of the owner
+  bool shm_channel;      ///< True iff the endpoint uses a shared-memory channel
+  bool dgram_split;      ///< True iff the owner splits coalesced datagrams
+
+  /// Request window and credits that the client asks for, or that the server
+  /// grants
+  uint16_t req_window;
+  uint8_t credits;
+
   Transport::RoutingInfo routing_info;  ///< Endpoint's routing info
 
   SessionEndpoint() {
@@ -184,6 +211,11 @@ class SessionEndpoint {
     data_udp_port = 0;
     rpc_id = kInvalidRpcId;
     session_num = kInvalidSessionNum;
+    host_id = 0;
+    shm_channel = false;
+    dgram_split = false;
+    req_window = kSessionReqWindow;
+    credits = kSessionCredits;
     memset(static_cast<void *>(&routing_info), 0, sizeof(routing_info));
   }
 
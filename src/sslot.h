@@ -1,5 +1,7 @@
 #pragma once
 
+#include <deque>
+
 #include "msg_buffer.h"
 #include "rpc_types.h"
 #include "sm_types.h"
@@ -14,8 +16,10 @@ class Nexus;
 class SSlot {
   friend class Session;
   friend class Nexus;
+  template <class T>
   friend class Rpc;
   friend class ReqHandle;
+  friend class RtoWheel;
 
  public:
   SSlot() {}
@@ -52,21 +56,56 @@ class SSlot {
       erpc_cont_func_t cont_func;  ///< Continuation function for the request
       void *tag;                   ///< Tag of the request
 
+      /// Packet number of the first packet of the current response chunk
+      size_t resp_pkt_base;
+
       /// Number of packets sent. Packets up to (num_tx - 1) have been sent.
       size_t num_tx;
 
-      /// Number of pkts received. Pkts up to (num_tx - 1) have been received.
+      /// Number of sent packets that the server has answered
       size_t num_rx;
 
+      /// Packets up to (ack_base - 1) have been answered. Packets are sent
+      /// only up to (ack_base + kSessionCredits - 1).
+      size_t ack_base;
+
+      /// Bit i is set iff packet (ack_base + i) has been answered
+      uint64_t ack_bitmap;
+
       /// TSC at which we last sent or retransmitted a packet, or received an
       /// in-order packet for this request
       size_t progress_tsc;
 
+      /// True iff we retransmitted a packet of this request. Later RTT samples
+      /// are ambiguous, so they are not used for the RTO (Karn's algorithm).
+      bool re_tx;
+
+      /// Packets up to (fast_retx_end - 1) have been fast-retransmitted once
+      size_t fast_retx_end;
+
+      /// The TSC by which the request fails with RespStatus::kTimedOut, or
+      /// zero if the request has no deadline
+      size_t deadline_tsc;
+
+      /// kOk, unless the request is failing with this status. A failing
+      /// request waits for its paced packets to leave the wheel before its
+      /// continuation is invoked.
+      RespStatus fail_status;
+
       size_t cont_etid;  ///< eRPC thread ID to run the continuation on
 
       /// Pointers for the intrusive doubly-linked list of active RPCs
       SSlot *prev, *next;
 
+      /// Links in the RTO wheel bucket list that holds this request. rto_pprev
+      /// is nullptr iff the request is not in the RTO wheel.
+      SSlot *rto_next, **rto_pprev;
+
+      // Fields for the session's TX scheduler
+      SSlot *tx_next;     ///< Next request in the session's TX queue
+      bool in_tx_queue;   ///< True iff this request is in the TX queue
+      size_t tx_deficit;  ///< Packets left in this request's scheduler turn
+
       // Fields for congestion control, cold if CC is disabled.
 
       /// Packet number n is in the wheel (including its ready queue) iff
@@ -93,12 +132,52 @@ class SSlot {
       uint8_t req_type;
       ReqFuncType req_func_type;  ///< The req handler type (e.g., background)
 
-      /// Number of pkts received. Pkts up to (num_rx - 1) have been received.
+      /// Number of request pkts received, or past the request, one more than
+      /// the largest RFR packet number received
       size_t num_rx;
 
-      /// The server remembers the number of packets in the request after
-      /// burying the request in enqueue_response().
-      size_t sav_num_req_pkts;
+      /// Request packets up to (rx_base - 1) have been received
+      size_t rx_base;
+
+      /// Bit i is set iff request packet (rx_base + i) has been received
+      uint64_t rx_bitmap;
+
+      // Fields for delayed credit returns. See Rpc::add_pending_cr_st().
+
+      /// Request packets received since the last credit return, or zero
+      size_t cr_num_pkts;
+      size_t cr_pkt_lo;     ///< The smallest of these packets' numbers
+      size_t cr_pkt_hi;     ///< The largest of these packets' numbers
+      uint8_t cr_req_type;  ///< The request type, copied to the credit return
+      size_t cr_first_tsc;  ///< Event loop TSC of the first of these packets
+      size_t cr_tsc;  ///< Event loop TSC at which cr_pkt_hi was counted
+      bool cr_listed;  ///< True iff this sslot is in Rpc::cr_pending_sslots
+
+      /// Packet number of tx_msgbuf's first packet. The server remembers this
+      /// after burying the request in enqueue_response().
+      size_t resp_pkt_base;
+
+      // Fields for chunked responses. See Rpc::enqueue_response_chunk().
+
+      /// The response chunk being sent, owned by eRPC
+      MsgBuffer resp_chunk;
+
+      /// Response chunks waiting for the client to pull them. This is non-null
+      /// iff the response is chunked.
+      std::deque<MsgBuffer> *resp_chunk_q;
+
+      /// Chunks accepted by enqueue_response_chunk() that wait in resp_chunk_q
+      /// or in the background queue, at most Rpc::kMaxRespChunks. Background
+      /// threads update this atomically.
+      size_t resp_chunks_waiting;
+
+      /// The final response of a chunked response, or nullptr if the handler
+      /// hasn't enqueued it yet
+      MsgBuffer *resp_final;
+
+      /// The TSC after which the client has abandoned the request, or zero if
+      /// the request has no deadline
+      size_t deadline_tsc;
     } server_info;
   };
 
@@ -6,6 +6,11 @@
 
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <sys/socket.h>
 #include <stdint.h>
 #include "common.h"
@@ -18,7 +23,28 @@ namespace erpc {
 
 class STDAlloc;  // Forward declaration: HugeAlloc needs MemRegInfo
 
-/// Generic unreliable transport
+/**
+ * @brief Generic unreliable transport. This holds the state and helpers that
+ * are shared by all transports: the UDP socket, the RX ring slab, and the
+ * shared-memory channels.
+ *
+ * Rpc<TTransport> is compiled against a concrete transport that derives from
+ * this class. There are no virtual functions: the Rpc calls the concrete
+ * transport's datapath functions directly, so they can be inlined. A concrete
+ * transport must provide:
+ *
+ *  - <tt>TTransport(uint16_t data_udp_port, uint8_t rpc_id, size_t numa_node,
+ *    FILE* trace_file)</tt>
+ *  - <tt>void init_mem(uint8_t** rx_ring)</tt>
+ *  - <tt>void tx_burst(const tx_burst_item_t* tx_burst_arr, size_t
+ *    num_pkts)</tt>
+ *  - <tt>void tx_flush()</tt>
+ *  - <tt>size_t rx_burst()</tt>
+ *  - <tt>void post_recvs(size_t num_recvs)</tt>
+ *
+ * It inherits kMaxDataPerPkt, kNumRxRingEntries, kPostlist, RoutingInfo and
+ * tx_burst_item_t from this class, and may shadow the constants.
+ */
 class Transport {
  public:
   static constexpr size_t kMTU = 1600;
@@ -28,6 +54,7 @@ class Transport {
 
   // rx_ring是一个循环队列，第一次收到10个包会放在0~9，之后放10
   static constexpr size_t kNumRxRingEntries = 4096;
+  static_assert(kMTU % 64 == 0, "RX ring slab entries must be cache-aligned");
 
   // 好象是批发传输的包数量
   static constexpr size_t kPostlist = 32;
@@ -36,13 +63,51 @@ class Transport {
   static constexpr size_t kCtrlBufferSize = 64;
   static_assert(kCtrlBufferSize >= kPostlist, "kCtrlBufferSize too small");
 
+  static_assert(kPostlist * kMTU <= 65507, "GSO datagram exceeds UDP limit");
+
+  /// Packet slots in each direction of a same-host shared-memory channel
+  static constexpr size_t kShmRingSlots = 256;
+  static_assert(is_power_of_two(kShmRingSlots), "");
+
+  /// Maximum open shm channels per Rpc. Sessions beyond this use UDP.
+  static constexpr size_t kMaxShmChannels = 64;
+
+  static constexpr size_t kInvalidShmChannel = SIZE_MAX;
+
  public:
   // Info about dest
   struct RoutingInfo {
-    uint8_t buf[64]; // ai_addrlen:sizeof(socklen_t)
+    uint8_t buf[64]; // ai_addrlen:sizeof(socklen_t), ..., dgram split, shm channel + 1
   };
   static RoutingInfo make_routing_info(std::string hostname, uint16_t port);
 
+  /// Return the shared-memory channel that packets to \p ri use, or
+  /// kInvalidShmChannel if they use UDP
+  static inline size_t get_shm_channel(const RoutingInfo* ri) {
+    uint32_t chan_plus_one;
+    memcpy(&chan_plus_one, &ri->buf[sizeof(ri->buf) - sizeof(uint32_t)], sizeof(uint32_t));
+    return chan_plus_one == 0 ? kInvalidShmChannel : chan_plus_one - 1;
+  }
+
+  /// Send packets to \p ri over shared-memory channel \p chan, or over UDP if
+  /// \p chan is kInvalidShmChannel
+  static inline void set_shm_channel(RoutingInfo* ri, size_t chan) {
+    uint32_t chan_plus_one = chan == kInvalidShmChannel ? 0 : static_cast<uint32_t>(chan + 1);
+    memcpy(&ri->buf[sizeof(ri->buf) - sizeof(uint32_t)], &chan_plus_one, sizeof(uint32_t));
+  }
+
+  /// Return true iff the Rpc at \p ri splits coalesced datagrams, so small
+  /// packets to it may share a datagram
+  static inline bool get_dgram_split(const RoutingInfo* ri) {
+    return ri->buf[sizeof(ri->buf) - sizeof(uint32_t) - 1] != 0;
+  }
+
+  /// Record whether the Rpc at \p ri splits coalesced datagrams. Sessions
+  /// learn this from the peer's SessionEndpoint when they connect.
+  static inline void set_dgram_split(RoutingInfo* ri, bool split) {
+    ri->buf[sizeof(ri->buf) - sizeof(uint32_t) - 1] = split ? 1 : 0;
+  }
+
   /// Info about a packet to transmit
   struct tx_burst_item_t {
     RoutingInfo* routing_info;  ///< Routing info for this packet
@@ -54,51 +119,42 @@ class Transport {
   };
 
   /**
-   * @brief Partially construct the transport object without using eRPC's
-   * hugepage allocator. The device driver is allowed to use its own hugepages
-   * (with a different allocator).
+   * @brief Create or open the shared-memory channel of a session whose
+   * endpoints are on the same host
    *
-   * This function must initialize \p reg_mr_func and \p dereg_mr_func, which
-   * will be used to construct the allocator.
+   * @param name The channel's name, unique to the session
+   * @param create True at the client, which creates the channel before the
+   * connect handshake. False at the server, which opens it.
    *
-   * @param rpc_id The RPC ID of the parent RPC
-   *
-   * @throw runtime_error if creation fails
+   * @return The channel ID, or kInvalidShmChannel if the channel could not be
+   * created or opened
    */
-  Transport(uint16_t data_udp_port, uint8_t rpc_id, size_t numa_node, FILE* trace_file);
-
-  void init_mem(uint8_t** rx_ring);
+  size_t open_shm_channel(const std::string& name, bool create);
 
-  ~Transport();
+  /// Allocate the zeroed region of an in-process channel between two Rpcs in
+  /// one process
+  static std::shared_ptr<uint8_t> alloc_loopback_region();
 
   /**
-   * @brief Transmit a batch of packets
-   *
-   * Multiple packets may belong to the same msgbuf; burst items contain
-   * offsets into a msgbuf.
+   * @brief Attach to an in-process channel. In-process channels work like
+   * shared-memory channels, except that the region is on the heap and the
+   * Rpcs rendezvous through their Nexus.
    *
-   * @param tx_burst_arr Info about the packets to TX
-   * @param num_pkts The total number of packets to transmit (<= \p kPostlist)
+   * @param create True at the client, which allocated the region
+   * @return The channel ID, or kInvalidShmChannel if kMaxShmChannels are open
    */
-  void tx_burst(const tx_burst_item_t* tx_burst_arr, size_t num_pkts);
+  size_t open_loopback_channel(std::shared_ptr<uint8_t> region, bool create);
 
-  /// Complete pending TX DMAs, returning ownership of all TX buffers to eRPC
-  void tx_flush();
+  /// Unmap or detach a channel. The RX ring must not hold its packets.
+  void close_shm_channel(size_t chan);
 
-  /**
-   * @brief The generic packet RX function
-   *
-   * @return the number of new packets available in the RX ring. The Rpc layer
-   * controls posting of RECVs explicitly using post_recvs().
-   */
-  size_t rx_burst();
+  /// Return true iff another shm or in-process channel can be opened
+  bool can_open_shm_channel() const {
+    return num_shm_channels < kMaxShmChannels;
+  }
 
-  /**
-   * @brief Post RECVs to the receive queue
-   *
-   * @param num_recvs The zero or more RECVs to post
-   */
-  void post_recvs(size_t num_recvs);
+  /// Return true iff this transport splits coalesced datagrams on receipt
+  bool splits_dgrams() const { return coalesce_enabled; }
 
   /// Return the link bandwidth (bytes per second)
   size_t get_bandwidth() const { return 1 << 30; } // FIXME
@@ -107,19 +163,211 @@ class Transport {
   const uint16_t data_udp_port;   ///< UDP port for datapath
   const uint8_t rpc_id;    ///< The parent Rpc's ID
   const size_t numa_node;  ///< The NUMA node of the parent Nexus
+  const size_t host_id;    ///< Equal for transports on the same host
 
   // Members initialized after the hugepage allocator is provided
   FILE* trace_file;       ///< The parent Rpc's high-verbosity log file
 
   struct {
     size_t tx_flush_count = 0;  ///< Number of times tx_flush() has been called
+    size_t zc_enobufs = 0;      ///< Zero-copy sends to fail with ENOBUFS
   } testing;
 
-private:
-  std::allocator<uint8_t> allocator;
+  /// Datapath stats that can be disabled at compile-time
+  struct {
+    size_t syscalls = 0;  ///< System calls made by the datapath
+  } dpath_stats;
+
+protected:
+  /**
+   * @brief Create and bind the datapath UDP socket. Only concrete transports
+   * construct a Transport.
+   *
+   * @param rpc_id The RPC ID of the parent RPC
+   *
+   * @throw runtime_error if creation fails
+   */
+  Transport(uint16_t data_udp_port, uint8_t rpc_id, size_t numa_node, FILE* trace_file);
+
+  ~Transport();
+
+  /**
+   * @brief Back all RX ring entries with one slab. Entry i starts at
+   * rx_slab + i * rx_buf_size, and \p extra_size bytes follow the last entry.
+   */
+  void init_rx_slab(uint8_t** rx_ring, size_t rx_buf_size, size_t extra_size);
+
+  /// Identify this host by its kernel boot ID
+  static size_t read_host_id();
+
+  /**
+   * @brief Copy packets bound for shared-memory channels into their rings
+   *
+   * @param udp_burst_arr Output: the packets that must be sent over UDP
+   * @return The number of packets in \p udp_burst_arr
+   */
+  size_t tx_burst_shm(const tx_burst_item_t* tx_burst_arr, size_t num_pkts,
+                      tx_burst_item_t* udp_burst_arr);
+
+  /// Point free RX ring entries at packets in shared-memory channel rings,
+  /// leaving \p num_reserved free entries untouched
+  size_t rx_burst_shm(size_t num_reserved);
+
+  /// Give the channel ring slots of the next \p num_recvs RX ring entries
+  /// back to their senders
+  void release_shm_slots(size_t num_recvs);
+
+  /**
+   * @brief Fill in tx_msgs for a batch of packets
+   *
+   * @param zerocopy Output: the MSG_ZEROCOPY choice for each message
+   * @param first_pkt Output: the index of each message's first packet
+   * @return The number of messages
+   */
+  size_t build_tx_msgs(const tx_burst_item_t* tx_burst_arr, size_t num_pkts, bool* zerocopy,
+                       size_t* first_pkt);
+
+  /**
+   * @brief Point iovecs at one packet without copying it. The zeroth packet
+   * is contiguous in the MsgBuffer. Other packets use one iovec for the
+   * trailing packet header and another for the data.
+   *
+   * @return The number of iovecs used
+   */
+  static inline size_t fill_tx_iov(const tx_burst_item_t& item, struct iovec* iov) {
+    const MsgBuffer* msg_buffer = item.msg_buffer;
+    const size_t pkt_size = msg_buffer->get_pkt_size<kMaxDataPerPkt>(item.pkt_idx);
+
+    if (item.pkt_idx == 0) {
+      iov[0].iov_base = msg_buffer->get_pkthdr_0();
+      iov[0].iov_len = pkt_size;
+      return 1;
+    }
+
+    iov[0].iov_base = msg_buffer->get_pkthdr_n(item.pkt_idx);
+    iov[0].iov_len = sizeof(pkthdr_t);
+    iov[1].iov_base = &msg_buffer->buf[item.pkt_idx * kMaxDataPerPkt];
+    iov[1].iov_len = pkt_size - sizeof(pkthdr_t);
+    return 2;
+  }
+
+  /// Set the destination address of a sendmsg() header
+  static inline void set_tx_dest(const tx_burst_item_t& item, struct msghdr* hdr) {
+    socklen_t ai_addrlen = *reinterpret_cast<const socklen_t*>(item.routing_info->buf);
+    hdr->msg_name = item.routing_info->buf + sizeof(ai_addrlen);
+    hdr->msg_namelen = ai_addrlen;
+  }
+
+  /// Return true iff this packet should be sent with MSG_ZEROCOPY. Control
+  /// packets and small messages reuse their buffers quickly and don't
+  /// amortize page pinning, so only full data packets skip the copy.
+  inline bool use_zerocopy(const tx_burst_item_t& item) const {
+    return zc_tx_enabled && item.msg_buffer->get_pkt_size<kMaxDataPerPkt>(item.pkt_idx) == kMTU;
+  }
+
+  /// Return true iff \p cur can be appended to the GSO message of \p prev,
+  /// i.e., it's the next packet of the same msgbuf and \p prev is full-size
+  static inline bool can_coalesce(const tx_burst_item_t& prev, const tx_burst_item_t& cur) {
+    return cur.msg_buffer == prev.msg_buffer && cur.routing_info == prev.routing_info &&
+           cur.pkt_idx == prev.pkt_idx + 1 &&
+           prev.msg_buffer->get_pkt_size<kMaxDataPerPkt>(prev.pkt_idx) == kMTU;
+  }
+
+  /**
+   * @brief Return the size of a packet that may share a UDP datagram with
+   * other packets, or zero if it may not. Such a packet is the only packet of
+   * its message, so the receiver finds its size from pkthdr_t::msg_size.
+   * Control packets' msgbufs are larger than the packet, so the returned size
+   * can be smaller than the msgbuf's packet size.
+   */
+  static inline size_t coalesce_size(const tx_burst_item_t& item) {
+    if (item.pkt_idx != 0) return 0;
+    const pkthdr_t* pkthdr = item.msg_buffer->get_pkthdr_0();
+    const size_t pkt_size = sizeof(pkthdr_t) + pkthdr->msg_size;
+    if (pkthdr->msg_size > kMaxDataPerPkt ||
+        pkt_size > item.msg_buffer->get_pkt_size<kMaxDataPerPkt>(0)) {
+      return 0;
+    }
+    return pkt_size;
+  }
+
+  /// Return true iff packets \p a and \p b go to the same Rpc. With a shared
+  /// datapath port, the kernel steers a datagram by its first packet's header.
+  static inline bool same_dest(const tx_burst_item_t& a, const tx_burst_item_t& b) {
+    if (a.msg_buffer->get_pkthdr_0()->dest_rpc_id != b.msg_buffer->get_pkthdr_0()->dest_rpc_id) {
+      return false;
+    }
+    if (a.routing_info == b.routing_info) return true;
+    socklen_t ai_addrlen = *reinterpret_cast<const socklen_t*>(a.routing_info->buf);
+    return memcmp(a.routing_info->buf, b.routing_info->buf, sizeof(ai_addrlen) + ai_addrlen) == 0;
+  }
+
   uint8_t** rx_ring;
+  uint8_t* rx_slab = nullptr;  ///< Backing memory for all RX ring buffers
+  size_t rx_slab_size = 0;     ///< Size of rx_slab, a multiple of 2 MB
+  size_t rx_buf_size = 0;      ///< Stride of RX ring entries in rx_slab
   size_t rx_ring_head, rx_ring_tail;  ///< Current unused RX ring buffer
   int sock_fd;
-  uint8_t* send_buf;
+
+  struct mmsghdr tx_msgs[kPostlist];  ///< sendmmsg() headers for a TX batch
+  struct iovec tx_iovs[kPostlist * 2];  ///< Up to two iovecs per packet
+
+  bool gso_enabled = false;  ///< True iff we're currently sending with GSO
+  uint8_t tx_gso_cmsg[CMSG_SPACE(sizeof(uint16_t))];  ///< UDP_SEGMENT cmsg
+
+  /// True iff we're currently using MSG_ZEROCOPY. Only UDPTransport sets this.
+  bool zc_tx_enabled = false;
+
+  /// True iff we pack small packets into shared datagrams to peers that split
+  /// them. Only UDPTransport, which splits them on receipt, sets this.
+  bool coalesce_enabled = false;
+
+  size_t num_shm_channels = 0;             ///< Number of open channels
+  size_t rx_shm_slots_held = 0;            ///< RX ring entries in channels
+  size_t rx_shm_owner[kNumRxRingEntries];  ///< Channel of each RX ring entry
+
+ private:
+  /// One direction of a shared-memory channel. The producer owns tail, and
+  /// the consumer owns head. Both are free-running packet counts.
+  struct ShmRing {
+    alignas(64) size_t head;
+    alignas(64) size_t tail;
+  };
+
+  /// A mapped shared-memory channel
+  struct ShmChannel {
+    std::string name;
+    std::shared_ptr<uint8_t> loopback_region;  ///< Set iff in-process
+    bool creator;          ///< True iff we created the channel
+    uint8_t* region;       ///< The mapped channel region
+    ShmRing* tx_ring;      ///< Ring for packets that we send
+    ShmRing* rx_ring;      ///< Ring for packets that we receive
+    uint8_t* tx_slots;     ///< kShmRingSlots packet slots of tx_ring
+    uint8_t* rx_slots;     ///< kShmRingSlots packet slots of rx_ring
+    size_t tx_head_cache;  ///< Last seen value of tx_ring->head
+    size_t rx_next;        ///< Next rx_ring packet to give to the RX ring
+    size_t rx_released;    ///< rx_ring packets given back to the sender
+  };
+
+  /// Set up the rings of a channel in \p region, and return its ID
+  size_t add_shm_channel(ShmChannel* c, uint8_t* region, bool create);
+
+  /// (Rpc ID, socket) of the transports bound to a shared datapath port, in
+  /// the order of the sockets in the kernel's SO_REUSEPORT group
+  typedef std::vector<std::pair<uint8_t, int>> reuseport_group_t;
+
+  /**
+   * @brief Make the kernel steer packets to sockets in \p group by their
+   * destination Rpc ID. Packets for unknown Rpc IDs are steered by flow hash.
+   *
+   * @return True on success, false if the kernel rejects the program
+   */
+  static bool attach_steering_prog(const reuseport_group_t& group);
+
+  /// Shared datapath ports in this process, and their SO_REUSEPORT groups
+  static std::unordered_map<uint16_t, reuseport_group_t> reuseport_groups;
+  static std::mutex reuseport_groups_lock;
+
+  std::vector<ShmChannel*> shm_channels;  ///< Indexed by channel ID
 };
 }  // namespace erpc
@@ -3,15 +3,22 @@
 #include <sys/types.h>
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
+#include <linux/filter.h>
 #include <unistd.h>
+#include <algorithm>
 #include <stdexcept>
 
 namespace erpc {
 
 constexpr size_t Transport::kMaxDataPerPkt;
 
+std::unordered_map<uint16_t, Transport::reuseport_group_t> Transport::reuseport_groups;
+std::mutex Transport::reuseport_groups_lock;
+
 Transport::RoutingInfo Transport::make_routing_info(std::string hostname, uint16_t port)
 {
   char port_str[16];
@@ -31,6 +38,7 @@ Transport::RoutingInfo Transport::make_routing_info(std::string hostname, uint16
     throw std::runtime_error(issue_msg);
   }
   RoutingInfo info;
+  memset(&info, 0, sizeof(info));
   memcpy(info.buf, &addrinfo->ai_addrlen, sizeof(addrinfo->ai_addrlen));
   memcpy(info.buf + sizeof(addrinfo->ai_addrlen), addrinfo->ai_addr, addrinfo->ai_addrlen);
   freeaddrinfo(addrinfo);
@@ -39,13 +47,25 @@ Transport::RoutingInfo Transport::make_routing_info(std::string hostname, uint16
 }
 
 Transport::Transport(uint16_t data_udp_port, uint8_t rpc_id, size_t numa_node, FILE* trace_file)
-  : data_udp_port(data_udp_port), rpc_id(rpc_id), numa_node(numa_node), trace_file(trace_file)
+  : data_udp_port(data_udp_port), rpc_id(rpc_id), numa_node(numa_node), host_id(read_host_id()),
+    trace_file(trace_file)
 {
   sock_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP); //AF_INET:IPV4;SOCK_DGRAM:UDP
   if (sock_fd == -1) {
     throw std::runtime_error("Transport: Failed to create local socket.");
   }
 
+  // The kernel adds sockets to a SO_REUSEPORT group in bind order, which we
+  // must record atomically with the bind
+  std::unique_lock<std::mutex> reuseport_lock(reuseport_groups_lock, std::defer_lock);
+  if (kSharedDpathPort) {
+    reuseport_lock.lock();
+    int one = 1;
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) {
+      throw std::runtime_error("Transport: Failed to set SO_REUSEPORT");
+    }
+  }
+
   struct sockaddr_in serveraddr;
   serveraddr.sin_family = AF_INET;
   serveraddr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -56,104 +76,186 @@ Transport::Transport(uint16_t data_udp_port, uint8_t rpc_id, size_t numa_node, F
     throw std::runtime_error("Transport: Failed to bind socket to port " + std::to_string(data_udp_port));
   }
 
+  if (kSharedDpathPort) {
+    reuseport_group_t& group = reuseport_groups[data_udp_port];
+    group.emplace_back(rpc_id, sock_fd);
+    if (!attach_steering_prog(group)) {
+      throw std::runtime_error("Transport: Failed to attach SO_REUSEPORT steering program. errno = " +
+                               std::string(strerror(errno)));
+    }
+    reuseport_lock.unlock();
+  }
+
   int flags = fcntl(sock_fd, F_GETFL, 0);
   int r2 = fcntl(sock_fd, F_SETFL, flags | O_NONBLOCK);
   if (r2 != 0) {
     throw std::runtime_error("Transport: Failed to set O_NONBLOCK");
   }
 
-  send_buf = allocator.allocate(kMaxDataPerPkt + sizeof(pkthdr_t));
-  if (!send_buf) {
-    throw std::runtime_error("Transport: Failed of OOM");
+  if (kUdpGso) {
+    // GSO is requested per message with a cmsg. Setting the socket option
+    // here only checks that the kernel supports it.
+    int gso_size = kMTU, zero = 0;
+    gso_enabled = (setsockopt(sock_fd, SOL_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size)) == 0) &&
+                  (setsockopt(sock_fd, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero)) == 0);
+    if (!gso_enabled) {
+      ERPC_WARN("eRPC Transport: UDP GSO unsupported.\n");
+    }
   }
-
-  ERPC_INFO("eRPC Transport: Created with transport UDP port %u.\n", data_udp_port);
 }
 
-void Transport::init_mem(uint8_t** rx_ring)
+void Transport::init_rx_slab(uint8_t** rx_ring, size_t rx_buf_size, size_t extra_size)
 {
   this->rx_ring = rx_ring;
   this->rx_ring_head = 0;
   this->rx_ring_tail = kNumRxRingEntries - 1;
-  for (size_t i = 0; i < kNumRxRingEntries; i ++) {
-    rx_ring[i] = nullptr;
+  this->rx_buf_size = rx_buf_size;
+
+  // Try hugepages first; a regular mapping is page-aligned too, so every
+  // entry stays cache line-aligned
+  rx_slab_size = round_up<MB(2)>(kNumRxRingEntries * rx_buf_size + extra_size);
+  rx_slab = static_cast<uint8_t*>(mmap(nullptr, rx_slab_size, PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0));
+  if (rx_slab == MAP_FAILED) {
+    ERPC_INFO("eRPC Transport: No hugepages for RX ring. Using regular pages.\n");
+    rx_slab = static_cast<uint8_t*>(mmap(nullptr, rx_slab_size, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0));
+    if (rx_slab == MAP_FAILED) {
+      rx_slab = nullptr;
+      throw std::runtime_error("Transport: Failed to allocate RX ring slab");
+    }
+  }
+
+  for (size_t i = 0; i < kNumRxRingEntries; i++) {
+    rx_ring[i] = &rx_slab[i * rx_buf_size];
+    rx_shm_owner[i] = kInvalidShmChannel;
   }
+
+  memset(tx_msgs, 0, sizeof(tx_msgs));
+
+  // With GSO, the kernel cuts a message into kMTU-sized datagrams
+  memset(tx_gso_cmsg, 0, sizeof(tx_gso_cmsg));
+  struct cmsghdr* cm = reinterpret_cast<struct cmsghdr*>(tx_gso_cmsg);
+  cm->cmsg_level = SOL_UDP;
+  cm->cmsg_type = UDP_SEGMENT;
+  cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+  *reinterpret_cast<uint16_t*>(CMSG_DATA(cm)) = kMTU;
 }
 
 Transport::~Transport()
 {
-  if (sock_fd != -1) close(sock_fd);
-}
+  for (size_t i = 0; i < shm_channels.size(); i++) {
+    if (shm_channels[i] != nullptr) close_shm_channel(i);
+  }
+  if (rx_slab != nullptr) munmap(rx_slab, rx_slab_size);
 
-void Transport::tx_burst(const tx_burst_item_t* tx_burst_arr, size_t num_pkts)
-{
-  for (size_t i = 0; i < num_pkts; i ++) {
-    const tx_burst_item_t &item = tx_burst_arr[i];
-    const MsgBuffer *msg_buffer = item.msg_buffer;
-
-    if (item.pkt_idx == 0) {
-      const pkthdr_t *pkthdr = msg_buffer->get_pkthdr_0();
-      const size_t pkt_size = msg_buffer->get_pkt_size<kMaxDataPerPkt>(0);
-
-      socklen_t ai_addrlen = *reinterpret_cast<const socklen_t*>(item.routing_info->buf);
-      const struct sockaddr *ai_addr = reinterpret_cast<const struct sockaddr *>(item.routing_info->buf + sizeof(ai_addrlen));
-      ssize_t ret = sendto(sock_fd, pkthdr, pkt_size, 0, ai_addr, ai_addrlen);
-      if (ret != static_cast<ssize_t>(pkt_size)) {
-        throw std::runtime_error("sendto() failed. errno = " + std::string(strerror(errno)));
-      }
-    } else {
-      const pkthdr_t *pkthdr = msg_buffer->get_pkthdr_n(item.pkt_idx);
-      const size_t pkt_size = msg_buffer->get_pkt_size<kMaxDataPerPkt>(item.pkt_idx);
-      memcpy(send_buf, pkthdr, sizeof(pkthdr_t));
-      memcpy(send_buf + sizeof(pkthdr_t), &msg_buffer->buf[item.pkt_idx * kMaxDataPerPkt], pkt_size - sizeof(pkthdr_t));
-
-      socklen_t ai_addrlen = *reinterpret_cast<const socklen_t*>(item.routing_info->buf);
-      const struct sockaddr *ai_addr = reinterpret_cast<const struct sockaddr *>(item.routing_info->buf + sizeof(ai_addrlen));
-      ssize_t ret = sendto(sock_fd, send_buf, pkt_size, 0, ai_addr, ai_addrlen);
-      if (ret != static_cast<ssize_t>(pkt_size)) {
-        throw std::runtime_error("sendto() failed. errno = " + std::string(strerror(errno)));
-      }
+  if (!kSharedDpathPort) {
+    close(sock_fd);
+    return;
+  }
+
+  // Closing a socket moves the group's last socket into its place
+  std::lock_guard<std::mutex> reuseport_lock(reuseport_groups_lock);
+  close(sock_fd);
+
+  reuseport_group_t& group = reuseport_groups[data_udp_port];
+  for (size_t i = 0; i < group.size(); i++) {
+    if (group[i].second != sock_fd) continue;
+    group[i] = group.back();
+    group.pop_back();
+    break;
+  }
+
+  if (!group.empty()) {
+    if (!attach_steering_prog(group)) {
+      ERPC_WARN("eRPC Transport: Failed to update SO_REUSEPORT steering.\n");
     }
+  } else {
+    reuseport_groups.erase(data_udp_port);
   }
 }
 
-void Transport::tx_flush()
+bool Transport::attach_steering_prog(const reuseport_group_t& group)
 {
-  // nothing
+  assert(!group.empty());
+
+  // For each group member: if the destination Rpc ID matches, return the
+  // socket's index in the group. Offsets are from the start of the UDP
+  // payload, i.e., the packet header.
+  std::vector<struct sock_filter> insns;
+  insns.push_back(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, kPktHdrDestRpcIdOffset));
+  for (size_t i = 0; i < group.size(); i++) {
+    insns.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, group[i].first, 0, 1));
+    insns.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(i)));
+  }
+  insns.push_back(BPF_STMT(BPF_RET | BPF_K, UINT32_MAX));  // Out of range => hash
+
+  struct sock_fprog prog;
+  prog.len = static_cast<unsigned short>(insns.size());
+  prog.filter = insns.data();
+
+  // The program belongs to the group, so any member socket can attach it
+  return setsockopt(group[0].second, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
 }
 
-size_t Transport::rx_burst()
+size_t Transport::build_tx_msgs(const tx_burst_item_t* tx_burst_arr, size_t num_pkts, bool* zerocopy,
+                                size_t* first_pkt)
 {
-  size_t cnt = 0;
-  while (rx_ring_head != rx_ring_tail) {
-    if (!rx_ring[rx_ring_head]) {
-      rx_ring[rx_ring_head] = allocator.allocate(kMaxDataPerPkt + sizeof(pkthdr_t));
-      if (!rx_ring[rx_ring_head]) {
-        throw std::runtime_error("Transport: Error of OMM");
-      }
-    }
-    ssize_t size = recv(sock_fd, rx_ring[rx_ring_head], kMaxDataPerPkt + sizeof(pkthdr_t), 0);
-    if (size == -1) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        return cnt;
-      } else {
-        throw std::runtime_error("recv() failed. errno = " + std::string(strerror(errno)));
-      }
+  assert(num_pkts <= kPostlist);
+
+  // Build one message per packet, or with GSO, one message per run of
+  // consecutive packets from the same msgbuf. A run's iovecs are contiguous
+  // in tx_iovs, and all but its last packet are full-size. With coalescing,
+  // consecutive small packets to the same Rpc share a message instead.
+  size_t num_segs[kPostlist];    // Number of GSO packets in each message
+  size_t small_bytes[kPostlist];  // Bytes in each message of small packets
+  size_t num_msgs = 0;
+  size_t num_iovs = 0;
+  const tx_burst_item_t* prev = nullptr;  // The last packet added to a message
+
+  for (size_t i = 0; i < num_pkts; i++) {
+    const tx_burst_item_t& item = tx_burst_arr[i];
+    if (kTesting && item.drop) continue;
+
+    const bool zc = use_zerocopy(item);
+    const size_t item_iovs = fill_tx_iov(item, &tx_iovs[num_iovs]);
+    const size_t small_size =
+        kUdpCoalesce && coalesce_enabled && get_dgram_split(item.routing_info) ? coalesce_size(item) : 0;
+    if (small_size > 0) tx_iovs[num_iovs].iov_len = small_size;  // Zeroth packet: one iovec
+
+    if (kUdpGso && gso_enabled && num_msgs > 0 && zerocopy[num_msgs - 1] == zc &&
+        can_coalesce(*prev, item)) {
+      tx_msgs[num_msgs - 1].msg_hdr.msg_iovlen += item_iovs;
+      num_segs[num_msgs - 1]++;
+    } else if (small_size > 0 && num_msgs > 0 && small_bytes[num_msgs - 1] > 0 &&
+               small_bytes[num_msgs - 1] + small_size <= kMTU && same_dest(*prev, item)) {
+      tx_msgs[num_msgs - 1].msg_hdr.msg_iovlen += item_iovs;
+      small_bytes[num_msgs - 1] += small_size;
     } else {
-      cnt ++;
-      rx_ring_head = (rx_ring_head + 1) % kNumRxRingEntries;
+      struct msghdr& hdr = tx_msgs[num_msgs].msg_hdr;
+      hdr.msg_iov = &tx_iovs[num_iovs];
+      hdr.msg_iovlen = item_iovs;
+      set_tx_dest(item, &hdr);
+
+      zerocopy[num_msgs] = zc;
+      first_pkt[num_msgs] = i;
+      num_segs[num_msgs] = 1;
+      small_bytes[num_msgs] = small_size;
+      num_msgs++;
     }
+    num_iovs += item_iovs;
+    prev = &item;
   }
-  return cnt;
-}
 
-void Transport::post_recvs(size_t num_recvs)
-{
-  for (size_t i = 0; i < num_recvs; i++) {
-    rx_ring_tail = (rx_ring_tail + 1) % kNumRxRingEntries;
-    allocator.deallocate(rx_ring[rx_ring_tail], kMaxDataPerPkt + sizeof(pkthdr_t));
-    rx_ring[rx_ring_tail] = nullptr;
+  if (kUdpGso) {
+    for (size_t m = 0; m < num_msgs; m++) {
+      struct msghdr& hdr = tx_msgs[m].msg_hdr;
+      hdr.msg_control = (num_segs[m] > 1) ? tx_gso_cmsg : nullptr;
+      hdr.msg_controllen = (num_segs[m] > 1) ? sizeof(tx_gso_cmsg) : 0;
+    }
   }
+
+  return num_msgs;
 }
 
 }  // namespace erpc
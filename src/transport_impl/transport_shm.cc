@@ -0,0 +1,217 @@
+/**
+ * @file transport_shm.cc
+ * @brief Shared-memory channels for sessions between processes on the same
+ * host, and in-process channels for sessions between Rpcs of one Nexus. Each
+ * channel is a pair of SPSC packet rings in a POSIX shared memory region or
+ * on the heap. Packets keep the UDP wire format, and received packets are
+ * handed to the Rpc in place.
+ */
+#include "transport.h"
+#include "util/logger.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+
+namespace erpc {
+
+// Region layout: client-to-server ring, server-to-client ring, then the
+// packet slots of each ring in the same order
+static constexpr size_t kShmSlotsSize = Transport::kShmRingSlots * Transport::kMTU;
+static constexpr size_t kShmRegionSize = 2 * 128 + 2 * kShmSlotsSize;
+
+size_t Transport::read_host_id()
+{
+  // If this fails, co-located sessions fall back to UDP when the server
+  // can't open the client's channel
+  std::ifstream boot_id_file("/proc/sys/kernel/random/boot_id");
+  std::string boot_id;
+  std::getline(boot_id_file, boot_id);
+  return std::hash<std::string>()(boot_id);
+}
+
+size_t Transport::open_shm_channel(const std::string& name, bool create)
+{
+  static_assert(sizeof(ShmRing) == 128, "");
+  if (num_shm_channels == kMaxShmChannels) return kInvalidShmChannel;
+
+  int fd = create ? shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600)
+                  : shm_open(name.c_str(), O_RDWR, 0);
+  if (fd == -1) {
+    ERPC_INFO("eRPC Transport: Failed to open shm channel %s. errno = %s.\n", name.c_str(), strerror(errno));
+    return kInvalidShmChannel;
+  }
+
+  // A new region is zero-filled, so both rings start empty
+  struct stat st;
+  bool size_ok = create ? (ftruncate(fd, kShmRegionSize) == 0)
+                        : (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == kShmRegionSize);
+
+  void* region = MAP_FAILED;
+  if (size_ok) {
+    // The server opens the channel only if the client is on this host, so
+    // only it pays to populate the region up front
+    int flags = MAP_SHARED | (create ? 0 : MAP_POPULATE);
+    region = mmap(nullptr, kShmRegionSize, PROT_READ | PROT_WRITE, flags, fd, 0);
+  }
+  close(fd);
+
+  // Both ends have the region mapped once the server opens it
+  if (region == MAP_FAILED || !create) shm_unlink(name.c_str());
+  if (region == MAP_FAILED) {
+    ERPC_WARN("eRPC Transport: Failed to map shm channel %s.\n", name.c_str());
+    return kInvalidShmChannel;
+  }
+
+  auto* c = new ShmChannel();
+  c->name = name;
+  return add_shm_channel(c, static_cast<uint8_t*>(region), create);
+}
+
+std::shared_ptr<uint8_t> Transport::alloc_loopback_region()
+{
+  void* region = aligned_alloc(64, kShmRegionSize);
+  rt_assert(region != nullptr, "Failed to allocate loopback channel");
+  memset(region, 0, kShmRegionSize);
+  return std::shared_ptr<uint8_t>(static_cast<uint8_t*>(region), free);
+}
+
+size_t Transport::open_loopback_channel(std::shared_ptr<uint8_t> region, bool create)
+{
+  if (num_shm_channels == kMaxShmChannels) return kInvalidShmChannel;
+
+  auto* c = new ShmChannel();
+  c->name = "loopback";
+  c->loopback_region = std::move(region);
+  return add_shm_channel(c, c->loopback_region.get(), create);
+}
+
+size_t Transport::add_shm_channel(ShmChannel* c, uint8_t* region, bool create)
+{
+  auto* c2s_ring = reinterpret_cast<ShmRing*>(region);
+  auto* s2c_ring = c2s_ring + 1;
+  uint8_t* c2s_slots = region + 2 * sizeof(ShmRing);
+  uint8_t* s2c_slots = c2s_slots + kShmSlotsSize;
+
+  c->creator = create;
+  c->region = region;
+  c->tx_ring = create ? c2s_ring : s2c_ring;
+  c->rx_ring = create ? s2c_ring : c2s_ring;
+  c->tx_slots = create ? c2s_slots : s2c_slots;
+  c->rx_slots = create ? s2c_slots : c2s_slots;
+  c->tx_head_cache = 0;
+  c->rx_next = 0;
+  c->rx_released = 0;
+
+  // Reuse the ID of a closed channel to keep the RX poll loop short
+  size_t chan = static_cast<size_t>(std::find(shm_channels.begin(), shm_channels.end(), nullptr) -
+                                    shm_channels.begin());
+  if (chan == shm_channels.size()) shm_channels.push_back(nullptr);
+  shm_channels[chan] = c;
+  num_shm_channels++;
+
+  ERPC_INFO("eRPC Transport: %s %s channel.\n", create ? "Created" : "Opened", c->name.c_str());
+  return chan;
+}
+
+void Transport::close_shm_channel(size_t chan)
+{
+  ShmChannel* c = shm_channels.at(chan);
+  assert(c != nullptr);
+
+  if (c->loopback_region == nullptr) {
+    munmap(c->region, kShmRegionSize);
+    if (c->creator) shm_unlink(c->name.c_str());  // In case the server never opened it
+  }
+
+  delete c;
+  shm_channels[chan] = nullptr;
+  num_shm_channels--;
+}
+
+size_t Transport::tx_burst_shm(const tx_burst_item_t* tx_burst_arr, size_t num_pkts,
+                               tx_burst_item_t* udp_burst_arr)
+{
+  size_t num_udp = 0;
+
+  for (size_t i = 0; i < num_pkts; i++) {
+    const tx_burst_item_t& item = tx_burst_arr[i];
+    if (kTesting && item.drop) continue;
+
+    const size_t chan = get_shm_channel(item.routing_info);
+    if (chan == kInvalidShmChannel) {
+      udp_burst_arr[num_udp++] = item;
+      continue;
+    }
+
+    ShmChannel* c = shm_channels[chan];
+    const size_t tail = c->tx_ring->tail;  // Only we write the tail
+    if (tail - c->tx_head_cache >= kShmRingSlots) {
+      c->tx_head_cache = __atomic_load_n(&c->tx_ring->head, __ATOMIC_ACQUIRE);
+      if (tail - c->tx_head_cache >= kShmRingSlots) continue;  // Full: drop like a lossy link
+    }
+
+    const MsgBuffer* msg_buffer = item.msg_buffer;
+    const size_t pkt_size = msg_buffer->get_pkt_size<kMaxDataPerPkt>(item.pkt_idx);
+    uint8_t* slot = &c->tx_slots[(tail % kShmRingSlots) * kMTU];
+
+    if (item.pkt_idx == 0) {
+      memcpy(slot, msg_buffer->get_pkthdr_0(), pkt_size);
+    } else {
+      memcpy(slot, msg_buffer->get_pkthdr_n(item.pkt_idx), sizeof(pkthdr_t));
+      memcpy(slot + sizeof(pkthdr_t), &msg_buffer->buf[item.pkt_idx * kMaxDataPerPkt],
+             pkt_size - sizeof(pkthdr_t));
+    }
+
+    __atomic_store_n(&c->tx_ring->tail, tail + 1, __ATOMIC_RELEASE);
+  }
+
+  return num_udp;
+}
+
+size_t Transport::rx_burst_shm(size_t num_reserved)
+{
+  size_t num_free = (rx_ring_tail + kNumRxRingEntries - rx_ring_head) % kNumRxRingEntries;
+  num_free -= std::min(num_free, num_reserved);
+
+  size_t num_rx = 0;
+  for (size_t chan = 0; chan < shm_channels.size() && num_rx < num_free; chan++) {
+    ShmChannel* c = shm_channels[chan];
+    if (c == nullptr) continue;
+
+    const size_t tail = __atomic_load_n(&c->rx_ring->tail, __ATOMIC_ACQUIRE);
+    while (c->rx_next != tail && num_rx < num_free) {
+      rx_ring[rx_ring_head] = &c->rx_slots[(c->rx_next % kShmRingSlots) * kMTU];
+      rx_shm_owner[rx_ring_head] = chan;
+      rx_ring_head = (rx_ring_head + 1) % kNumRxRingEntries;
+      c->rx_next++;
+      num_rx++;
+    }
+  }
+
+  rx_shm_slots_held += num_rx;
+  return num_rx;
+}
+
+void Transport::release_shm_slots(size_t num_recvs)
+{
+  for (size_t i = 1; i <= num_recvs; i++) {
+    const size_t slot = (rx_ring_tail + i) % kNumRxRingEntries;
+    const size_t chan = rx_shm_owner[slot];
+    if (chan == kInvalidShmChannel) continue;
+
+    // A channel's packets enter the RX ring in order, so they leave in order
+    ShmChannel* c = shm_channels[chan];
+    c->rx_released++;
+    __atomic_store_n(&c->rx_ring->head, c->rx_released, __ATOMIC_RELEASE);
+
+    rx_shm_owner[slot] = kInvalidShmChannel;
+    rx_ring[slot] = &rx_slab[slot * rx_buf_size];  // Restore the slab RX buffer
+    rx_shm_slots_held--;
+  }
+}
+
+}  // namespace erpc
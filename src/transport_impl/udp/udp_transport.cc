@@ -0,0 +1,377 @@
+/**
+ * @file udp_transport.cc
+ * @brief The transport that uses socket system calls
+ */
+#include "udp_transport.h"
+#include "util/logger.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace erpc {
+
+constexpr size_t UDPTransport::kRecvmmsgBatch;
+constexpr size_t UDPTransport::kMaxPktsPerDgram;
+
+UDPTransport::UDPTransport(uint16_t data_udp_port, uint8_t rpc_id, size_t numa_node,
+                           FILE* trace_file)
+  : Transport(data_udp_port, rpc_id, numa_node, trace_file)
+{
+  if (kZeroCopyTX) {
+    int one = 1;
+    zc_tx_enabled = (setsockopt(sock_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0);
+    if (!zc_tx_enabled) {
+      ERPC_WARN("eRPC Transport: SO_ZEROCOPY unsupported. Using copying TX.\n");
+    }
+  }
+
+  // GRO merges packets of one flow, which may be for different Rpcs on a
+  // shared datapath port
+  if (kUdpGso && !kSharedDpathPort) {
+    int one = 1;
+    gro_enabled = (setsockopt(sock_fd, SOL_UDP, UDP_GRO, &one, sizeof(one)) == 0);
+    if (!gro_enabled) {
+      ERPC_WARN("eRPC Transport: UDP GRO unsupported.\n");
+    }
+  }
+
+  coalesce_enabled = kUdpCoalesce;
+
+  ERPC_INFO("eRPC Transport: Created UDP transport with port %u.\n", data_udp_port);
+}
+
+void UDPTransport::init_mem(uint8_t** rx_ring)
+{
+  init_rx_slab(rx_ring, kMTU, kGroBounceSize);
+  gro_bounce_buf = &rx_slab[kNumRxRingEntries * kMTU];
+
+  // The recvmmsg() headers and RX ring buffers never change
+  memset(rx_msgs, 0, sizeof(rx_msgs));
+  for (size_t i = 0; i < kNumRxRingEntries; i++) {
+    rx_iovs[i].iov_base = rx_ring[i];
+    rx_iovs[i].iov_len = kMaxDataPerPkt + sizeof(pkthdr_t);
+    rx_msgs[i].msg_hdr.msg_iov = &rx_iovs[i];
+    rx_msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+void UDPTransport::tx_burst(const tx_burst_item_t* tx_burst_arr, size_t num_pkts)
+{
+  tx_burst_item_t udp_burst_arr[kPostlist];  // Packets not sent over shared memory
+  if (num_shm_channels > 0) {
+    num_pkts = tx_burst_shm(tx_burst_arr, num_pkts, udp_burst_arr);
+    if (num_pkts == 0) return;
+    tx_burst_arr = udp_burst_arr;
+  }
+
+  if (zc_tx_sent != zc_tx_completed) reap_zerocopy_completions();
+
+  if (kBatchedSyscalls) {
+    tx_burst_batched(tx_burst_arr, num_pkts);
+    return;
+  }
+
+  for (size_t i = 0; i < num_pkts; i ++) {
+    if (kTesting && tx_burst_arr[i].drop) continue;
+
+    struct msghdr &hdr = tx_msgs[0].msg_hdr;
+    hdr.msg_iov = tx_iovs;
+    hdr.msg_iovlen = fill_tx_iov(tx_burst_arr[i], tx_iovs);
+    set_tx_dest(tx_burst_arr[i], &hdr);
+    const bool zerocopy = use_zerocopy(tx_burst_arr[i]);
+    const int flags = zerocopy ? MSG_ZEROCOPY : 0;
+
+    while (true) {
+      ssize_t ret = zerocopy && inject_zc_enobufs() ? -1 : sendmsg(sock_fd, &hdr, flags);
+      dpath_stat_inc(dpath_stats.syscalls, 1);
+      if (likely(ret != -1)) break;
+      if (errno == ENOBUFS && zerocopy) {
+        reap_zerocopy_completions();  // Out of optmem for pinned pages
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+      throw std::runtime_error("sendmsg() failed. errno = " + std::string(strerror(errno)));
+    }
+
+    if (zerocopy) zc_tx_sent++;
+  }
+}
+
+void UDPTransport::tx_burst_batched(const tx_burst_item_t* tx_burst_arr, size_t num_pkts)
+{
+  bool zerocopy[kPostlist];     // MSG_ZEROCOPY choice for each message
+  size_t first_pkt[kPostlist];  // Index in tx_burst_arr of each message's first packet
+  const size_t num_msgs = build_tx_msgs(tx_burst_arr, num_pkts, zerocopy, first_pkt);
+
+  // sendmmsg() flags apply to every message in the call, so send runs of
+  // messages with the same zero-copy choice separately. sendmmsg() may also
+  // send only a prefix of a run, so retry the rest.
+  size_t num_sent = 0;
+  while (num_sent < num_msgs) {
+    size_t run_end = num_sent + 1;
+    while (run_end < num_msgs && zerocopy[run_end] == zerocopy[num_sent]) run_end++;
+    const int flags = zerocopy[num_sent] ? MSG_ZEROCOPY : 0;
+
+    int ret = zerocopy[num_sent] && inject_zc_enobufs()
+                  ? -1
+                  : sendmmsg(sock_fd, &tx_msgs[num_sent], static_cast<unsigned int>(run_end - num_sent), flags);
+    dpath_stat_inc(dpath_stats.syscalls, 1);
+    if (unlikely(ret == -1)) {
+      if (errno == ENOBUFS && zerocopy[num_sent]) {
+        reap_zerocopy_completions();  // Out of optmem for pinned pages
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+      if (kUdpGso && gso_enabled && (errno == EINVAL || errno == EIO)) {
+        // The path MTU or the NIC can't take kMTU-sized GSO segments
+        ERPC_WARN("eRPC Transport: UDP GSO send failed. Disabling GSO.\n");
+        gso_enabled = false;
+        tx_burst_batched(&tx_burst_arr[first_pkt[num_sent]], num_pkts - first_pkt[num_sent]);
+        return;
+      }
+      throw std::runtime_error("sendmmsg() failed. errno = " + std::string(strerror(errno)));
+    }
+
+    if (zerocopy[num_sent]) zc_tx_sent += static_cast<size_t>(ret);
+    num_sent += static_cast<size_t>(ret);
+  }
+}
+
+void UDPTransport::reap_zerocopy_completions()
+{
+  uint8_t control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+
+  while (true) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t ret = recvmsg(sock_fd, &msg, MSG_ERRQUEUE);
+    dpath_stat_inc(dpath_stats.syscalls, 1);
+    if (ret == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return;
+      throw std::runtime_error("recvmsg(MSG_ERRQUEUE) failed. errno = " + std::string(strerror(errno)));
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (cm->cmsg_level != SOL_IP || cm->cmsg_type != IP_RECVERR) continue;
+
+      const auto *serr = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cm));
+      if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+      // One notification covers the range [ee_info, ee_data] of zero-copy sends
+      zc_tx_completed += (serr->ee_data - serr->ee_info + 1);
+
+      // The kernel had to copy (e.g., for loopback), so pinning only costs us
+      if ((serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && zc_tx_enabled) {
+        ERPC_INFO("eRPC Transport: Zero-copy TX fell back to copying. Disabling it.\n");
+        zc_tx_enabled = false;
+      }
+    }
+  }
+}
+
+void UDPTransport::tx_flush()
+{
+  if (kTesting) testing.tx_flush_count++;
+
+  // Wait until the kernel releases all pages pinned by zero-copy sends
+  while (zc_tx_sent != zc_tx_completed) reap_zerocopy_completions();
+}
+
+size_t UDPTransport::parse_dgram(const uint8_t* dgram, size_t len, size_t* offs)
+{
+  // A datagram whose first packet is part of a multi-packet message is not
+  // coalesced, and neither is a malformed one. The Rpc layer checks it.
+  const auto* pkthdr_0 = reinterpret_cast<const pkthdr_t*>(dgram);
+  if (offs != nullptr) offs[0] = 0;
+  if (len < sizeof(pkthdr_t) || pkthdr_0->msg_size > kMaxDataPerPkt) return 1;
+
+  size_t num_pkts = 1;
+  size_t off = sizeof(pkthdr_t) + pkthdr_0->msg_size;
+  while (off + sizeof(pkthdr_t) <= len) {
+    const auto* pkthdr = reinterpret_cast<const pkthdr_t*>(&dgram[off]);
+    const size_t pkt_size = sizeof(pkthdr_t) + pkthdr->msg_size;
+    if (pkthdr->msg_size > kMaxDataPerPkt || off + pkt_size > len) break;  // Truncated
+
+    if (offs != nullptr) offs[num_pkts] = off;
+    num_pkts++;
+    off += pkt_size;
+  }
+  return num_pkts;
+}
+
+template <class F>
+size_t UDPTransport::split_dgrams(size_t num_dgrams, size_t num_free, F dgram_len)
+{
+  assert(num_dgrams <= kRecvmmsgBatch);
+  size_t num_pkts[kRecvmmsgBatch];
+  size_t total = 0;
+  for (size_t i = 0; i < num_dgrams; i++) {
+    num_pkts[i] = parse_dgram(rx_ring[(rx_ring_head + i) % kNumRxRingEntries], dgram_len(i), nullptr);
+    total += num_pkts[i];
+  }
+  if (likely(total == num_dgrams)) return num_dgrams;  // Nothing to split
+
+  // Packet j of datagram i goes to RX ring entry (before_i + j), where before_i
+  // is the number of packets in earlier datagrams. before_i >= i, so moving
+  // datagrams back to front never overwrites one before it's split.
+  size_t end = total;
+  for (size_t i = num_dgrams; i-- > 0;) {
+    const size_t begin = end - num_pkts[i];
+    end = begin;
+    if (num_pkts[i] == 1 && begin == i) continue;  // Already in place
+
+    const uint8_t* dgram = rx_ring[(rx_ring_head + i) % kNumRxRingEntries];
+    size_t offs[kMaxPktsPerDgram];
+    parse_dgram(dgram, dgram_len(i), offs);
+    for (size_t j = num_pkts[i]; j-- > 0;) {
+      if (begin + j >= num_free) continue;  // No room in the RX ring. Dropped.
+      uint8_t* dst = rx_ring[(rx_ring_head + begin + j) % kNumRxRingEntries];
+      if (dst == &dgram[offs[j]]) continue;
+
+      const auto* pkthdr = reinterpret_cast<const pkthdr_t*>(&dgram[offs[j]]);
+      const size_t pkt_size = std::min(sizeof(pkthdr_t) + pkthdr->msg_size, dgram_len(i) - offs[j]);
+      memcpy(dst, &dgram[offs[j]], pkt_size);
+    }
+  }
+
+  return std::min(total, num_free);
+}
+
+size_t UDPTransport::rx_burst_single()
+{
+  size_t cnt = 0;
+  while (rx_ring_head != rx_ring_tail) {
+    ssize_t size = recv(sock_fd, rx_ring[rx_ring_head], kMaxDataPerPkt + sizeof(pkthdr_t), 0);
+    dpath_stat_inc(dpath_stats.syscalls, 1);
+    if (size == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return cnt;
+      } else {
+        throw std::runtime_error("recv() failed. errno = " + std::string(strerror(errno)));
+      }
+    } else if (kUdpCoalesce) {
+      const size_t num_free = (rx_ring_tail + kNumRxRingEntries - rx_ring_head) % kNumRxRingEntries;
+      const size_t n = split_dgrams(1, num_free, [size](size_t) { return static_cast<size_t>(size); });
+      cnt += n;
+      rx_ring_head = (rx_ring_head + n) % kNumRxRingEntries;
+    } else {
+      cnt ++;
+      rx_ring_head = (rx_ring_head + 1) % kNumRxRingEntries;
+    }
+  }
+  return cnt;
+}
+
+size_t UDPTransport::rx_burst_batched()
+{
+  // recvmmsg() needs contiguous headers, so stop at the end of the ring
+  size_t num_free = (rx_ring_tail + kNumRxRingEntries - rx_ring_head) % kNumRxRingEntries;
+  size_t batch = std::min(num_free, kNumRxRingEntries - rx_ring_head);
+  batch = std::min(batch, kRecvmmsgBatch);
+  if (batch == 0) return 0;
+
+  int ret = recvmmsg(sock_fd, &rx_msgs[rx_ring_head], static_cast<unsigned int>(batch), MSG_DONTWAIT, nullptr);
+  dpath_stat_inc(dpath_stats.syscalls, 1);
+  if (ret == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+    throw std::runtime_error("recvmmsg() failed. errno = " + std::string(strerror(errno)));
+  }
+
+  size_t num_rx = static_cast<size_t>(ret);
+  if (kUdpCoalesce) {
+    const size_t head = rx_ring_head;
+    num_rx = split_dgrams(num_rx, num_free, [this, head](size_t i) { return rx_msgs[head + i].msg_len; });
+  }
+
+  rx_ring_head = (rx_ring_head + num_rx) % kNumRxRingEntries;
+  return num_rx;
+}
+
+size_t UDPTransport::rx_burst_gro()
+{
+  size_t num_rx = 0;
+  while (num_rx < kRecvmmsgBatch) {
+    const size_t num_free = (rx_ring_tail + kNumRxRingEntries - rx_ring_head) % kNumRxRingEntries;
+    if (num_free == 0) break;
+
+    // Receive directly into the free slab slots up to the end of the ring.
+    // Bytes that don't fit there land in the bounce buffer.
+    const size_t num_contig = std::min(num_free, kNumRxRingEntries - rx_ring_head);
+    uint8_t* contig_buf = &rx_slab[rx_ring_head * kMTU];
+    const size_t contig_size = num_contig * kMTU;
+
+    struct iovec iov[2];
+    iov[0].iov_base = contig_buf;
+    iov[0].iov_len = contig_size;
+    iov[1].iov_base = gro_bounce_buf;
+    iov[1].iov_len = kGroBounceSize;
+
+    uint8_t control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t ret = recvmsg(sock_fd, &msg, MSG_DONTWAIT);
+    dpath_stat_inc(dpath_stats.syscalls, 1);
+    if (ret == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) break;
+      throw std::runtime_error("recvmsg() failed. errno = " + std::string(strerror(errno)));
+    }
+
+    // Without a UDP_GRO cmsg, this is a single datagram
+    const size_t rx_bytes = static_cast<size_t>(ret);
+    size_t seg_size = rx_bytes;
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+        seg_size = static_cast<size_t>(*reinterpret_cast<int*>(CMSG_DATA(cm)));
+      }
+    }
+    if (unlikely(seg_size == 0 || seg_size > kMTU)) continue;  // Not an eRPC packet
+
+    // Drop a truncated tail segment, and segments that don't fit in the ring
+    size_t num_segs = (msg.msg_flags & MSG_TRUNC) ? rx_bytes / seg_size : (rx_bytes + seg_size - 1) / seg_size;
+    num_segs = std::min(num_segs, num_free);
+
+    // Move segment i from offset (i * seg_size) to its slot at (i * kMTU).
+    // Going back to front never overwrites a segment before it's moved.
+    for (size_t i = num_segs; i-- > 0;) {
+      const size_t src_off = i * seg_size;
+      const size_t seg_len = std::min(seg_size, rx_bytes - src_off);
+      uint8_t* dst = &rx_slab[((rx_ring_head + i) % kNumRxRingEntries) * kMTU];
+
+      size_t len_in_contig = src_off < contig_size ? std::min(seg_len, contig_size - src_off) : 0;
+      if (len_in_contig > 0 && dst != &contig_buf[src_off]) {
+        memmove(dst, &contig_buf[src_off], len_in_contig);
+      }
+      if (len_in_contig < seg_len) {
+        size_t bounce_off = src_off + len_in_contig - contig_size;
+        memcpy(dst + len_in_contig, &gro_bounce_buf[bounce_off], seg_len - len_in_contig);
+      }
+    }
+
+    if (kUdpCoalesce) {
+      // The kernel merges at most 64 datagrams (UDP_GRO_CNT_MAX)
+      num_segs = std::min(num_segs, kRecvmmsgBatch);
+      num_segs = split_dgrams(num_segs, num_free, [seg_size, rx_bytes](size_t i) {
+        return std::min(seg_size, rx_bytes - i * seg_size);
+      });
+    }
+
+    rx_ring_head = (rx_ring_head + num_segs) % kNumRxRingEntries;
+    num_rx += num_segs;
+  }
+
+  return num_rx;
+}
+
+}  // namespace erpc
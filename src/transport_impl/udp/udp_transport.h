@@ -0,0 +1,142 @@
+/**
+ * @file udp_transport.h
+ * @brief Transport that moves packets with non-blocking socket system calls
+ */
+#pragma once
+
+#include "transport.h"
+
+namespace erpc {
+
+class UDPTransport : public Transport {
+ public:
+  /// Maximum number of packets received by one recvmmsg() call
+  static constexpr size_t kRecvmmsgBatch = 64;
+
+  /// Size of the buffer for GRO-coalesced bytes that wrap around the RX ring
+  static constexpr size_t kGroBounceSize = KB(64);
+
+  /**
+   * @brief Create the transport's socket and probe optional kernel features
+   *
+   * @param rpc_id The RPC ID of the parent RPC
+   *
+   * @throw runtime_error if creation fails
+   */
+  UDPTransport(uint16_t data_udp_port, uint8_t rpc_id, size_t numa_node, FILE* trace_file);
+
+  /// Initialize the RX ring and the recvmmsg() headers
+  void init_mem(uint8_t** rx_ring);
+
+  /**
+   * @brief Transmit a batch of packets
+   *
+   * Multiple packets may belong to the same msgbuf; burst items contain
+   * offsets into a msgbuf.
+   *
+   * @param tx_burst_arr Info about the packets to TX
+   * @param num_pkts The total number of packets to transmit (<= \p kPostlist)
+   */
+  void tx_burst(const tx_burst_item_t* tx_burst_arr, size_t num_pkts);
+
+  /// Complete pending TX DMAs, returning ownership of all TX buffers to eRPC
+  void tx_flush();
+
+  /**
+   * @brief The generic packet RX function
+   *
+   * @return the number of new packets available in the RX ring. The Rpc layer
+   * controls posting of RECVs explicitly using post_recvs().
+   */
+  inline size_t rx_burst() {
+    size_t num_rx;
+    if (kUdpGso && gro_enabled) {
+      num_rx = rx_burst_gro();
+    } else if (kBatchedSyscalls) {
+      num_rx = rx_burst_batched();
+    } else {
+      num_rx = rx_burst_single();
+    }
+
+    if (num_shm_channels > 0) num_rx += rx_burst_shm(0);
+    return num_rx;
+  }
+
+  /**
+   * @brief Post RECVs to the receive queue
+   *
+   * @param num_recvs The zero or more RECVs to post
+   */
+  inline void post_recvs(size_t num_recvs) {
+    if (rx_shm_slots_held > 0) release_shm_slots(num_recvs);
+
+    // RX ring buffers are recycled in place, so only the free slot count
+    // changes
+    rx_ring_tail = (rx_ring_tail + num_recvs) % kNumRxRingEntries;
+  }
+
+ private:
+  /// Transmit a batch of packets with one sendmmsg() call
+  void tx_burst_batched(const tx_burst_item_t* tx_burst_arr, size_t num_pkts);
+
+  /// Receive a batch of packets with one recvmmsg() call
+  size_t rx_burst_batched();
+
+  /// Receive packets coalesced by UDP GRO and split them into RX ring entries
+  size_t rx_burst_gro();
+
+  /// Receive packets one recv() call at a time
+  size_t rx_burst_single();
+
+  /// Consume zero-copy completion notifications from the socket's error queue
+  void reap_zerocopy_completions();
+
+  /// With kTesting, fail the next testing.zc_enobufs zero-copy sends with
+  /// ENOBUFS, as if the kernel were out of memory for pinning pages
+  inline bool inject_zc_enobufs() {
+    if (!kTesting || testing.zc_enobufs == 0) return false;
+    testing.zc_enobufs--;
+    errno = ENOBUFS;
+    return true;
+  }
+
+  /**
+   * @brief Return the number of packets in a received datagram, and store
+   * their offsets in \p offs. A datagram holds more than one packet only if
+   * the sender coalesced small packets.
+   *
+   * @param offs Output: room for kMaxPktsPerDgram offsets, or nullptr
+   */
+  static size_t parse_dgram(const uint8_t* dgram, size_t len, size_t* offs);
+
+  /**
+   * @brief Split the datagrams just received in the RX ring into one RX ring
+   * entry per packet
+   *
+   * @param num_dgrams The number of datagrams, at RX ring entries from
+   * rx_ring_head on. At most kRecvmmsgBatch.
+   * @param num_free The number of free RX ring entries from rx_ring_head on.
+   * Packets that don't fit are dropped.
+   * @param dgram_len A function that returns the length of the i-th datagram
+   *
+   * @return The number of RX ring entries used
+   */
+  template <class F>
+  size_t split_dgrams(size_t num_dgrams, size_t num_free, F dgram_len);
+
+  /// Upper bound on the number of packets in a coalesced datagram
+  static constexpr size_t kMaxPktsPerDgram = kMTU / sizeof(pkthdr_t);
+
+  bool gro_enabled = false;  ///< True iff the kernel may coalesce RX packets
+  uint8_t* gro_bounce_buf = nullptr;  ///< GRO bytes past the end of the ring
+
+  size_t zc_tx_sent = 0;       ///< Number of MSG_ZEROCOPY sends issued
+  size_t zc_tx_completed = 0;  ///< Number of MSG_ZEROCOPY sends completed
+
+  /// recvmmsg() headers, one per RX ring entry. Each header's iovec points to
+  /// the buffer of its RX ring entry.
+  struct mmsghdr rx_msgs[kNumRxRingEntries];
+  struct iovec rx_iovs[kNumRxRingEntries];
+};
+
+}  // namespace erpc
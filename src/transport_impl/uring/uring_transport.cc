@@ -0,0 +1,242 @@
+/**
+ * @file uring_transport.cc
+ * @brief The io_uring transport. Packets are received by one multishot
+ * recvmsg request into RX slab buffers handed to the kernel via a provided
+ * buffer ring, so an idle event loop makes no system calls.
+ */
+#include "uring_transport.h"
+#include "util/io_uring.h"
+#include "util/logger.h"
+#include <sys/mman.h>
+#include <stdexcept>
+
+namespace erpc {
+
+static constexpr uint16_t kUringBufGroup = 0;          ///< Provided buffer group ID
+static constexpr uint64_t kUringRecvTag = UINT64_MAX;  ///< user_data of the recv request
+
+URingTransport::URingTransport(uint16_t data_udp_port, uint8_t rpc_id, size_t numa_node,
+                               FILE* trace_file)
+  : Transport(data_udp_port, rpc_id, numa_node, trace_file)
+{
+  // Sends complete inside tx_burst(), so zero-copy TX would only add
+  // notification overhead. GRO datagrams don't fit in fixed-size provided
+  // buffers.
+  ERPC_INFO("eRPC Transport: Created io_uring transport with port %u.\n", data_udp_port);
+}
+
+URingTransport::~URingTransport()
+{
+  delete uring;  // Cancels the multishot recv before the base unmaps its buffers
+  if (buf_ring != nullptr) munmap(buf_ring, buf_ring_size);
+}
+
+void URingTransport::init_mem(uint8_t** rx_ring)
+{
+  init_rx_slab(rx_ring, kRxBufSize, 0);
+
+  // One SQE per message in a TX batch, plus one for the multishot recv. The
+  // CQ can hold a completion for every provided buffer, plus sends.
+  uring = new IoUring(kPostlist + 1, 2 * kNumRxRingEntries);
+
+  buf_ring_size = round_up<KB(4)>(kNumRxRingEntries * sizeof(struct io_uring_buf));
+  void* ring = mmap(nullptr, buf_ring_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (ring == MAP_FAILED) {
+    throw std::runtime_error("Transport: Failed to allocate io_uring buffer ring");
+  }
+  buf_ring = static_cast<struct io_uring_buf_ring*>(ring);
+  uring->register_buf_ring(buf_ring, kNumRxRingEntries, kUringBufGroup);
+
+  // Every packet that the kernel receives must have room in the RX ring, so
+  // the kernel owns at most this many free RX ring entries at any time. The
+  // rest are left for shared-memory channels.
+  for (size_t i = 0; i < kNumRxRingEntries / 2; i++) {
+    provide_buf(static_cast<uint16_t>(i));
+  }
+  __atomic_store_n(&buf_ring->tail, buf_ring_tail, __ATOMIC_RELEASE);
+
+  memset(&recv_msghdr, 0, sizeof(recv_msghdr));  // No address or cmsgs
+  arm_recv();
+  uring->submit();
+}
+
+void URingTransport::provide_buf(uint16_t bid)
+{
+  // The ring's entries start at its base, overlapping the tail. Don't use
+  // buf_ring->bufs: in C++, its flexible array member is shifted.
+  struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(buf_ring) +
+                             (buf_ring_tail & (kNumRxRingEntries - 1));
+  buf->addr = reinterpret_cast<uint64_t>(&rx_slab[bid * kRxBufSize]);
+  buf->len = kRxBufSize;
+  buf->bid = bid;
+
+  buf_ring_tail++;
+  uring_bufs_avail++;
+}
+
+void URingTransport::arm_recv()
+{
+  struct io_uring_sqe* sqe = uring->get_sqe();
+  assert(sqe != nullptr);
+
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = sock_fd;
+  sqe->addr = reinterpret_cast<uint64_t>(&recv_msghdr);
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kUringBufGroup;
+  sqe->user_data = kUringRecvTag;
+
+  recv_armed = true;
+}
+
+void URingTransport::reap_cqes()
+{
+  bool bufs_returned = false;
+
+  for (struct io_uring_cqe* cqe = uring->peek_cqe(); cqe != nullptr; cqe = uring->peek_cqe()) {
+    if (cqe->user_data != kUringRecvTag) {
+      tx_res[cqe->user_data] = cqe->res;
+      tx_pending--;
+      uring->cqe_seen();
+      continue;
+    }
+
+    // The multishot recv stops when it runs out of buffers
+    if (!(cqe->flags & IORING_CQE_F_MORE)) recv_armed = false;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+      const uint16_t bid = static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+      uint8_t* buf = &rx_slab[bid * kRxBufSize];
+      const auto* out = reinterpret_cast<const struct io_uring_recvmsg_out*>(buf);
+      uring_bufs_avail--;
+
+      if (likely(cqe->res > static_cast<int>(sizeof(*out)) && !(out->flags & MSG_TRUNC))) {
+        // The packet follows the header since we reserve no address or cmsg space
+        rx_ring[rx_ring_head] = buf + sizeof(*out);
+        rx_bids[rx_ring_head] = bid;
+        rx_ring_head = (rx_ring_head + 1) % kNumRxRingEntries;
+        rx_new++;
+      } else {
+        provide_buf(bid);  // Drop the packet
+        bufs_returned = true;
+      }
+    } else if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+      throw std::runtime_error("io_uring recvmsg failed. errno = " + std::string(strerror(-cqe->res)));
+    }
+
+    uring->cqe_seen();
+  }
+
+  if (bufs_returned) __atomic_store_n(&buf_ring->tail, buf_ring_tail, __ATOMIC_RELEASE);
+}
+
+void URingTransport::tx_burst(const tx_burst_item_t* tx_burst_arr, size_t num_pkts)
+{
+  tx_burst_item_t udp_burst_arr[kPostlist];  // Packets not sent over shared memory
+  if (num_shm_channels > 0) {
+    num_pkts = tx_burst_shm(tx_burst_arr, num_pkts, udp_burst_arr);
+    if (num_pkts == 0) return;
+    tx_burst_arr = udp_burst_arr;
+  }
+
+  tx_burst_uring(tx_burst_arr, num_pkts);
+}
+
+void URingTransport::tx_burst_uring(const tx_burst_item_t* tx_burst_arr, size_t num_pkts)
+{
+  tx_burst_item_t retry_arr[kPostlist];  // Packets of failed messages
+
+  // Resend the packets of failed messages in a loop until all are sent, like
+  // UDPTransport::tx_burst_batched(). A socket buffer that stays full must not
+  // grow the stack.
+  while (num_pkts > 0) {
+    bool zerocopy[kPostlist];         // Always false: zero-copy is socket-only
+    size_t first_pkt[kPostlist + 1];  // Index in tx_burst_arr of each message's first packet
+    const size_t num_msgs = build_tx_msgs(tx_burst_arr, num_pkts, zerocopy, first_pkt);
+    first_pkt[num_msgs] = num_pkts;
+
+    for (size_t m = 0; m < num_msgs; m++) {
+      struct io_uring_sqe* sqe = uring->get_sqe();
+      assert(sqe != nullptr);
+
+      sqe->opcode = IORING_OP_SENDMSG;
+      sqe->fd = sock_fd;
+      sqe->addr = reinterpret_cast<uint64_t>(&tx_msgs[m].msg_hdr);
+      sqe->len = 1;
+      sqe->user_data = m;
+    }
+    tx_pending = num_msgs;
+
+    // UDP sends usually complete inline, so one system call submits the batch
+    // and collects its completions. The kernel copies the msghdrs at submit.
+    uring->submit();
+    dpath_stat_inc(dpath_stats.syscalls, 1);
+    reap_cqes();
+    while (tx_pending > 0) {
+      uring->submit(1);
+      dpath_stat_inc(dpath_stats.syscalls, 1);
+      reap_cqes();
+    }
+
+    // Gather the packets of failed messages. They only move to lower indices,
+    // so this can compact retry_arr in place.
+    size_t num_retry = 0;
+    for (size_t m = 0; m < num_msgs; m++) {
+      if (likely(tx_res[m] >= 0)) continue;
+
+      const int err = -tx_res[m];
+      if (kUdpGso && gso_enabled && (err == EINVAL || err == EIO)) {
+        // The path MTU or the NIC can't take kMTU-sized GSO segments
+        ERPC_WARN("eRPC Transport: UDP GSO send failed. Disabling GSO.\n");
+        gso_enabled = false;
+      } else if (err != EAGAIN && err != ENOBUFS && err != EINTR) {
+        throw std::runtime_error("io_uring sendmsg failed. errno = " + std::string(strerror(err)));
+      }
+
+      for (size_t i = first_pkt[m]; i < first_pkt[m + 1]; i++) {
+        retry_arr[num_retry++] = tx_burst_arr[i];
+      }
+    }
+
+    tx_burst_arr = retry_arr;
+    num_pkts = num_retry;
+  }
+}
+
+size_t URingTransport::rx_burst_uring()
+{
+  if (!recv_armed && uring_bufs_avail > 0) {
+    // Restart the multishot recv after it ran out of buffers
+    arm_recv();
+    uring->submit();
+    dpath_stat_inc(dpath_stats.syscalls, 1);
+  } else if (uring->taskrun_pending()) {
+    // Let the kernel post completions that it deferred until we enter it
+    uring->submit();
+    dpath_stat_inc(dpath_stats.syscalls, 1);
+  }
+
+  reap_cqes();
+
+  size_t num_new = rx_new;
+  rx_new = 0;
+  return num_new;
+}
+
+void URingTransport::post_recvs(size_t num_recvs)
+{
+  for (size_t i = 1; i <= num_recvs; i++) {
+    const size_t slot = (rx_ring_tail + i) % kNumRxRingEntries;
+    if (rx_shm_owner[slot] != kInvalidShmChannel) continue;  // Not a kernel buffer
+    provide_buf(rx_bids[slot]);
+  }
+  __atomic_store_n(&buf_ring->tail, buf_ring_tail, __ATOMIC_RELEASE);
+
+  if (rx_shm_slots_held > 0) release_shm_slots(num_recvs);
+  rx_ring_tail = (rx_ring_tail + num_recvs) % kNumRxRingEntries;
+}
+
+}  // namespace erpc
@@ -0,0 +1,98 @@
+/**
+ * @file uring_transport.h
+ * @brief Transport that moves packets with io_uring
+ */
+#pragma once
+
+#include <linux/io_uring.h>
+#include "transport.h"
+
+namespace erpc {
+
+class IoUring;
+
+class URingTransport : public Transport {
+ public:
+  /// Stride of RX buffers. Multishot recvmsg puts a 16-byte
+  /// io_uring_recvmsg_out header before each packet.
+  static constexpr size_t kRxBufSize = kMTU + 64;
+
+  /**
+   * @brief Create the transport's socket
+   *
+   * @param rpc_id The RPC ID of the parent RPC
+   *
+   * @throw runtime_error if creation fails
+   */
+  URingTransport(uint16_t data_udp_port, uint8_t rpc_id, size_t numa_node, FILE* trace_file);
+
+  ~URingTransport();
+
+  /**
+   * @brief Initialize the RX ring, set up the io_uring instance, and start
+   * receiving into RX ring buffers
+   *
+   * @throw runtime_error if the kernel does not support io_uring
+   */
+  void init_mem(uint8_t** rx_ring);
+
+  /// Transmit a batch of packets with one io_uring submission
+  void tx_burst(const tx_burst_item_t* tx_burst_arr, size_t num_pkts);
+
+  /// Sends complete inside tx_burst(), so there is nothing to wait for
+  inline void tx_flush() {
+    if (kTesting) testing.tx_flush_count++;
+  }
+
+  /**
+   * @brief The generic packet RX function
+   *
+   * @return the number of new packets available in the RX ring. The Rpc layer
+   * controls posting of RECVs explicitly using post_recvs().
+   */
+  inline size_t rx_burst() {
+    size_t num_rx = rx_burst_uring();
+
+    // Don't use RX ring entries that we have promised to the kernel
+    if (num_shm_channels > 0) num_rx += rx_burst_shm(uring_bufs_avail);
+    return num_rx;
+  }
+
+  /**
+   * @brief Post RECVs to the receive queue
+   *
+   * @param num_recvs The zero or more RECVs to post
+   */
+  void post_recvs(size_t num_recvs);
+
+ private:
+  /// Transmit a batch of packets, and resend failed messages
+  void tx_burst_uring(const tx_burst_item_t* tx_burst_arr, size_t num_pkts);
+
+  /// Collect packets received by the multishot recvmsg
+  size_t rx_burst_uring();
+
+  /// Arm the multishot recvmsg request. This does not submit it.
+  void arm_recv();
+
+  /// Give an RX slab buffer back to the kernel. This does not publish it.
+  void provide_buf(uint16_t bid);
+
+  /// Process all io_uring completions. Received packets go to the RX ring,
+  /// and send results go to tx_res.
+  void reap_cqes();
+
+  IoUring* uring = nullptr;
+  struct io_uring_buf_ring* buf_ring = nullptr;  ///< Provided RX buffers
+  size_t buf_ring_size = 0;
+  uint16_t buf_ring_tail = 0;  ///< Tail including unpublished buffers
+  size_t uring_bufs_avail = 0;       ///< Buffers the kernel can receive into
+  bool recv_armed = false;     ///< True iff the multishot recv is active
+  size_t rx_new = 0;           ///< Packets added to the RX ring, not yet returned
+  struct msghdr recv_msghdr;   ///< Template for multishot recvmsg
+  uint16_t rx_bids[kNumRxRingEntries];  ///< Buffer ID for each RX ring entry
+  int tx_res[kPostlist];       ///< Send results for the current TX batch
+  size_t tx_pending = 0;       ///< Sends in the current TX batch not yet completed
+};
+
+}  // namespace erpc
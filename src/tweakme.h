@@ -9,9 +9,29 @@
 
 namespace erpc {
 
-/// Packet loss timeout for an RPC request in microseconds
+/// Initial and largest packet loss timeout for an RPC request in
+/// microseconds. Each session adapts its timeout to measured RTTs.
 static constexpr size_t kRpcRTOUs = 5000;
 
+/// Smallest adaptive packet loss timeout in microseconds
+static constexpr size_t kRpcMinRTOUs = 100;
+
+/// Retransmit an unanswered packet without waiting for the timeout once a
+/// packet this many positions later has been answered
+static constexpr size_t kFastRetxThresh = 3;
+
+/// Packets that a request may send per turn of its session's deficit round
+/// robin TX scheduler, when requests of the session wait for credits
+static constexpr size_t kTxQuantumPkts = 4;
+
+/// The server answers up to this many packets of a multi-packet request with
+/// one explicit credit return. 1 sends one credit return per packet.
+static constexpr size_t kCrBatchPkts = 16;
+
+/// Longest time in microseconds that the server delays a credit return after
+/// receiving the packet that it answers, to answer more packets with it
+static constexpr size_t kCrDelayUs = 50;
+
 // Congestion control
 static constexpr bool kEnableCc = true;
 static constexpr bool kEnableCcOpts = true;
@@ -37,5 +57,46 @@ static_assert(kCcRTT || !kCcRateComp, "");  // Rate comp => RTT measurement
 /// of the request handler.
 static constexpr bool kZeroCopyRX = true;
 
+/// Transmit a TX batch with one sendmmsg() and receive an RX batch with one
+/// recvmmsg(), instead of one sendto() or recv() system call per packet
+static constexpr bool kBatchedSyscalls = true;
+
+/// Send full-size data packets with MSG_ZEROCOPY if the kernel supports it.
+/// This pins MsgBuffer pages until the kernel reports completion, which
+/// tx_flush() waits for. Pinning costs more than copying a single packet on
+/// many kernels, so this is disabled by default.
+static constexpr bool kZeroCopyTX = false;
+
+/// Send a run of consecutive full-size packets from one msgbuf as a single
+/// UDP GSO datagram, and receive with UDP GRO. This cuts per-packet kernel
+/// stack traversals for large messages.
+static constexpr bool kUdpGso = false;
+static_assert(kBatchedSyscalls || !kUdpGso, "");  // GSO => sendmmsg() path
+
+/// Pack consecutive single-packet messages to the same Rpc in a TX batch into
+/// one UDP datagram of up to kMTU bytes, and split such datagrams into RX ring
+/// entries on receipt. This cuts per-datagram kernel work for small RPCs. The
+/// TX batch is flushed every event loop iteration, so this adds no delay.
+/// Packets are coalesced only to Rpcs whose connect handshake said that they
+/// split datagrams, so this is safe with io_uring Rpcs as peers.
+static constexpr bool kUdpCoalesce = true;
+static_assert(kBatchedSyscalls || !kUdpCoalesce, "");  // Needs sendmmsg() path
+
+/// Exchange the datapath packets of sessions between processes on the same
+/// host through shared memory instead of UDP. The server unlinks a channel's
+/// /dev/shm region when it opens it, so a client that crashes before then
+/// leaks the region. This is disabled by default for that reason.
+static constexpr bool kShmChannels = false;
+
+/// Exchange the datapath packets of sessions between Rpcs of the same Nexus
+/// through in-process rings instead of UDP. The rings are on the heap, so
+/// nothing outlives the process.
+static constexpr bool kLoopbackChannels = true;
+
+/// Bind the datapath sockets of all Rpcs in a process to one UDP port with
+/// SO_REUSEPORT. The kernel steers each packet to its destination Rpc's socket
+/// with a classic BPF program that reads pkthdr_t::dest_rpc_id.
+static constexpr bool kSharedDpathPort = false;
+
 static constexpr bool kDatapathStats = false;
 }  // namespace erpc
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace erpc {
+
+/// Minimal single-issuer io_uring built directly on the io_uring system calls
+class IoUring {
+ public:
+  /**
+   * @brief Create an io_uring instance and map its rings
+   * @throw runtime_error if the kernel does not support io_uring
+   */
+  IoUring(unsigned sq_entries, unsigned cq_entries) {
+    // Ask the kernel to only run completion work when we enter it, and to
+    // tell us via IORING_SQ_TASKRUN when such work is pending. Older
+    // kernels reject these flags, so fall back to the defaults.
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER |
+              IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+    p.cq_entries = cq_entries;
+    ring_fd = sys_io_uring_setup(sq_entries, &p);
+    if (ring_fd < 0 && errno == EINVAL) {
+      memset(&p, 0, sizeof(p));
+      p.flags = IORING_SETUP_CQSIZE;
+      p.cq_entries = cq_entries;
+      ring_fd = sys_io_uring_setup(sq_entries, &p);
+    }
+    if (ring_fd < 0) {
+      throw std::runtime_error("IoUring: io_uring_setup() failed. errno = " +
+                               std::string(strerror(errno)));
+    }
+
+    sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+    sq_ring = map(sq_ring_size, IORING_OFF_SQ_RING);
+    cq_ring = single_mmap ? sq_ring : map(cq_ring_size, IORING_OFF_CQ_RING);
+    sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = static_cast<struct io_uring_sqe *>(map(sqes_size, IORING_OFF_SQES));
+
+    sq_head = ring_ptr<unsigned>(sq_ring, p.sq_off.head);
+    sq_tail = ring_ptr<unsigned>(sq_ring, p.sq_off.tail);
+    sq_flags = ring_ptr<unsigned>(sq_ring, p.sq_off.flags);
+    sq_mask = *ring_ptr<unsigned>(sq_ring, p.sq_off.ring_mask);
+    this->sq_entries = p.sq_entries;
+
+    cq_head = ring_ptr<unsigned>(cq_ring, p.cq_off.head);
+    cq_tail = ring_ptr<unsigned>(cq_ring, p.cq_off.tail);
+    cq_mask = *ring_ptr<unsigned>(cq_ring, p.cq_off.ring_mask);
+    cqes = ring_ptr<struct io_uring_cqe>(cq_ring, p.cq_off.cqes);
+
+    // SQ array entry i always points to SQE i
+    unsigned *sq_array = ring_ptr<unsigned>(sq_ring, p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; i++) sq_array[i] = i;
+    sqe_tail = *sq_tail;
+  }
+
+  IoUring(const IoUring &) = delete;
+
+  ~IoUring() {
+    if (sqes != nullptr) munmap(sqes, sqes_size);
+    if (cq_ring != nullptr && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+    if (sq_ring != nullptr) munmap(sq_ring, sq_ring_size);
+    if (ring_fd >= 0) close(ring_fd);
+  }
+
+  /// Return a zeroed SQE to fill in, or nullptr if the SQ is full
+  inline struct io_uring_sqe *get_sqe() {
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sqe_tail - head >= sq_entries) return nullptr;
+
+    struct io_uring_sqe *sqe = &sqes[sqe_tail & sq_mask];
+    sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+  }
+
+  /**
+   * @brief Submit all SQEs returned by get_sqe() since the last call, and
+   * optionally wait for completions
+   *
+   * @return The number of SQEs submitted. Throws on error.
+   */
+  inline unsigned submit(unsigned wait_nr = 0) {
+    unsigned to_submit = sqe_tail - *sq_tail;
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = (wait_nr > 0 || taskrun_pending()) ? IORING_ENTER_GETEVENTS : 0;
+    int ret = enter(to_submit, wait_nr, flags);
+    if (ret < 0) {
+      throw std::runtime_error("IoUring: io_uring_enter() failed. errno = " +
+                               std::string(strerror(errno)));
+    }
+    return static_cast<unsigned>(ret);
+  }
+
+  /// Return true iff the kernel has completion work that it will only run
+  /// when we enter it
+  inline bool taskrun_pending() const {
+    return (__atomic_load_n(sq_flags, __ATOMIC_RELAXED) & IORING_SQ_TASKRUN) != 0;
+  }
+
+  /// Return the oldest unseen CQE, or nullptr if the CQ is empty
+  inline struct io_uring_cqe *peek_cqe() const {
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return nullptr;
+    return &cqes[head & cq_mask];
+  }
+
+  /// Release the CQE returned by peek_cqe() back to the kernel
+  inline void cqe_seen() {
+    __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+  }
+
+  /**
+   * @brief Register a ring of provided buffers for IOSQE_BUFFER_SELECT
+   * @throw runtime_error if registration fails
+   */
+  void register_buf_ring(struct io_uring_buf_ring *buf_ring, unsigned entries,
+                         uint16_t bgid) {
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+    reg.ring_entries = entries;
+    reg.bgid = bgid;
+
+    long ret = syscall(__NR_io_uring_register, ring_fd,
+                       IORING_REGISTER_PBUF_RING, &reg, 1);
+    if (ret != 0) {
+      throw std::runtime_error("IoUring: Failed to register buffer ring. errno = " +
+                               std::string(strerror(errno)));
+    }
+  }
+
+ private:
+  static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+  }
+
+  int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+  }
+
+  void *map(size_t size, off_t offset) {
+    void *ret = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+    if (ret == MAP_FAILED) {
+      throw std::runtime_error("IoUring: Failed to map rings. errno = " +
+                               std::string(strerror(errno)));
+    }
+    return ret;
+  }
+
+  template <typename T>
+  static T *ring_ptr(void *ring, uint32_t offset) {
+    return reinterpret_cast<T *>(static_cast<uint8_t *>(ring) + offset);
+  }
+
+  int ring_fd = -1;
+  void *sq_ring = nullptr, *cq_ring = nullptr;
+  size_t sq_ring_size = 0, cq_ring_size = 0, sqes_size = 0;
+  struct io_uring_sqe *sqes = nullptr;
+
+  unsigned *sq_head, *sq_tail, *sq_flags;
+  unsigned sq_mask, sq_entries;
+  unsigned sqe_tail;  ///< Tail including SQEs not yet submitted
+
+  unsigned *cq_head, *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+};
+
+}  // namespace erpc
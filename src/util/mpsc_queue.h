@@ -0,0 +1,139 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "common.h"
+#include "util/barrier.h"
+
+namespace erpc {
+
+/**
+ * @brief A bounded lock-free multi-producer single-consumer queue
+ *
+ * This is Vyukov's bounded queue, specialized for one consumer. Producers
+ * claim a slot by advancing the tail with a CAS, and publish it by writing the
+ * slot's sequence number. The consumer owns the head, so popping needs no
+ * atomic read-modify-write, and the consumer never reads the tail.
+ *
+ * @tparam T The type of elements stored in the queue
+ * @tparam N The capacity of the queue, a power of two
+ */
+template <typename T, size_t N>
+class MpscQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "Capacity must be a power of 2");
+
+  /// Failed pushes that push() spins for before it starts yielding
+  static constexpr size_t kPushSpins = 64;
+
+  /// A queue slot. seq is i if the slot is free for the element at position
+  /// i, and (i + 1) if the slot holds that element.
+  struct Slot {
+    std::atomic<size_t> seq;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+    T *elem() { return reinterpret_cast<T *>(&storage); }
+  };
+
+ public:
+  MpscQueue() : slots(new Slot[N]), tail(0), head(0) {
+    for (size_t i = 0; i < N; i++) {
+      slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~MpscQueue() {
+    while (!empty()) pop();
+    delete[] slots;
+  }
+
+  /// Add an element to the queue. Return false iff the queue is full.
+  bool try_push(const T &t) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &slots[pos % N];
+      const size_t seq = slot->seq.load(std::memory_order_acquire);
+      const auto diff = static_cast<intptr_t>(seq - pos);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;  // The slot still holds the element at (pos - N)
+      } else {
+        pos = tail.load(std::memory_order_relaxed);  // Lost a race, retry
+      }
+    }
+
+    new (slot->elem()) T(t);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Add an element to the queue, waiting while the queue is full. After a
+  /// short spin, this yields the core in case it is shared with the consumer.
+  void push(const T &t) {
+    for (size_t i = 0; !try_push(t); i++) {
+      if (i < kPushSpins) {
+        pause();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  /// Return true iff no element is ready to pop. Only for the consumer.
+  bool empty() const {
+    return slots[head % N].seq.load(std::memory_order_acquire) != head + 1;
+  }
+
+  /// Remove and return the first element of a non-empty queue. Only for the
+  /// consumer.
+  T pop() {
+    assert(!empty());
+    Slot &slot = slots[head % N];
+    T ret(std::move(*slot.elem()));
+    release(slot);
+    return ret;
+  }
+
+  /// Move up to \p max_n elements from the front of the queue into \p out.
+  /// Return the number of elements moved. Only for the consumer.
+  size_t pop_batch(T *out, size_t max_n) {
+    size_t n = 0;
+    for (; n < max_n && !empty(); n++) {
+      Slot &slot = slots[head % N];
+      out[n] = std::move(*slot.elem());
+      release(slot);
+    }
+    return n;
+  }
+
+ private:
+  /// Free the slot at the head for the producer of position (head + N)
+  void release(Slot &slot) {
+    slot.elem()->~T();
+    slot.seq.store(head + N, std::memory_order_release);
+    head++;
+  }
+
+  Slot *const slots;
+
+  // Producers write the tail and the consumer writes the head, so they live
+  // on separate cache lines
+  uint8_t pad_0[kCacheLineSize];
+  std::atomic<size_t> tail;
+  uint8_t pad_1[kCacheLineSize];
+  size_t head;
+  uint8_t pad_2[kCacheLineSize];
+};
+
+}  // namespace erpc
@@ -38,7 +38,7 @@ void sm_handler(int session_num, SmEventType sm_event_type,
 void simple_disconnect(Nexus *nexus, size_t) {
   // We're testing session connection, so can't use client_connect_sessions
   AppContext c;
-  c.rpc = new Rpc(nexus, static_cast<void *>(&c), kTestClientRpcId,
+  c.rpc = new Rpc<CTransport>(nexus, static_cast<void *>(&c), kTestClientRpcId,
                               &sm_handler);
   auto *rpc = c.rpc;
 
@@ -83,7 +83,7 @@ TEST(Base, SimpleDisconnect) {
 void disconnect_multi(Nexus *nexus, size_t) {
   // We're testing session connection, so can't use client_connect_sessions()
   AppContext c;
-  c.rpc = new Rpc(nexus, static_cast<void *>(&c), kTestClientRpcId,
+  c.rpc = new Rpc<CTransport>(nexus, static_cast<void *>(&c), kTestClientRpcId,
                               &sm_handler);
   auto *rpc = c.rpc;
 
@@ -136,7 +136,7 @@ TEST(Base, DisconnectMulti) {
 void disconnect_remote_error(Nexus *nexus, size_t) {
   // We're testing session connection, so can't use client_connect_sessions
   AppContext c;
-  c.rpc = new Rpc(nexus, static_cast<void *>(&c), kTestClientRpcId,
+  c.rpc = new Rpc<CTransport>(nexus, static_cast<void *>(&c), kTestClientRpcId,
                               &sm_handler);
   auto *rpc = c.rpc;
 
@@ -168,7 +168,7 @@ TEST(Base, DisconnectRemoteError) {
 void disconnect_local_error(Nexus *nexus, size_t) {
   // We're testing session connection, so can't use client_connect_sessions
   AppContext c;
-  c.rpc = new Rpc(nexus, static_cast<void *>(&c), kTestClientRpcId,
+  c.rpc = new Rpc<CTransport>(nexus, static_cast<void *>(&c), kTestClientRpcId,
                               &sm_handler);
   auto *rpc = c.rpc;
 
@@ -20,12 +20,18 @@ static constexpr size_t kTestNumaNode = 0;
 static constexpr size_t kTestUniqToken = 42;
 static constexpr size_t kTestRpcId = 0;  // ID of the fixture's Rpc
 static constexpr size_t kTestReqType = 1;
+static constexpr size_t kTestHighPrioReqType = 2;
+static constexpr size_t kTestStreamReqType = 3;
+static constexpr size_t kTestBatchReqType = 4;
 static constexpr void *kTestTag = nullptr;
 static constexpr size_t kTestSmallMsgSize = 32;
 static constexpr size_t kTestLargeMsgSize = KB(128);
 static constexpr double kTestLinkBandwidth = 56.0 * 1000 * 1000 * 1000 / 8;
 
 static void req_handler(ReqHandle *, void *);  // Defined in each test.cc
+static void req_chunk_func(ReqHandle *, const uint8_t *, size_t, size_t,
+                           void *);
+static void req_batch_func(ReqHandle *const *, size_t, void *);
 
 /// Basic eRPC test class with an Rpc object and functions to create client
 /// and server sessions
@@ -43,9 +49,14 @@ class RpcTest : public ::testing::Test {
     rt_assert(nexus != nullptr, "Failed to create nexus");
     nexus->register_req_func(kTestReqType, req_handler,
                              ReqFuncType::kForeground);
+    nexus->register_req_func(kTestHighPrioReqType, req_handler,
+                             ReqFuncType::kForeground, ReqPriority::kHigh);
+    nexus->register_streaming_req_func(kTestStreamReqType, req_chunk_func,
+                                       req_handler);
+    nexus->register_batch_req_func(kTestBatchReqType, req_batch_func);
     nexus->kill_switch = true;  // Kill SM thread
 
-    rpc = new Rpc(nexus, nullptr, kTestRpcId, sm_handler);
+    rpc = new Rpc<CTransport>(nexus, nullptr, kTestRpcId, sm_handler);
 
     rt_assert(rpc != nullptr, "Failed to create Rpc");
 
@@ -86,7 +97,6 @@ class RpcTest : public ::testing::Test {
     session->server = server;
     session->server.session_num = kInvalidSessionNum;
 
-    rpc->ring_entries_available -= kSessionCredits;
     rpc->session_vec.push_back(session);
 
     return session;
@@ -103,6 +113,9 @@ class RpcTest : public ::testing::Test {
     session->state = SessionState::kConnected;
     session->client_info.cc.prev_desired_tx_tsc = rdtsc();
 
+    // Act as if the server has lent us all credits
+    Rpc<CTransport>::set_credit_limit(session, kSessionCredits);
+
     return session;
   }
 
@@ -123,7 +136,6 @@ class RpcTest : public ::testing::Test {
     session->local_session_num = session->server.session_num;
     session->remote_session_num = session->client.session_num;
 
-    rpc->ring_entries_available -= kSessionCredits;
     rpc->session_vec.push_back(session);
     return session;
   }
@@ -136,7 +148,7 @@ class RpcTest : public ::testing::Test {
     return se;
   }
 
-  Rpc *rpc = nullptr;
+  Rpc<CTransport> *rpc = nullptr;
   FixedQueue<pkthdr_t, kSessionCredits> *pkthdr_tx_queue;
 
  private:
@@ -151,6 +163,9 @@ class RpcTest : public ::testing::Test {
   /// Useful counters for subtests
   size_t num_req_handler_calls = 0;
   size_t num_cont_func_calls = 0;
+  size_t num_req_chunk_calls = 0;
+  size_t req_chunk_end = 0;  ///< End offset of the last request chunk
+  size_t num_req_batch_calls = 0;
 };
 
 /// The common request handler for subtests. Works for any request size.
@@ -167,6 +182,26 @@ static void req_handler(ReqHandle *req_handle, void *_context) {
   context->num_req_handler_calls++;
 }
 
+/// The chunk callback for streaming subtests. Checks that chunks are in order.
+static void req_chunk_func(ReqHandle *req_handle, const uint8_t *chunk,
+                           size_t offset, size_t size, void *_context) {
+  auto *context = static_cast<RpcTest *>(_context);
+  rt_assert(offset == 0 || offset == context->req_chunk_end, "Chunk gap");
+  rt_assert(chunk == &req_handle->get_req_msgbuf()->buf[offset], "Bad chunk");
+
+  context->req_chunk_end = offset + size;
+  context->num_req_chunk_calls++;
+}
+
+/// The batched request handler for subtests. Handles each request with the
+/// common request handler.
+static void req_batch_func(ReqHandle *const *req_handles, size_t num_reqs,
+                           void *_context) {
+  auto *context = static_cast<RpcTest *>(_context);
+  for (size_t i = 0; i < num_reqs; i++) req_handler(req_handles[i], _context);
+  context->num_req_batch_calls++;
+}
+
 /// The common continuation for subtests.
 static void cont_func(void *_context, void *) {
   auto *context = static_cast<RpcTest *>(_context);
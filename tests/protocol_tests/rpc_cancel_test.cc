@@ -0,0 +1,248 @@
+#include "protocol_tests.h"
+
+namespace erpc {
+
+static RespStatus last_resp_status;  // Status seen by the last continuation
+
+static void status_cont_func(void *_context, void *tag) {
+  auto *resp_msgbuf = static_cast<MsgBuffer *>(tag);
+  last_resp_status = resp_msgbuf->get_resp_status();
+  cont_func(_context, tag);
+}
+
+TEST_F(RpcTest, cancel_request) {
+  const auto client = get_local_endpoint();
+  const auto server = get_remote_endpoint();
+  Session *clt_session = create_client_session_connected(client, server);
+  SSlot *sslot_0 = &clt_session->sslot_arr[0];
+  rpc->faults.hard_wheel_bypass = true;  // Don't place request pkts in wheel
+  rpc->ev_loop_tsc = rdtsc();
+  clt_session->client_info.last_req_tsc = rpc->ev_loop_tsc;  // Not idle
+
+  MsgBuffer req = rpc->alloc_msg_buffer(kTestLargeMsgSize);
+  MsgBuffer resp = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+
+  // Deliver a CR and a response packet for the failed request on sslot 0
+  // Expect: Both are dropped without returning credits, calling the
+  // continuation again, or writing the response
+  auto deliver_stale_replies = [&]() {
+    const size_t credits = clt_session->client_info.credits;
+    const size_t cont_func_calls = num_cont_func_calls;
+
+    pkthdr_t expl_cr;
+    expl_cr.format(kTestReqType, 0 /* msg_size */, client.session_num,
+                   PktType::kPktTypeExplCR, 0 /* pkt_num */,
+                   sslot_0->cur_req_num);
+    expl_cr.credit_grant = kSessionCredits;
+    expl_cr.sack = 0;
+    rpc->process_expl_cr_st(sslot_0, &expl_cr, rdtsc());
+
+    uint8_t remote_resp[sizeof(pkthdr_t) + kTestSmallMsgSize] = {};
+    auto *pkthdr_0 = reinterpret_cast<pkthdr_t *>(remote_resp);
+    pkthdr_0->format(kTestReqType, kTestSmallMsgSize, client.session_num,
+                     PktType::kPktTypeResp, req.num_pkts - 1,
+                     sslot_0->cur_req_num);
+    pkthdr_0->credit_grant = kSessionCredits;
+    rpc->process_resp_one_st(sslot_0, pkthdr_0, rdtsc());
+
+    ASSERT_EQ(clt_session->client_info.credits, credits);
+    ASSERT_EQ(num_cont_func_calls, cont_func_calls);
+    ASSERT_EQ(resp.get_data_size(), 0);
+  };
+
+  // Cancel an outstanding request
+  // Expect: The continuation fails, the credits are restored, and the server
+  // gets a cancel notice
+  rpc->enqueue_request(0, kTestReqType, &req, &resp, status_cont_func, &resp);
+  ASSERT_EQ(clt_session->client_info.credits, 0);
+  pkthdr_tx_queue->clear();
+
+  ASSERT_TRUE(rpc->cancel_request(0, &resp));
+  ASSERT_EQ(num_cont_func_calls, 1);
+  ASSERT_EQ(last_resp_status, RespStatus::kCancelled);
+  ASSERT_EQ(resp.get_data_size(), 0);
+  ASSERT_EQ(sslot_0->tx_msgbuf, nullptr);
+  ASSERT_EQ(clt_session->client_info.credits, kSessionCredits);
+
+  pkthdr_t cancel = pkthdr_tx_queue->pop();
+  ASSERT_TRUE(cancel.matches(PktType::kPktTypeRFR, 0));
+  ASSERT_EQ(cancel.cancel, 1);
+  ASSERT_EQ(cancel.req_num, sslot_0->cur_req_num);
+
+  // Receive a CR and a response for the cancelled request
+  // Expect: They're dropped
+  deliver_stale_replies();
+
+  // Cancel it again
+  // Expect: Nothing is cancelled
+  ASSERT_FALSE(rpc->cancel_request(0, &resp));
+  ASSERT_EQ(num_cont_func_calls, 1);
+
+  // Enqueue a request whose deadline has already passed
+  // Expect: The continuation fails without sending packets
+  rpc->enqueue_request(0, kTestReqType, &req, &resp, status_cont_func, &resp,
+                       kInvalidBgETid, rpc->ev_loop_tsc);
+  ASSERT_EQ(num_cont_func_calls, 2);
+  ASSERT_EQ(last_resp_status, RespStatus::kTimedOut);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+
+  // Enqueue a request with a deadline and let the deadline pass
+  // Expect: The request carries its time budget. The loss scan fails it.
+  const size_t timeout_cycles = us_to_cycles(1000, rpc->get_freq_ghz());
+  rpc->enqueue_request(0, kTestReqType, &req, &resp, status_cont_func, &resp,
+                       kInvalidBgETid, rpc->ev_loop_tsc + timeout_cycles);
+  ASSERT_GE(pkthdr_tx_queue->pop().get_budget_us(), 1000);
+  pkthdr_tx_queue->clear();
+
+  rpc->pkt_loss_scan_st();
+  ASSERT_EQ(num_cont_func_calls, 2);
+  rpc->ev_loop_tsc += timeout_cycles + rpc->rpc_pkt_loss_scan_cycles;
+  rpc->pkt_loss_scan_st();
+  ASSERT_EQ(num_cont_func_calls, 3);
+  ASSERT_EQ(last_resp_status, RespStatus::kTimedOut);
+  ASSERT_EQ(sslot_0->tx_msgbuf, nullptr);
+  ASSERT_TRUE(pkthdr_tx_queue->pop().cancel);
+
+  // Receive a CR and a response for the timed-out request
+  // Expect: They're dropped
+  deliver_stale_replies();
+
+  // The session is still usable
+  ASSERT_TRUE(clt_session->is_connected());
+  ASSERT_EQ(clt_session->client_info.sslot_free_vec.size(),
+            clt_session->req_window);
+}
+
+TEST_F(RpcTest, process_cancel_st) {
+  const auto server = get_local_endpoint();
+  const auto client = get_remote_endpoint();
+  Session *srv_session = create_server_session_init(client, server);
+  SSlot *sslot_0 = &srv_session->sslot_arr[0];
+  srv_session->server_info.credits = kSessionCredits;  // Lent by the pool
+  rpc->ev_loop_tsc = rdtsc();
+
+  uint8_t req[Transport::kMTU];
+  auto *pkthdr_0 = reinterpret_cast<pkthdr_t *>(req);
+  pkthdr_0->format(kTestReqType, kTestLargeMsgSize, server.session_num,
+                   PktType::kPktTypeReq, 0 /* pkt_num */, kSessionReqWindow);
+  pkthdr_0->set_budget_us(0);
+
+  pkthdr_t cancel;
+  cancel.format(kTestReqType, 0, server.session_num, PktType::kPktTypeRFR,
+                0 /* pkt_num */, kSessionReqWindow);
+  cancel.cancel = 1;
+
+  // Receive a cancel notice for a request that we haven't seen
+  // Expect: It's dropped
+  rpc->process_cancel_st(sslot_0, &cancel);
+  ASSERT_EQ(sslot_0->server_info.deadline_tsc, 0);
+
+  // Receive the cancel notice for a partially-received request whose credit
+  // return waits
+  // Expect: The request and its credit return are freed, and its later
+  // packets are dropped
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeExplCR, 0));
+  pkthdr_0->pkt_num = 1;
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_EQ(srv_session->server_info.cr_num_pkts, 1);
+  rpc->process_cancel_st(sslot_0, &cancel);
+  ASSERT_TRUE(sslot_0->server_info.req_msgbuf.is_buried());
+  ASSERT_EQ(srv_session->server_info.cr_num_pkts, 0);
+
+  pkthdr_0->pkt_num = 2;
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  rpc->ev_loop_tsc += rpc->rpc_cr_delay_cycles;
+  rpc->process_pending_crs_st();
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+  ASSERT_EQ(sslot_0->server_info.num_rx, 2);
+
+  // Receive a request after skipping one request number on this sslot
+  // Expect: It's accepted as a new request
+  pkthdr_0->req_num += 2 * kSessionReqWindow;
+  pkthdr_0->pkt_num = 0;
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  rpc->send_pending_cr_st(sslot_0);
+  ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeExplCR, 0));
+  ASSERT_EQ(sslot_0->cur_req_num, 3 * kSessionReqWindow);
+  ASSERT_EQ(sslot_0->server_info.num_rx, 1);
+
+  // Receive a packet of a request whose time budget has run out
+  // Expect: The request is dropped before its handler runs
+  sslot_0->server_info.deadline_tsc = rpc->ev_loop_tsc;
+  pkthdr_0->pkt_num = 1;
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+  ASSERT_TRUE(sslot_0->server_info.req_msgbuf.is_buried());
+  ASSERT_EQ(num_req_handler_calls, 0);
+}
+
+/// A chunked response whose request is cancelled while chunks wait
+TEST_F(RpcTest, process_cancel_st_chunked) {
+  const auto server = get_local_endpoint();
+  const auto client = get_remote_endpoint();
+  Session *srv_session = create_server_session_init(client, server);
+  SSlot *sslot_0 = &srv_session->sslot_arr[0];
+  auto *req_handle = reinterpret_cast<ReqHandle *>(sslot_0);
+  auto &si = sslot_0->server_info;
+  rpc->ev_loop_tsc = rdtsc();
+
+  const size_t kNumReqPkts = 5;  // Size of the received request
+  si.req_msgbuf =
+      rpc->alloc_msg_buffer(kNumReqPkts * (rpc->get_max_data_per_pkt()));
+  si.num_rx = kNumReqPkts;
+  sslot_0->cur_req_num = kSessionReqWindow;
+  si.req_type = kTestReqType;
+
+  // Enqueue chunks until the server refuses one
+  // Expect: The first chunk is sent, and kMaxRespChunks chunks wait
+  // A local copy, since ASSERT_EQ would odr-use the static member
+  const size_t max_resp_chunks = Rpc<CTransport>::kMaxRespChunks;
+  MsgBuffer chunk = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  for (size_t i = 0; i <= max_resp_chunks; i++) {
+    ASSERT_TRUE(rpc->enqueue_response_chunk(req_handle, &chunk));
+    chunk = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  }
+  ASSERT_FALSE(rpc->enqueue_response_chunk(req_handle, &chunk));
+  ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeResp,
+                                             kNumReqPkts - 1));
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+  ASSERT_EQ(si.resp_chunk_q->size(), max_resp_chunks);
+
+  // Receive the cancel notice while the handler still produces chunks
+  // Expect: The waiting chunks are freed
+  pkthdr_t cancel;
+  cancel.format(kTestReqType, 0, server.session_num, PktType::kPktTypeRFR,
+                0 /* pkt_num */, kSessionReqWindow);
+  cancel.cancel = 1;
+  rpc->process_cancel_st(sslot_0, &cancel);
+  ASSERT_TRUE(si.resp_chunk_q->empty());
+  ASSERT_EQ(si.resp_chunks_waiting, 0);
+
+  // Enqueue another chunk, and receive the RFR that pulls the next chunk
+  // Expect: The chunk is accepted and freed, and nothing is sent
+  ASSERT_TRUE(rpc->enqueue_response_chunk(req_handle, &chunk));
+  ASSERT_TRUE(si.resp_chunk_q->empty());
+  ASSERT_EQ(si.resp_chunks_waiting, 0);
+
+  pkthdr_t rfr;
+  rfr.format(kTestReqType, 0 /* msg_size */, server.session_num,
+             PktType::kPktTypeRFR, kNumReqPkts /* pkt_num */,
+             kSessionReqWindow);
+  rpc->process_rfr_st(sslot_0, &rfr);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+
+  // Enqueue the final chunk
+  // Expect: It's not sent, and the handler no longer owns the request
+  sslot_0->dyn_resp_msgbuf = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  rpc->enqueue_response(req_handle, &sslot_0->dyn_resp_msgbuf);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+  ASSERT_EQ(si.req_type, kInvalidReqType);
+}
+
+}  // namespace erpc
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -26,6 +26,8 @@ TEST_F(RpcTest, process_expl_cr_st) {
   pkthdr_t expl_cr;
   expl_cr.format(kTestReqType, 0 /* msg_size */, client.session_num,
                  PktType::kPktTypeExplCR, 0 /* pkt_num */, kSessionReqWindow);
+  expl_cr.credit_grant = kSessionCredits;
+  expl_cr.sack = 0;
 
   size_t batch_rx_tsc = rdtsc();  // Stress batch TSC use
 
@@ -49,8 +51,10 @@ TEST_F(RpcTest, process_expl_cr_st) {
   rpc->process_expl_cr_st(sslot_0, &expl_cr, batch_rx_tsc);
   ASSERT_EQ(sslot_0->client_info.num_rx, 1);
 
-  // Client should use only num_rx & num_tx for ordering (sensitivity)
+  // Client should use only the ack window for ordering (sensitivity)
   // Expect: On resetting it, behavior should be like an in-order explicit CR
+  sslot_0->client_info.ack_base = 0;
+  sslot_0->client_info.ack_bitmap = 0;
   sslot_0->client_info.num_rx--;
   sslot_0->client_info.num_tx--;
   rpc->process_expl_cr_st(sslot_0, &expl_cr, batch_rx_tsc);
@@ -59,13 +63,118 @@ TEST_F(RpcTest, process_expl_cr_st) {
   ASSERT_TRUE(
       pkthdr_tx_queue->pop().matches(PktType::kPktTypeReq, kSessionCredits));
 
-  // Receive explicit credit return for a future pkt in this request (roll-back)
+  // Receive explicit credit return for a later pkt, with pkt 1's CR lost
+  // Expect: It's accepted, but pkt 1 holds back the ack window, so the credit
+  // is not used
+  expl_cr.pkt_num = 2;
+  rpc->process_expl_cr_st(sslot_0, &expl_cr, batch_rx_tsc);
+  ASSERT_EQ(sslot_0->client_info.num_rx, 2);
+  ASSERT_EQ(sslot_0->client_info.ack_base, 1);
+  ASSERT_EQ(clt_session->client_info.credits, 1);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+
+  // Receive explicit credit return for pkt 3 whose SACK bitmap covers pkt 1
+  // Expect: Pkts 1 and 3 are answered, and three request packets are sent
+  expl_cr.pkt_num = 3;
+  expl_cr.sack = 1ull << (kSackBits - 2);  // Packet (3 - 2) = 1
+  rpc->process_expl_cr_st(sslot_0, &expl_cr, batch_rx_tsc);
+  ASSERT_EQ(sslot_0->client_info.num_rx, 4);
+  ASSERT_EQ(sslot_0->client_info.ack_base, 4);
+  ASSERT_EQ(clt_session->client_info.credits, 0);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 3);
+  pkthdr_tx_queue->clear();
+
+  // Receive explicit credit return for pkt (4 + kFastRetxThresh), with CRs for
+  // pkts 4 and later lost
+  // Expect: Pkt 4 is fast-retransmitted once, and nothing else is sent
+  expl_cr.pkt_num = 4 + kFastRetxThresh;
+  expl_cr.sack = 0;
+  rpc->process_expl_cr_st(sslot_0, &expl_cr, batch_rx_tsc);
+  ASSERT_EQ(sslot_0->client_info.num_rx, 5);
+  ASSERT_EQ(rpc->pkt_loss_stats.num_fast_re_tx, 1);
+  ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeReq, 4));
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+
+  // Receive explicit credit return for a packet that we haven't sent (future)
   // Expect: It's dropped
-  expl_cr.pkt_num = 2;  // Future
+  expl_cr.pkt_num = sslot_0->client_info.num_tx;
+  expl_cr.sack = 0;
   rpc->process_expl_cr_st(sslot_0, &expl_cr, batch_rx_tsc);
-  ASSERT_EQ(sslot_0->client_info.num_rx, 1);
+  ASSERT_EQ(sslot_0->client_info.num_rx, 5);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+}
+
+TEST_F(RpcTest, add_pending_cr_st) {
+  const auto server = get_local_endpoint();
+  const auto client = get_remote_endpoint();
+  Session *srv_session = create_server_session_init(client, server);
+  SSlot *sslot_0 = &srv_session->sslot_arr[0];
+  srv_session->server_info.credits = kSessionCredits;  // Lent by the pool
+  rpc->ev_loop_tsc = rdtsc();
+
+  uint8_t req[Transport::kMTU];
+  auto *pkthdr_0 = reinterpret_cast<pkthdr_t *>(req);
+  pkthdr_0->format(kTestReqType, kTestLargeMsgSize, server.session_num,
+                   PktType::kPktTypeReq, 0 /* pkt_num */, kSessionReqWindow);
+
+  // Receive the first (kCrBatchPkts + 1) request packets (in-order)
+  // Expect: The first packet is answered without delay, and one credit return
+  // answers the others
+  for (size_t i = 0; i <= kCrBatchPkts; i++) {
+    pkthdr_0->pkt_num = i;
+    rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  }
+  ASSERT_EQ(pkthdr_tx_queue->size(), 2);
+  ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeExplCR, 0));
+  pkthdr_t cr = pkthdr_tx_queue->pop();
+  ASSERT_TRUE(cr.matches(PktType::kPktTypeExplCR, kCrBatchPkts));
+  ASSERT_EQ(cr.sack, rpc->low_bits(kSackBits));
+  ASSERT_EQ(cr.delayed, 0);
+
+  // Receive the next packet, and one that its SACK bitmap can't reach
+  // Expect: The pending credit return is sent first
+  const size_t next_pkt_num = kCrBatchPkts + 1;
+  pkthdr_0->pkt_num = next_pkt_num;
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+  pkthdr_0->pkt_num = next_pkt_num + kSackBits + 1;
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeExplCR,
+                                             next_pkt_num));
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+
+  // Let the pending credit return wait for kCrDelayUs
+  // Expect: It's sent, marked as delayed so that the client takes no RTT
+  // sample from it
+  rpc->process_pending_crs_st();
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+  rpc->ev_loop_tsc += rpc->rpc_cr_delay_cycles;
+  rpc->process_pending_crs_st();
+  cr = pkthdr_tx_queue->pop();
+  ASSERT_TRUE(cr.matches(PktType::kPktTypeExplCR,
+                         next_pkt_num + kSackBits + 1));
+  ASSERT_EQ(cr.delayed, 1);
+  ASSERT_TRUE(rpc->cr_pending_sslots.empty());
+
+  // Receive another packet, and enqueue the response while its credit return
+  // waits, like a background request handler that finishes early
+  // Expect: Only the response is sent, because it answers the packet
+  pkthdr_0->pkt_num = next_pkt_num + kSackBits + 2;
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+
+  const size_t num_req_pkts = sslot_0->server_info.req_msgbuf.num_pkts;
+  MsgBuffer resp = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  sslot_0->server_info.req_type = kTestReqType;  // The handler is running
+  rpc->enqueue_response(static_cast<ReqHandle *>(sslot_0), &resp);
+  ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeResp,
+                                             num_req_pkts - 1));
+  ASSERT_EQ(srv_session->server_info.cr_num_pkts, 0);
+
+  rpc->ev_loop_tsc += rpc->rpc_cr_delay_cycles;
+  rpc->process_pending_crs_st();
   ASSERT_EQ(pkthdr_tx_queue->size(), 0);
-  expl_cr.pkt_num = 0;
+  ASSERT_TRUE(rpc->cr_pending_sslots.empty());
 }
 
 }  // namespace erpc
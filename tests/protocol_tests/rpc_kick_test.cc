@@ -25,7 +25,7 @@ class RpcClientKickTest : public RpcTest {
 };
 
 /// Transmit all sslots in a wheel. Return number of packets transmitted.
-size_t wheel_tx_all(Rpc *rpc) {
+size_t wheel_tx_all(Rpc<CTransport> *rpc) {
   for (size_t i = 0; i < kWheelNumWslots; i++) rpc->wheel->reap_wslot(i);
   size_t ret = rpc->wheel->ready_queue.size();
   rpc->process_wheel_st();
@@ -82,6 +82,7 @@ TEST_F(RpcClientKickTest, kick_st_req_pkts) {
   // Pretend that a CR has been received
   clt_session->client_info.credits = 1;
   sslot_0->client_info.num_rx = 1;
+  sslot_0->client_info.ack_base = 1;
   rpc->kick_req_st(sslot_0);
   ASSERT_EQ(clt_session->client_info.credits, 0);
   ASSERT_EQ(sslot_0->client_info.num_tx, kSessionCredits + 1);
@@ -110,6 +111,7 @@ TEST_F(RpcClientKickTest, kick_st_rfr_pkts) {
   const size_t req_npkts = rpc->data_size_to_num_pkts(req.data_size);
   sslot_0->client_info.num_tx = req_npkts;
   sslot_0->client_info.num_rx = req_npkts;
+  sslot_0->client_info.ack_base = req_npkts;
   clt_session->client_info.credits = kSessionCredits;
 
   rpc->kick_rfr_st(sslot_0);
@@ -121,6 +123,157 @@ TEST_F(RpcClientKickTest, kick_st_rfr_pkts) {
   }
 }
 
+/// Requests that wait for credits share them in deficit round robin order
+TEST_F(RpcClientKickTest, process_tx_queues_st) {
+  SSlot *sslot_1 = &clt_session->sslot_arr[1];
+  MsgBuffer req_1 = rpc->alloc_msg_buffer(kTestLargeMsgSize);
+  MsgBuffer resp_1 = rpc->alloc_msg_buffer(kTestLargeMsgSize);
+  rpc->faults.hard_wheel_bypass = true;  // Don't place request pkts in wheel
+  auto &sci = clt_session->client_info;
+
+  // The first request uses all credits. The second waits in the TX queue.
+  rpc->enqueue_request(0, kTestReqType, &req, &resp, cont_func, kTestTag);
+  rpc->enqueue_request(0, kTestReqType, &req_1, &resp_1, cont_func, kTestTag);
+  ASSERT_EQ(sci.credits, 0);
+  ASSERT_EQ(sci.tx_head, sslot_1);
+  pkthdr_tx_queue->clear();
+
+  // Pretend that the first request's packets are acked, returning four turns
+  // worth of credits
+  const size_t num_credits = 4 * kTxQuantumPkts;
+  sslot_0->client_info.num_rx = kSessionCredits;
+  sslot_0->client_info.ack_base = kSessionCredits;
+  sci.credits = num_credits;
+  rpc->tx_sched_st(sslot_0);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);  // The second request goes first
+
+  // Expect: The requests alternate in turns of kTxQuantumPkts packets
+  rpc->process_tx_queues_st();
+  ASSERT_EQ(sci.credits, 0);
+  ASSERT_EQ(pkthdr_tx_queue->size(), num_credits);
+  for (size_t i = 0; i < num_credits; i++) {
+    SSlot *sslot = (i / kTxQuantumPkts) % 2 == 0 ? sslot_1 : sslot_0;
+    ASSERT_EQ(pkthdr_tx_queue->pop().req_num, sslot->cur_req_num);
+  }
+
+  // Both requests wait for more credits, with the second one's turn next
+  ASSERT_EQ(sci.tx_head, sslot_1);
+  ASSERT_EQ(sci.tx_tail, sslot_0);
+}
+
+/// High-priority requests skip the TX queue and the timing wheel
+TEST_F(RpcClientKickTest, high_prio_tx) {
+  assert(rpc->faults.hard_wheel_bypass == false);
+  SSlot *sslot_1 = &clt_session->sslot_arr[1];
+  SSlot *sslot_2 = &clt_session->sslot_arr[2];
+  SSlot *sslot_3 = &clt_session->sslot_arr[3];
+  MsgBuffer req_1 = rpc->alloc_msg_buffer(kTestLargeMsgSize);
+  MsgBuffer resp_1 = rpc->alloc_msg_buffer(kTestLargeMsgSize);
+  MsgBuffer hi_req = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  MsgBuffer hi_resp = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  MsgBuffer hi_req_1 = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  MsgBuffer hi_resp_1 = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  auto &sci = clt_session->client_info;
+
+  // Two normal requests use all credits and wait in the TX queue
+  rpc->enqueue_request(0, kTestReqType, &req, &resp, cont_func, kTestTag);
+  rpc->enqueue_request(0, kTestReqType, &req_1, &resp_1, cont_func, kTestTag);
+  sslot_0->client_info.num_rx = kSessionCredits;
+  sslot_0->client_info.ack_base = kSessionCredits;
+  rpc->tx_sched_st(sslot_0);
+  ASSERT_EQ(sci.tx_tail, sslot_0);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);  // Packets are in the wheel
+
+  // Enqueue two high-priority requests
+  // Expect: They're queued ahead of the normal requests, in FIFO order
+  rpc->enqueue_request(0, kTestHighPrioReqType, &hi_req, &hi_resp, cont_func,
+                       kTestTag);
+  rpc->enqueue_request(0, kTestHighPrioReqType, &hi_req_1, &hi_resp_1,
+                       cont_func, kTestTag);
+  ASSERT_EQ(sci.tx_head, sslot_2);
+  ASSERT_EQ(sslot_2->client_info.tx_next, sslot_3);
+  ASSERT_EQ(sslot_3->client_info.tx_next, sslot_1);
+  ASSERT_EQ(sci.tx_hi_tail, sslot_3);
+  ASSERT_EQ(sci.tx_tail, sslot_0);
+
+  // Return one credit
+  // Expect: The high-priority request uses it, bypassing the timing wheel, and
+  // its packet is in the high-priority TX batch
+  sci.credits = 1;
+  rpc->tx_wake_st(clt_session);
+  rpc->process_tx_queues_st();
+  ASSERT_EQ(pkthdr_tx_queue->size(), 1);
+  pkthdr_t pkthdr = pkthdr_tx_queue->pop();
+  ASSERT_TRUE(pkthdr.matches(PktType::kPktTypeReq, 0));
+  ASSERT_EQ(pkthdr.req_type, kTestHighPrioReqType);
+  ASSERT_EQ(rpc->tx_batch_hi_i, 1);
+  ASSERT_EQ(sci.tx_head, sslot_3);
+
+  // Return another credit
+  // Expect: The second high-priority request uses it
+  sci.credits = 1;
+  rpc->tx_wake_st(clt_session);
+  rpc->process_tx_queues_st();
+  ASSERT_EQ(pkthdr_tx_queue->size(), 1);
+  ASSERT_EQ(pkthdr_tx_queue->pop().req_type, kTestHighPrioReqType);
+  ASSERT_EQ(sci.tx_head, sslot_1);
+  ASSERT_EQ(sci.tx_hi_tail, nullptr);
+}
+
+/// A queued multi-packet high-priority request that sends its last packets by
+/// bypassing the TX queue leaves the queue, so it isn't left there after its
+/// response frees the sslot
+TEST_F(RpcClientKickTest, high_prio_tx_multi_pkt) {
+  static constexpr size_t kNumReqPkts = 4;
+  MsgBuffer hi_req =
+      rpc->alloc_msg_buffer((kNumReqPkts - 1) * CTransport::kMaxDataPerPkt + 1);
+  MsgBuffer hi_resp = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  auto &sci = clt_session->client_info;
+
+  // Enqueue the request with two credits
+  // Expect: It sends two packets and waits in the TX queue for credits
+  sci.credits = 2;
+  rpc->enqueue_request(0, kTestHighPrioReqType, &hi_req, &hi_resp, cont_func,
+                       kTestTag);
+  ASSERT_EQ(sslot_0->client_info.num_tx, 2);
+  ASSERT_TRUE(sslot_0->client_info.in_tx_queue);
+  ASSERT_EQ(sci.tx_head, sslot_0);
+  pkthdr_tx_queue->clear();
+
+  // Receive explicit credit returns for both packets
+  // Expect: Each one sends a packet right away. After the last request packet,
+  // the request leaves the TX queue.
+  pkthdr_t expl_cr = {};
+  expl_cr.format(kTestHighPrioReqType, 0 /* msg_size */, client.session_num,
+                 PktType::kPktTypeExplCR, 0 /* pkt_num */, kSessionReqWindow);
+  expl_cr.credit_grant = kSessionCredits;
+  expl_cr.sack = 0;
+  rpc->process_expl_cr_st(sslot_0, &expl_cr, rdtsc());
+  expl_cr.pkt_num = 1;
+  rpc->process_expl_cr_st(sslot_0, &expl_cr, rdtsc());
+  ASSERT_EQ(sslot_0->client_info.num_tx, kNumReqPkts);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 2);
+  ASSERT_FALSE(sslot_0->client_info.in_tx_queue);
+  ASSERT_EQ(sci.tx_head, nullptr);
+  ASSERT_EQ(sci.tx_hi_tail, nullptr);
+
+  // Receive the response, and run the TX scheduler with credits
+  // Expect: The request completes, and nothing is sent
+  pkthdr_t resp_pkthdr = {};
+  resp_pkthdr.format(kTestHighPrioReqType, 0 /* msg_size */,
+                     client.session_num, PktType::kPktTypeResp,
+                     kNumReqPkts - 1, kSessionReqWindow);
+  resp_pkthdr.credit_grant = kSessionCredits;
+  rpc->process_resp_one_st(sslot_0, &resp_pkthdr, rdtsc());
+  ASSERT_EQ(num_cont_func_calls, 1);
+  ASSERT_EQ(sslot_0->tx_msgbuf, nullptr);
+
+  pkthdr_tx_queue->clear();
+  rpc->tx_wake_st(clt_session);
+  rpc->process_tx_queues_st();
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+}
+
 }  // namespace erpc
 
 int main(int argc, char **argv) {
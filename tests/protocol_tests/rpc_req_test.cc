@@ -52,6 +52,38 @@ TEST_F(RpcTest, process_small_req_st) {
   num_req_handler_calls = 0;
 }
 
+/// Requests of a batched handler wait for the end of the RX batch
+TEST_F(RpcTest, process_req_batch_st) {
+  const auto server = get_local_endpoint();
+  const auto client = get_remote_endpoint();
+  Session *srv_session = create_server_session_init(client, server);
+
+  uint8_t req[3][sizeof(pkthdr_t) + kTestSmallMsgSize];
+  const size_t req_type[3] = {kTestBatchReqType, kTestReqType,
+                              kTestBatchReqType};
+  for (size_t i = 0; i < 3; i++) {
+    auto *pkthdr = reinterpret_cast<pkthdr_t *>(req[i]);
+    pkthdr->format(req_type[i], kTestSmallMsgSize, server.session_num,
+                   PktType::kPktTypeReq, 0 /* pkt_num */,
+                   kSessionReqWindow + i);
+    rpc->process_small_req_st(&srv_session->sslot_arr[i], pkthdr);
+  }
+
+  // Expect: Only the normal request is handled, and it's responded to
+  ASSERT_EQ(num_req_handler_calls, 1);
+  ASSERT_EQ(rpc->req_batch.size(), 2);
+  ASSERT_EQ(pkthdr_tx_queue->pop().req_num, kSessionReqWindow + 1);
+
+  // End the RX batch
+  // Expect: One batched handler call with both requests, in arrival order
+  rpc->process_req_batch_st();
+  ASSERT_EQ(num_req_batch_calls, 1);
+  ASSERT_EQ(num_req_handler_calls, 3);
+  ASSERT_TRUE(rpc->req_batch.empty());
+  ASSERT_EQ(pkthdr_tx_queue->pop().req_num, kSessionReqWindow);
+  ASSERT_EQ(pkthdr_tx_queue->pop().req_num, kSessionReqWindow + 2);
+}
+
 TEST_F(RpcTest, process_large_req_one_st) {
   const size_t num_pkts_in_req = rpc->data_size_to_num_pkts(kTestLargeMsgSize);
   ASSERT_GT(num_pkts_in_req, 10);
@@ -60,6 +92,7 @@ TEST_F(RpcTest, process_large_req_one_st) {
   const auto client = get_remote_endpoint();
   Session *srv_session = create_server_session_init(client, server);
   SSlot *sslot_0 = &srv_session->sslot_arr[0];
+  srv_session->server_info.credits = kSessionCredits;  // Lent by the pool
 
   // The request packet that is recevied
   uint8_t req[Transport::kMTU];
@@ -77,16 +110,16 @@ TEST_F(RpcTest, process_large_req_one_st) {
   sslot_0->cur_req_num -= 2 * kSessionReqWindow;
 
   // Receive the zeroth request packet (in-order)
-  // Expect: Credit return is sent
+  // Expect: Credit return is sent without delay for the first packet
   rpc->process_large_req_one_st(sslot_0, pkthdr_0);
   ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeExplCR, 0));
   ASSERT_EQ(sslot_0->server_info.num_rx, 1);
 
   // Receive the next request packet (in-order)
-  // Expect: Credit return is sent
+  // Expect: Credit return is pending
   pkthdr_0->pkt_num++;
   rpc->process_large_req_one_st(sslot_0, pkthdr_0);
-  ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeExplCR, 1));
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
   ASSERT_EQ(sslot_0->server_info.num_rx, 2);
 
   // Receive the same request packet again (past)
@@ -96,17 +129,34 @@ TEST_F(RpcTest, process_large_req_one_st) {
   ASSERT_EQ(sslot_0->server_info.num_rx, 2);
   ASSERT_EQ(rpc->transport->testing.tx_flush_count, 0);
 
-  // Receive a future packet for this request (future)
-  // Expect: It's dropped
+  // Receive a later packet for this request, with one packet lost (reorder),
+  // and send the pending credit return
+  // Expect: One credit return answers both pending packets, with a SACK bitmap
+  // that skips the lost pkt
   pkthdr_0->pkt_num += 2u;
   rpc->process_large_req_one_st(sslot_0, pkthdr_0);
   ASSERT_EQ(pkthdr_tx_queue->size(), 0);
-  ASSERT_EQ(sslot_0->server_info.num_rx, 2);
+  rpc->send_pending_cr_st(sslot_0);
+  pkthdr_t cr = pkthdr_tx_queue->pop();
+  ASSERT_TRUE(cr.matches(PktType::kPktTypeExplCR, 3));
+  ASSERT_EQ(cr.sack, rpc->low_bits(kSackBits) & ~(1ull << (kSackBits - 1)));
+  ASSERT_EQ(sslot_0->server_info.num_rx, 3);
+  ASSERT_EQ(sslot_0->server_info.rx_base, 2);
   pkthdr_0->pkt_num -= 2u;
 
+  // Receive a packet past the server's receive window (future)
+  // Expect: It's dropped
+  pkthdr_0->pkt_num += kSessionCredits + 1;
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+  ASSERT_EQ(sslot_0->server_info.num_rx, 3);
+  pkthdr_0->pkt_num -= kSessionCredits + 1;
+
   // Receive the last packet of this request (in-order)
   // Expect: First response packet is sent, and request is buried
   sslot_0->server_info.num_rx = num_pkts_in_req - 1;
+  sslot_0->server_info.rx_base = num_pkts_in_req - 1;
+  sslot_0->server_info.rx_bitmap = 0;
   pkthdr_0->pkt_num = num_pkts_in_req - 1;
   rpc->process_large_req_one_st(sslot_0, pkthdr_0);
   ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeResp,
@@ -133,6 +183,48 @@ TEST_F(RpcTest, process_large_req_one_st) {
   ASSERT_EQ(rpc->transport->testing.tx_flush_count, 0);
 }
 
+TEST_F(RpcTest, process_large_req_one_st_streaming) {
+  const size_t num_pkts_in_req = rpc->data_size_to_num_pkts(kTestLargeMsgSize);
+  const size_t data_per_pkt = Transport::kMaxDataPerPkt;
+
+  const auto server = get_local_endpoint();
+  const auto client = get_remote_endpoint();
+  Session *srv_session = create_server_session_init(client, server);
+  SSlot *sslot_0 = &srv_session->sslot_arr[0];
+
+  uint8_t req[Transport::kMTU];
+  auto *pkthdr_0 = reinterpret_cast<pkthdr_t *>(req);
+  pkthdr_0->format(kTestStreamReqType, kTestLargeMsgSize, server.session_num,
+                   PktType::kPktTypeReq, 1 /* pkt_num */, kSessionReqWindow);
+
+  // Receive request packet 1 before packet 0 (reorder)
+  // Expect: No chunk is delivered
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_EQ(num_req_chunk_calls, 0);
+
+  // Receive packet 0
+  // Expect: One chunk covers both packets
+  pkthdr_0->pkt_num = 0;
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_EQ(num_req_chunk_calls, 1);
+  ASSERT_EQ(req_chunk_end, 2 * data_per_pkt);
+
+  // Receive packet 0 again (past)
+  // Expect: No chunk is delivered
+  rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_EQ(num_req_chunk_calls, 1);
+
+  // Receive the remaining packets in order
+  // Expect: One chunk per packet, then the request handler runs
+  for (size_t i = 2; i < num_pkts_in_req; i++) {
+    pkthdr_0->pkt_num = i;
+    rpc->process_large_req_one_st(sslot_0, pkthdr_0);
+  }
+  ASSERT_EQ(num_req_chunk_calls, num_pkts_in_req - 1);
+  ASSERT_EQ(req_chunk_end, kTestLargeMsgSize);
+  ASSERT_EQ(num_req_handler_calls, 1);
+}
+
 }  // namespace erpc
 
 int main(int argc, char **argv) {
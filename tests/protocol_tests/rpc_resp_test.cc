@@ -19,10 +19,11 @@ TEST_F(RpcTest, process_resp_one_SMALL_st) {
   assert(sslot_0->client_info.num_tx == 1);
 
   // Construct the basic test response packet
-  uint8_t remote_resp[sizeof(pkthdr_t) + kTestSmallMsgSize];
+  uint8_t remote_resp[sizeof(pkthdr_t) + kTestSmallMsgSize] = {};
   auto *pkthdr_0 = reinterpret_cast<pkthdr_t *>(remote_resp);
   pkthdr_0->format(kTestReqType, kTestSmallMsgSize, client.session_num,
                    PktType::kPktTypeResp, 0 /* pkt_num */, kSessionReqWindow);
+  pkthdr_0->credit_grant = kSessionCredits;
 
   size_t batch_rx_tsc = rdtsc();  // Stress batch TSC use
 
@@ -44,10 +45,13 @@ TEST_F(RpcTest, process_resp_one_SMALL_st) {
   sslot_0->client_info.num_tx = 1;
 
   // Receive an in-order small response (in-order)
-  // Expect: Continuation is invoked.
+  // Expect: Continuation is invoked. The response waited for the request
+  // handler, so the request used the initial RTO, and the RTT isn't sampled.
+  ASSERT_EQ(rpc->req_rto_tsc(sslot_0), rpc->rpc_rto_cycles);
   rpc->process_resp_one_st(sslot_0, pkthdr_0, batch_rx_tsc);
   ASSERT_EQ(num_cont_func_calls, 1);
   ASSERT_EQ(sslot_0->tx_msgbuf, nullptr);  // Response received
+  ASSERT_EQ(clt_session->client_info.rto.srtt_tsc, 0);
   num_cont_func_calls = 0;
 
   // Receive the same response again (past)
@@ -56,6 +60,53 @@ TEST_F(RpcTest, process_resp_one_SMALL_st) {
   ASSERT_EQ(num_cont_func_calls, 0);
 }
 
+/// Each chunk of a chunked response invokes the continuation. The client pulls
+/// the next chunk after the continuation returns.
+TEST_F(RpcTest, process_resp_one_st_chunked) {
+  const auto client = get_local_endpoint();
+  const auto server = get_remote_endpoint();
+  Session *clt_session = create_client_session_connected(client, server);
+  SSlot *sslot_0 = &clt_session->sslot_arr[0];
+
+  MsgBuffer req = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  MsgBuffer local_resp = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+
+  rpc->faults.hard_wheel_bypass = true;  // Don't place request pkt in wheel
+  rpc->enqueue_request(0, kTestReqType, &req, &local_resp, cont_func, kTestTag);
+  pkthdr_tx_queue->clear();
+
+  uint8_t remote_resp[sizeof(pkthdr_t) + kTestSmallMsgSize] = {};
+  auto *pkthdr_0 = reinterpret_cast<pkthdr_t *>(remote_resp);
+  pkthdr_0->format(kTestReqType, kTestSmallMsgSize, client.session_num,
+                   PktType::kPktTypeResp, 0 /* pkt_num */, kSessionReqWindow);
+  pkthdr_0->credit_grant = kSessionCredits;
+  pkthdr_0->more_chunks = 1;
+
+  // Receive the first chunk
+  // Expect: The continuation is invoked and the request stays active. An RFR
+  // pulls the next chunk.
+  rpc->process_resp_one_st(sslot_0, pkthdr_0, rdtsc());
+  ASSERT_EQ(num_cont_func_calls, 1);
+  ASSERT_TRUE(local_resp.has_more_chunks());
+  ASSERT_NE(sslot_0->tx_msgbuf, nullptr);
+  ASSERT_TRUE(pkthdr_tx_queue->pop().matches(PktType::kPktTypeRFR, 1));
+
+  // Receive the same chunk again (past)
+  // Expect: It's dropped
+  rpc->process_resp_one_st(sslot_0, pkthdr_0, rdtsc());
+  ASSERT_EQ(num_cont_func_calls, 1);
+
+  // Receive the final chunk
+  // Expect: The request completes
+  pkthdr_0->pkt_num = 1;
+  pkthdr_0->more_chunks = 0;
+  rpc->process_resp_one_st(sslot_0, pkthdr_0, rdtsc());
+  ASSERT_EQ(num_cont_func_calls, 2);
+  ASSERT_FALSE(local_resp.has_more_chunks());
+  ASSERT_EQ(sslot_0->tx_msgbuf, nullptr);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+}
+
 TEST_F(RpcTest, process_resp_one_LARGE_st) {
   // TODO
 }
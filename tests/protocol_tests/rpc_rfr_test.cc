@@ -21,7 +21,7 @@ TEST_F(RpcTest, process_rfr_st) {
 
   rpc->enqueue_response(reinterpret_cast<ReqHandle *>(sslot_0),
                         &sslot_0->dyn_resp_msgbuf);
-  ASSERT_EQ(sslot_0->server_info.sav_num_req_pkts, kNumReqPkts);
+  ASSERT_EQ(sslot_0->server_info.resp_pkt_base, kNumReqPkts - 1);
 
   pkthdr_tx_queue->pop();  // Remove the response packet
 
@@ -63,13 +63,78 @@ TEST_F(RpcTest, process_rfr_st) {
   ASSERT_EQ(sslot_0->server_info.num_rx, kNumReqPkts + 1);
   ASSERT_EQ(rpc->transport->testing.tx_flush_count, 1);  // Unchanged
 
-  // Receive a future RFR packet for this request (future)
-  // Expect: It's dropped
+  // Receive a later RFR packet for this request, with one RFR lost (reorder)
+  // Expect: Its response packet is sent
   rfr.pkt_num += 2u;
   rpc->process_rfr_st(sslot_0, &rfr);
-  ASSERT_EQ(sslot_0->server_info.num_rx, kNumReqPkts + 1);
-  ASSERT_TRUE(pkthdr_tx_queue->size() == 0);
+  ASSERT_TRUE(
+      pkthdr_tx_queue->pop().matches(PktType::kPktTypeResp, kNumReqPkts + 2));
+  ASSERT_EQ(sslot_0->server_info.num_rx, kNumReqPkts + 3);
   rfr.pkt_num -= 2u;
+
+  // Receive an RFR past the end of the response (future)
+  // Expect: It's dropped
+  rfr.pkt_num = kNumReqPkts - 1 + sslot_0->tx_msgbuf->num_pkts;
+  rpc->process_rfr_st(sslot_0, &rfr);
+  ASSERT_EQ(sslot_0->server_info.num_rx, kNumReqPkts + 3);
+  ASSERT_TRUE(pkthdr_tx_queue->size() == 0);
+}
+
+/// A chunked response is sent one chunk at a time, as the client pulls it
+TEST_F(RpcTest, process_rfr_st_chunked) {
+  const auto server = get_local_endpoint();
+  const auto client = get_remote_endpoint();
+  Session *srv_session = create_server_session_init(client, server);
+  SSlot *sslot_0 = &srv_session->sslot_arr[0];
+  auto *req_handle = reinterpret_cast<ReqHandle *>(sslot_0);
+
+  const size_t kNumReqPkts = 5;  // Size of the received request
+  sslot_0->server_info.req_msgbuf =
+      rpc->alloc_msg_buffer(kNumReqPkts * (rpc->get_max_data_per_pkt()));
+  sslot_0->server_info.num_rx = kNumReqPkts;
+  sslot_0->cur_req_num = kSessionReqWindow;
+  sslot_0->server_info.req_type = kTestReqType;
+
+  // Enqueue two chunks
+  // Expect: Only the first chunk is sent
+  MsgBuffer chunk_0 = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  MsgBuffer chunk_1 = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  rpc->enqueue_response_chunk(req_handle, &chunk_0);
+  rpc->enqueue_response_chunk(req_handle, &chunk_1);
+  pkthdr_t pkthdr = pkthdr_tx_queue->pop();
+  ASSERT_TRUE(pkthdr.matches(PktType::kPktTypeResp, kNumReqPkts - 1));
+  ASSERT_EQ(pkthdr.more_chunks, 1);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+
+  // Receive the RFR that pulls the next chunk
+  // Expect: The second chunk is sent
+  pkthdr_t rfr;
+  rfr.format(kTestReqType, 0 /* msg_size */, server.session_num,
+             PktType::kPktTypeRFR, kNumReqPkts /* pkt_num */,
+             kSessionReqWindow);
+  rpc->process_rfr_st(sslot_0, &rfr);
+  pkthdr = pkthdr_tx_queue->pop();
+  ASSERT_TRUE(pkthdr.matches(PktType::kPktTypeResp, kNumReqPkts));
+  ASSERT_EQ(pkthdr.more_chunks, 1);
+
+  // Pull the final chunk before the handler enqueues it, then enqueue it
+  // Expect: It's sent on enqueue_response()
+  rfr.pkt_num = kNumReqPkts + 1;
+  rpc->process_rfr_st(sslot_0, &rfr);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
+
+  sslot_0->dyn_resp_msgbuf = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  rpc->enqueue_response(req_handle, &sslot_0->dyn_resp_msgbuf);
+  pkthdr = pkthdr_tx_queue->pop();
+  ASSERT_TRUE(pkthdr.matches(PktType::kPktTypeResp, kNumReqPkts + 1));
+  ASSERT_EQ(pkthdr.more_chunks, 0);
+  ASSERT_EQ(sslot_0->server_info.resp_chunk_q, nullptr);
+
+  // Receive an RFR past the final chunk (future)
+  // Expect: It's dropped
+  rfr.pkt_num = kNumReqPkts + 2;
+  rpc->process_rfr_st(sslot_0, &rfr);
+  ASSERT_EQ(pkthdr_tx_queue->size(), 0);
 }
 
 }  // namespace erpc
@@ -70,18 +70,12 @@ TEST_F(RpcSmTest, handle_connect_req_st_errors) {
   rpc->handle_connect_req_st(ttm_conn_req);
   common_check(0, SmPktType::kConnectResp, SmErrType::kInvalidTransport);
 
-  // Ring entries exhausted
-  const size_t initial_ring_entries_available = rpc->ring_entries_available;
-  rpc->ring_entries_available = kSessionCredits - 1;
+  // Session numbers exhausted
+  const size_t initial_num_sessions = rpc->session_vec.size();
+  rpc->session_vec.resize(rpc->get_max_num_sessions(), nullptr);
   rpc->handle_connect_req_st(conn_req);
+  rpc->session_vec.resize(initial_num_sessions);  // Restore
   common_check(0, SmPktType::kConnectResp, SmErrType::kRingExhausted);
-  rpc->ring_entries_available = initial_ring_entries_available;  // Restore
-
-  // Ring entries exhausted
-  rpc->ring_entries_available = 0;
-  rpc->handle_connect_req_st(conn_req);
-  common_check(0, SmPktType::kConnectResp, SmErrType::kRingExhausted);
-  rpc->ring_entries_available = initial_ring_entries_available;
 
   // Client routing info resolution fails
   rpc->fault_inject_fail_resolve_rinfo_st();
@@ -113,6 +107,26 @@ TEST_F(RpcSmTest, handle_connect_req_st_errors) {
   // No more tests here because all hugepages are consumed
 }
 
+TEST_F(RpcSmTest, handle_connect_req_st_session_params) {
+  auto client = get_remote_endpoint();
+  const auto server = set_invalid_session_num(get_local_endpoint());
+  client.req_window = 64;
+  client.credits = 16;
+
+  // The server cuts the window down to its limit and grants the credits
+  rpc->max_session_req_window = 32;
+  const SmPkt conn_req(SmPktType::kConnectReq, SmErrType::kNoError,
+                       kTestUniqToken, client, server);
+  rpc->handle_connect_req_st(conn_req);
+  common_check(1, SmPktType::kConnectResp, SmErrType::kNoError);
+
+  const SmPkt &resp = rpc->udp_client.sent_vec.back();
+  ASSERT_EQ(resp.server.req_window, 32);
+  ASSERT_EQ(resp.server.credits, 16);
+  ASSERT_EQ(rpc->session_vec[0]->sslot_arr.size(), 32);
+  ASSERT_EQ(rpc->session_vec[0]->max_credits, 16);
+}
+
 //
 // handle_connect_resp_st()
 //
@@ -143,6 +157,23 @@ TEST_F(RpcSmTest, handle_connect_resp_st_reordering) {
   rpc->session_vec[0] = clt_session;       // Restore
 }
 
+TEST_F(RpcSmTest, handle_connect_resp_st_session_params) {
+  const auto client = get_local_endpoint();
+  auto server = get_remote_endpoint();
+  server.req_window = 2;
+  server.credits = 4;
+  const SmPkt conn_resp(SmPktType::kConnectResp, SmErrType::kNoError,
+                        kTestUniqToken, client, server);
+
+  // The client adopts the smaller window and credits granted by the server
+  Session *session = create_client_session_init(client, server);
+  rpc->handle_connect_resp_st(conn_resp);
+  ASSERT_EQ(session->req_window, 2);
+  ASSERT_EQ(session->sslot_arr.size(), 2);
+  ASSERT_EQ(session->client_info.sslot_free_vec.size(), 2);
+  ASSERT_EQ(session->max_credits, 4);
+}
+
 TEST_F(RpcSmTest, handle_connect_resp_st_resolve_error) {
   const auto client = get_local_endpoint();
   const auto server = get_remote_endpoint();
@@ -170,10 +201,9 @@ TEST_F(RpcSmTest, handle_connect_resp_st_response_error) {
   // Make session 0 a client session in kConnectInProgress
   create_client_session_init(client, server);
 
-  // Process response with error. Session is destroyed and ring buffers released
+  // Process response with error. Session is destroyed.
   rpc->handle_connect_resp_st(conn_resp);
   ASSERT_EQ(rpc->session_vec[0], nullptr);
-  ASSERT_TRUE(rpc->ring_entries_available == rpc->transport->kNumRxRingEntries);
   // No more tests here because session is destroyed
 }
 
@@ -194,7 +224,7 @@ TEST_F(RpcSmTest, handle_disconnect_req_st) {
   rpc->handle_disconnect_req_st(disc_req);
   common_check(1, SmPktType::kDisconnectResp, SmErrType::kNoError);
   ASSERT_EQ(rpc->session_vec[0], nullptr);
-  ASSERT_TRUE(rpc->ring_entries_available == rpc->transport->kNumRxRingEntries);
+  ASSERT_TRUE(rpc->credit_pool == rpc->transport->kNumRxRingEntries);
 
   // Process disconnect request again. Response is re-sent.
   rpc->handle_disconnect_req_st(disc_req);
@@ -218,7 +248,7 @@ TEST_F(RpcSmTest, handle_disconnect_resp_st) {
   // Process first disconnect response
   rpc->handle_disconnect_resp_st(disc_resp);
   ASSERT_EQ(rpc->session_vec[0], nullptr);
-  ASSERT_TRUE(rpc->ring_entries_available == rpc->transport->kNumRxRingEntries);
+  ASSERT_TRUE(rpc->credit_pool == rpc->transport->kNumRxRingEntries);
 
   // Process disconnect request again. This gets ignored.
   rpc->handle_disconnect_resp_st(disc_resp);
@@ -0,0 +1,276 @@
+/**
+ * @file shm_transport_test.cc
+ * @brief Tests for shared-memory channels: naming the region, wrapping around
+ * the packet rings, dropping packets when a ring is full, and giving RX slots
+ * back to the sender
+ *
+ * A client and a server UDPTransport share one channel, as a co-located
+ * session's Rpcs would.
+ */
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define private public
+#define protected public
+#include "transport_impl/udp/udp_transport.h"
+#include "util/timer.h"
+
+namespace erpc {
+static constexpr uint16_t kTestClientUdpPort = 31920;
+static constexpr uint16_t kTestServerUdpPort = 31921;
+static constexpr uint8_t kTestRpcId = 100;
+static constexpr size_t kTestMsgSize = 32;
+static constexpr size_t kTestRxTimeoutMs = 1000;
+
+/// Return true iff a shared memory object named \p name exists
+static bool shm_exists(const std::string &name) {
+  const int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd == -1) return false;
+  close(fd);
+  return true;
+}
+
+class ShmTransportTest : public ::testing::Test {
+ public:
+  ShmTransportTest()
+      : shm_name("/erpc-shm-transport-test-" + std::to_string(getpid())) {
+    client = new UDPTransport(kTestClientUdpPort, kTestRpcId, 0, nullptr);
+    client->init_mem(client_rx_ring);
+    server = new UDPTransport(kTestServerUdpPort, kTestRpcId, 0, nullptr);
+    server->init_mem(server_rx_ring);
+
+    server_routing_info =
+        Transport::make_routing_info("127.0.0.1", kTestServerUdpPort);
+  }
+
+  ~ShmTransportTest() {
+    delete client;
+    delete server;
+    shm_unlink(shm_name.c_str());  // In case a test failed before the open
+  }
+
+  /// Create the channel at the client and open it at the server, and route
+  /// the client's packets to the server through it
+  void connect_channel() {
+    client_chan = client->open_shm_channel(shm_name, true);
+    ASSERT_NE(client_chan, Transport::kInvalidShmChannel);
+    server_chan = server->open_shm_channel(shm_name, false);
+    ASSERT_NE(server_chan, Transport::kInvalidShmChannel);
+    Transport::set_shm_channel(&server_routing_info, client_chan);
+  }
+
+  /// Send \p num_pkts small packets from the client to the server. The
+  /// packets' req_types are consecutive starting from \p first_tag.
+  void tx_pkts(size_t num_pkts, size_t first_tag) {
+    std::vector<uint8_t> pkts(num_pkts * UDPTransport::kMTU);
+    std::vector<MsgBuffer> msg_buffers(num_pkts);
+    std::vector<Transport::tx_burst_item_t> items(num_pkts);
+
+    for (size_t i = 0; i < num_pkts; i++) {
+      auto *pkthdr =
+          reinterpret_cast<pkthdr_t *>(&pkts[i * UDPTransport::kMTU]);
+      pkthdr->format(static_cast<uint8_t>(first_tag + i), kTestMsgSize,
+                     0 /* dest_session_num */, PktType::kPktTypeReq,
+                     0 /* pkt_num */, 0 /* req_num */);
+      pkthdr->dest_rpc_id = kTestRpcId;
+      msg_buffers[i] = MsgBuffer(pkthdr, kTestMsgSize);
+
+      items[i].routing_info = &server_routing_info;
+      items[i].msg_buffer = &msg_buffers[i];
+      items[i].pkt_idx = 0;
+      items[i].drop = false;
+    }
+
+    // The TX batch is limited to kPostlist packets. A local copy, since
+    // std::min would odr-use the static member.
+    const size_t postlist = UDPTransport::kPostlist;
+    for (size_t i = 0; i < num_pkts; i += postlist) {
+      client->tx_burst(&items[i], std::min(postlist, num_pkts - i));
+    }
+  }
+
+  /// Receive packets at the server until \p expected RX ring entries are
+  /// filled, or until a timeout. Return the number of entries filled.
+  size_t rx_pkts(size_t expected) {
+    size_t num_rx = 0;
+    const double freq_ghz = measure_rdtsc_freq();
+    const size_t end_tsc = rdtsc() + ms_to_cycles(kTestRxTimeoutMs, freq_ghz);
+    while (num_rx < expected && rdtsc() < end_tsc) {
+      num_rx += server->rx_burst();
+    }
+
+    // Packets past the expected ones would show up now
+    usleep(1000);
+    num_rx += server->rx_burst();
+    return num_rx;
+  }
+
+  /// Check that server RX ring entry \p i holds the packet tagged \p tag
+  void check_rx_pkt(size_t i, size_t tag) {
+    const auto *pkthdr = reinterpret_cast<const pkthdr_t *>(
+        server_rx_ring[i % UDPTransport::kNumRxRingEntries]);
+    ASSERT_EQ(pkthdr->req_type, static_cast<uint8_t>(tag));
+    ASSERT_EQ(pkthdr->msg_size, kTestMsgSize);
+  }
+
+  /// Return the number of packets in the channel that the server hasn't
+  /// given back to the client
+  size_t channel_pkts_held() const {
+    const Transport::ShmRing *ring = client->shm_channels[client_chan]->tx_ring;
+    return ring->tail - ring->head;
+  }
+
+  const std::string shm_name;
+  UDPTransport *client, *server;
+  uint8_t *client_rx_ring[UDPTransport::kNumRxRingEntries];
+  uint8_t *server_rx_ring[UDPTransport::kNumRxRingEntries];
+  Transport::RoutingInfo server_routing_info;
+  size_t client_chan, server_chan;
+};
+
+/// The region is named until the server opens it, and a name can't be
+/// created twice
+TEST_F(ShmTransportTest, create_unlink) {
+  // Opening a channel that nobody created fails
+  ASSERT_EQ(server->open_shm_channel(shm_name, false),
+            Transport::kInvalidShmChannel);
+
+  const size_t chan = client->open_shm_channel(shm_name, true);
+  ASSERT_NE(chan, Transport::kInvalidShmChannel);
+  ASSERT_TRUE(shm_exists(shm_name));
+  ASSERT_EQ(server->open_shm_channel(shm_name, true),
+            Transport::kInvalidShmChannel);
+
+  // A client closing a channel that the server never opened unlinks it
+  client->close_shm_channel(chan);
+  ASSERT_FALSE(shm_exists(shm_name));
+  ASSERT_EQ(client->num_shm_channels, 0);
+
+  // Once both ends have the region mapped, the name is gone
+  connect_channel();
+  ASSERT_FALSE(shm_exists(shm_name));
+  ASSERT_EQ(client->num_shm_channels, 1);
+  ASSERT_EQ(server->num_shm_channels, 1);
+
+  // The mapping outlives the name
+  tx_pkts(1, 7);
+  ASSERT_EQ(rx_pkts(1), 1);
+  check_rx_pkt(0, 7);
+}
+
+/// Packets arrive in order while the ring indices wrap around the slots many
+/// times
+TEST_F(ShmTransportTest, ring_wraparound) {
+  connect_channel();
+
+  // Rounds of less than a ring, so each round starts at a different slot
+  static constexpr size_t kRoundPkts = Transport::kShmRingSlots / 2 + 3;
+  static constexpr size_t kNumRounds = 8;
+  size_t num_rx = 0;
+  for (size_t round = 0; round < kNumRounds; round++) {
+    tx_pkts(kRoundPkts, num_rx);
+    ASSERT_EQ(rx_pkts(kRoundPkts), kRoundPkts);
+    for (size_t i = 0; i < kRoundPkts; i++) {
+      check_rx_pkt(num_rx + i, num_rx + i);
+    }
+
+    server->post_recvs(kRoundPkts);
+    num_rx += kRoundPkts;
+    ASSERT_EQ(channel_pkts_held(), 0);
+  }
+
+  ASSERT_GT(num_rx, 4 * Transport::kShmRingSlots);
+}
+
+/// Packets sent while the ring is full are dropped, until the server gives
+/// slots back
+TEST_F(ShmTransportTest, tx_drop_when_full) {
+  connect_channel();
+
+  // Send more packets than the ring holds
+  // Expect: The ring fills up and the rest are dropped, not sent over UDP
+  tx_pkts(Transport::kShmRingSlots + 10, 0);
+  ASSERT_EQ(channel_pkts_held(), Transport::kShmRingSlots);
+  ASSERT_EQ(rx_pkts(Transport::kShmRingSlots), Transport::kShmRingSlots);
+  for (size_t i = 0; i < Transport::kShmRingSlots; i++) check_rx_pkt(i, i);
+
+  // The server holds all slots in its RX ring
+  // Expect: Sending still drops
+  tx_pkts(1, 0);
+  ASSERT_EQ(rx_pkts(1), 0);
+
+  // Give back some slots
+  // Expect: As many packets fit again
+  server->post_recvs(2);
+  tx_pkts(3, 100);
+  ASSERT_EQ(channel_pkts_held(), Transport::kShmRingSlots);
+  ASSERT_EQ(rx_pkts(2), 2);
+  check_rx_pkt(Transport::kShmRingSlots, 100);
+  check_rx_pkt(Transport::kShmRingSlots + 1, 101);
+}
+
+/// Giving back RX ring entries releases only the channel slots among them,
+/// and restores the entries' own RX buffers
+TEST_F(ShmTransportTest, release_shm_slots) {
+  connect_channel();
+
+  // Two UDP packets, then three channel packets, in the server's RX ring
+  int send_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  ASSERT_NE(send_fd, -1);
+  Transport::RoutingInfo udp_routing_info =
+      Transport::make_routing_info("127.0.0.1", kTestServerUdpPort);
+  socklen_t addrlen;
+  memcpy(&addrlen, udp_routing_info.buf, sizeof(addrlen));
+  const auto *addr = reinterpret_cast<const struct sockaddr *>(
+      udp_routing_info.buf + sizeof(addrlen));
+
+  uint8_t pkt[sizeof(pkthdr_t) + kTestMsgSize];
+  auto *pkthdr = reinterpret_cast<pkthdr_t *>(pkt);
+  for (size_t i = 0; i < 2; i++) {
+    pkthdr->format(static_cast<uint8_t>(i), kTestMsgSize,
+                   0 /* dest_session_num */, PktType::kPktTypeReq,
+                   0 /* pkt_num */, 0 /* req_num */);
+    pkthdr->dest_rpc_id = kTestRpcId;
+    ASSERT_EQ(sendto(send_fd, pkt, sizeof(pkt), 0, addr, addrlen),
+              static_cast<ssize_t>(sizeof(pkt)));
+  }
+  close(send_fd);
+  ASSERT_EQ(rx_pkts(2), 2);
+
+  tx_pkts(3, 2);
+  ASSERT_EQ(rx_pkts(3), 3);
+  for (size_t i = 0; i < 5; i++) check_rx_pkt(i, i);
+
+  ASSERT_EQ(server->rx_shm_owner[1], Transport::kInvalidShmChannel);
+  ASSERT_EQ(server->rx_shm_owner[2], server_chan);
+  ASSERT_EQ(server->rx_shm_slots_held, 3);
+  ASSERT_EQ(channel_pkts_held(), 3);
+
+  // Give back the UDP entries and the first channel entry
+  // Expect: One channel slot is released, and its entry points to the slab
+  server->post_recvs(3);
+  ASSERT_EQ(server->rx_shm_slots_held, 2);
+  ASSERT_EQ(channel_pkts_held(), 2);
+  ASSERT_EQ(server->rx_shm_owner[2], Transport::kInvalidShmChannel);
+  ASSERT_EQ(server_rx_ring[2], &server->rx_slab[2 * server->rx_buf_size]);
+  ASSERT_EQ(server_rx_ring[3], &server->shm_channels[server_chan]->rx_slots[
+                                   1 * UDPTransport::kMTU]);
+
+  server->post_recvs(2);
+  ASSERT_EQ(server->rx_shm_slots_held, 0);
+  ASSERT_EQ(channel_pkts_held(), 0);
+  for (size_t i = 0; i < 5; i++) {
+    ASSERT_EQ(server_rx_ring[i], &server->rx_slab[i * server->rx_buf_size]);
+  }
+}
+
+}  // namespace erpc
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
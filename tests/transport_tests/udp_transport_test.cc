@@ -0,0 +1,469 @@
+/**
+ * @file udp_transport_test.cc
+ * @brief Tests for coalescing small packets into shared UDP datagrams: packing
+ * them into sendmmsg() messages, and splitting received datagrams into one RX
+ * ring entry per packet. Also tests splitting UDP GRO datagrams into RX ring
+ * entries, steering packets to sockets of a shared port by Rpc ID, and
+ * counting MSG_ZEROCOPY completions.
+ *
+ * Datagrams are sent to the transport's own port over loopback, so split tests
+ * run the transport's real RX path.
+ */
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define private public
+#define protected public
+#include "transport_impl/udp/udp_transport.h"
+#include "util/timer.h"
+
+namespace erpc {
+static constexpr uint16_t kTestUdpPort = 31900;
+static constexpr uint16_t kTestOtherUdpPort = 31901;  // Never bound
+static constexpr uint8_t kTestRpcId = 100;
+static constexpr size_t kTestRxTimeoutMs = 1000;
+
+/// Write a packet with \p msg_size data bytes at \p pkt. The packet's
+/// req_type and data bytes are \p tag, so that tests can identify it.
+/// Return the packet size.
+static size_t write_pkt(uint8_t *pkt, size_t msg_size, uint8_t tag) {
+  auto *pkthdr = reinterpret_cast<pkthdr_t *>(pkt);
+  pkthdr->format(tag, msg_size, 0 /* dest_session_num */,
+                 PktType::kPktTypeReq, 0 /* pkt_num */, 0 /* req_num */);
+  pkthdr->dest_rpc_id = kTestRpcId;
+  const size_t data_size = std::min(msg_size, UDPTransport::kMaxDataPerPkt);
+  memset(pkt + sizeof(pkthdr_t), tag, data_size);
+  return sizeof(pkthdr_t) + data_size;
+}
+
+class UDPTransportTest : public ::testing::Test {
+ public:
+  UDPTransportTest() {
+    transport = new UDPTransport(kTestUdpPort, kTestRpcId, 0, nullptr);
+    transport->init_mem(rx_ring);
+    routing_info = Transport::make_routing_info("127.0.0.1", kTestUdpPort);
+    other_routing_info =
+        Transport::make_routing_info("127.0.0.1", kTestOtherUdpPort);
+    Transport::set_dgram_split(&routing_info, true);
+    Transport::set_dgram_split(&other_routing_info, true);
+
+    send_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    assert(send_fd != -1);
+  }
+
+  ~UDPTransportTest() {
+    close(send_fd);
+    delete transport;
+  }
+
+  /// Send one datagram to the transport
+  void send_dgram(const uint8_t *dgram, size_t len) {
+    socklen_t addrlen;
+    memcpy(&addrlen, routing_info.buf, sizeof(addrlen));
+    const auto *addr = reinterpret_cast<const struct sockaddr *>(
+        routing_info.buf + sizeof(addrlen));
+    const ssize_t ret = sendto(send_fd, dgram, len, 0, addr, addrlen);
+    assert(ret == static_cast<ssize_t>(len));
+    _unused(ret);
+  }
+
+  /// Receive packets until \p expected RX ring entries are filled, or until a
+  /// timeout. Return the number of entries filled.
+  size_t rx_pkts(size_t expected) {
+    size_t num_rx = 0;
+    const double freq_ghz = measure_rdtsc_freq();
+    const size_t end_tsc = rdtsc() + ms_to_cycles(kTestRxTimeoutMs, freq_ghz);
+    while (num_rx < expected && rdtsc() < end_tsc) {
+      num_rx += transport->rx_burst();
+    }
+
+    // Packets past the expected ones would show up now
+    usleep(1000);
+    num_rx += transport->rx_burst();
+    return num_rx;
+  }
+
+  /// Check that RX ring entry \p i holds the packet written with \p msg_size
+  /// and \p tag
+  void check_rx_pkt(size_t i, size_t msg_size, uint8_t tag) {
+    const uint8_t *pkt = rx_ring[i];
+    const auto *pkthdr = reinterpret_cast<const pkthdr_t *>(pkt);
+    ASSERT_EQ(pkthdr->req_type, tag);
+    ASSERT_EQ(pkthdr->msg_size, msg_size);
+    const size_t data_size = std::min(msg_size, UDPTransport::kMaxDataPerPkt);
+    for (size_t j = 0; j < data_size; j++) {
+      ASSERT_EQ(pkt[sizeof(pkthdr_t) + j], tag);
+    }
+  }
+
+  UDPTransport *transport;
+  uint8_t *rx_ring[UDPTransport::kNumRxRingEntries];
+  Transport::RoutingInfo routing_info, other_routing_info;
+  int send_fd;
+};
+
+/// A datagram's packets are found from their headers' message sizes
+TEST_F(UDPTransportTest, parse_dgram) {
+  uint8_t dgram[UDPTransport::kMTU];
+  size_t offs[UDPTransport::kMaxPktsPerDgram];
+
+  // A coalesced datagram
+  // Expect: All its packets are found, including one without data
+  size_t len = write_pkt(dgram, 10, 1);
+  len += write_pkt(&dgram[len], 0, 2);
+  len += write_pkt(&dgram[len], 100, 3);
+  ASSERT_EQ(UDPTransport::parse_dgram(dgram, len, offs), 3);
+  ASSERT_EQ(offs[0], 0);
+  ASSERT_EQ(offs[1], sizeof(pkthdr_t) + 10);
+  ASSERT_EQ(offs[2], 2 * sizeof(pkthdr_t) + 10);
+
+  // A datagram whose last packet, or its header, is truncated
+  // Expect: Only the complete packets are found
+  ASSERT_EQ(UDPTransport::parse_dgram(dgram, len - 1, offs), 2);
+  ASSERT_EQ(UDPTransport::parse_dgram(dgram, offs[2] + 1, offs), 2);
+
+  // A packet of a multi-packet message, and a datagram shorter than a header
+  // Expect: Each is one packet, which the Rpc layer checks
+  write_pkt(dgram, 2 * UDPTransport::kMaxDataPerPkt, 1);
+  ASSERT_EQ(UDPTransport::parse_dgram(dgram, UDPTransport::kMTU, offs), 1);
+  ASSERT_EQ(UDPTransport::parse_dgram(dgram, sizeof(pkthdr_t) - 1, nullptr), 1);
+}
+
+/// Coalesced and plain datagrams are split into one RX ring entry per packet,
+/// in order
+TEST_F(UDPTransportTest, split_dgrams_mixed) {
+  uint8_t dgram[UDPTransport::kMTU];
+
+  size_t len = write_pkt(dgram, 10, 1);  // Coalesced
+  len += write_pkt(&dgram[len], 0, 2);
+  len += write_pkt(&dgram[len], 100, 3);
+  send_dgram(dgram, len);
+
+  len = write_pkt(dgram, 2 * UDPTransport::kMaxDataPerPkt, 4);  // Plain
+  send_dgram(dgram, len);
+
+  len = write_pkt(dgram, 20, 5);  // Plain, small
+  send_dgram(dgram, len);
+
+  len = write_pkt(dgram, 30, 6);  // Coalesced
+  len += write_pkt(&dgram[len], 40, 7);
+  send_dgram(dgram, len);
+
+  ASSERT_EQ(rx_pkts(7), 7);
+  check_rx_pkt(0, 10, 1);
+  check_rx_pkt(1, 0, 2);
+  check_rx_pkt(2, 100, 3);
+  check_rx_pkt(3, 2 * UDPTransport::kMaxDataPerPkt, 4);
+  check_rx_pkt(4, 20, 5);
+  check_rx_pkt(5, 30, 6);
+  check_rx_pkt(6, 40, 7);
+}
+
+/// The truncated trailing packet of a datagram is dropped
+TEST_F(UDPTransportTest, split_dgrams_truncated) {
+  uint8_t dgram[UDPTransport::kMTU];
+  size_t len = write_pkt(dgram, 10, 1);
+  len += write_pkt(&dgram[len], 20, 2);
+  len += write_pkt(&dgram[len], 100, 3);
+  send_dgram(dgram, len - 50);
+
+  ASSERT_EQ(rx_pkts(2), 2);
+  check_rx_pkt(0, 10, 1);
+  check_rx_pkt(1, 20, 2);
+}
+
+/// Packets that don't fit in the free RX ring entries are dropped
+TEST_F(UDPTransportTest, split_dgrams_ring_full) {
+  transport->rx_ring_tail = transport->rx_ring_head + 2;  // Two free entries
+
+  uint8_t dgram[UDPTransport::kMTU];
+  size_t len = write_pkt(dgram, 10, 1);
+  len += write_pkt(&dgram[len], 20, 2);
+  len += write_pkt(&dgram[len], 30, 3);
+  send_dgram(dgram, len);
+
+  ASSERT_EQ(rx_pkts(2), 2);
+  check_rx_pkt(0, 10, 1);
+  check_rx_pkt(1, 20, 2);
+}
+
+/// Fill \p items with TX items for the small packets in \p pkts, all to
+/// \p ri
+static void make_tx_items(uint8_t (*pkts)[UDPTransport::kMTU],
+                          MsgBuffer *msg_buffers,
+                          Transport::tx_burst_item_t *items, size_t num_pkts,
+                          size_t msg_size, Transport::RoutingInfo *ri) {
+  for (size_t i = 0; i < num_pkts; i++) {
+    write_pkt(pkts[i], msg_size, static_cast<uint8_t>(i));
+    msg_buffers[i] = MsgBuffer(reinterpret_cast<pkthdr_t *>(pkts[i]), msg_size);
+    items[i].routing_info = ri;
+    items[i].msg_buffer = &msg_buffers[i];
+    items[i].pkt_idx = 0;
+    items[i].drop = false;
+  }
+}
+
+/// Consecutive small packets share a message only if they go to the same Rpc
+/// and fit in kMTU bytes together
+TEST_F(UDPTransportTest, build_tx_msgs) {
+  static constexpr size_t kNumPkts = 6;
+  static constexpr size_t kSmallMsgSize = 600;
+  uint8_t pkts[kNumPkts][UDPTransport::kMTU];
+  MsgBuffer msg_buffers[kNumPkts];
+  Transport::tx_burst_item_t items[kNumPkts];
+  make_tx_items(pkts, msg_buffers, items, kNumPkts, kSmallMsgSize,
+                &routing_info);
+
+  // Packets 0 and 1 fit in kMTU bytes, but packet 2 doesn't fit with them.
+  // Packets 3 and 4 go to another address, and packet 5 to another Rpc.
+  static_assert(3 * (sizeof(pkthdr_t) + kSmallMsgSize) > UDPTransport::kMTU,
+                "");
+  items[3].routing_info = &other_routing_info;
+  items[4].routing_info = &other_routing_info;
+  msg_buffers[5].get_pkthdr_0()->dest_rpc_id = kTestRpcId + 1;
+
+  bool zerocopy[UDPTransport::kPostlist];
+  size_t first_pkt[UDPTransport::kPostlist];
+  const size_t num_msgs =
+      transport->build_tx_msgs(items, kNumPkts, zerocopy, first_pkt);
+
+  ASSERT_EQ(num_msgs, 4);
+  const size_t exp_first_pkt[] = {0, 2, 3, 5};
+  const size_t exp_iovlen[] = {2, 1, 2, 1};
+  for (size_t m = 0; m < num_msgs; m++) {
+    ASSERT_EQ(first_pkt[m], exp_first_pkt[m]);
+    ASSERT_EQ(transport->tx_msgs[m].msg_hdr.msg_iovlen, exp_iovlen[m]);
+  }
+
+  // Packet 4 shares packet 3's message
+  ASSERT_EQ(transport->tx_msgs[2].msg_hdr.msg_iov[1].iov_base,
+            msg_buffers[4].get_pkthdr_0());
+}
+
+/// Small packets to an Rpc that doesn't split datagrams, like an io_uring Rpc,
+/// get one message each
+TEST_F(UDPTransportTest, build_tx_msgs_no_split) {
+  static constexpr size_t kNumPkts = 3;
+  uint8_t pkts[kNumPkts][UDPTransport::kMTU];
+  MsgBuffer msg_buffers[kNumPkts];
+  Transport::tx_burst_item_t items[kNumPkts];
+  Transport::set_dgram_split(&routing_info, false);
+  make_tx_items(pkts, msg_buffers, items, kNumPkts, 10, &routing_info);
+
+  bool zerocopy[UDPTransport::kPostlist];
+  size_t first_pkt[UDPTransport::kPostlist];
+  ASSERT_EQ(transport->build_tx_msgs(items, kNumPkts, zerocopy, first_pkt),
+            kNumPkts);
+}
+
+/// Send \p num_segs packets to the transport as one UDP GSO datagram. All
+/// packets but the last have \p msg_size data bytes, and the last has
+/// \p last_msg_size. Packet i's tag is i + 1.
+static void send_gso_dgram(int fd, const Transport::RoutingInfo &ri,
+                           size_t num_segs, size_t msg_size,
+                           size_t last_msg_size) {
+  const size_t seg_size = sizeof(pkthdr_t) + msg_size;
+  std::vector<uint8_t> buf(num_segs * seg_size);
+  size_t len = 0;
+  for (size_t i = 0; i < num_segs; i++) {
+    len += write_pkt(&buf[len], i + 1 < num_segs ? msg_size : last_msg_size,
+                     static_cast<uint8_t>(i + 1));
+  }
+
+  socklen_t addrlen;
+  memcpy(&addrlen, ri.buf, sizeof(addrlen));
+  struct iovec iov;
+  iov.iov_base = buf.data();
+  iov.iov_len = len;
+
+  uint8_t control[CMSG_SPACE(sizeof(uint16_t))];
+  memset(control, 0, sizeof(control));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = const_cast<uint8_t *>(ri.buf + sizeof(addrlen));
+  msg.msg_namelen = addrlen;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+  cm->cmsg_level = SOL_UDP;
+  cm->cmsg_type = UDP_SEGMENT;
+  cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+  const uint16_t gso_size = static_cast<uint16_t>(seg_size);
+  memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+
+  const ssize_t ret = sendmsg(fd, &msg, 0);
+  assert(ret == static_cast<ssize_t>(len));
+  _unused(ret);
+}
+
+/// A GRO datagram's segments are moved from their packed offsets to one RX
+/// ring entry each. Each segment's slot overlaps the next segments, so this
+/// checks that moving back to front doesn't overwrite any.
+TEST_F(UDPTransportTest, rx_burst_gro) {
+  static constexpr size_t kNumSegs = 8;
+  static constexpr size_t kMsgSize = 300;  // Much smaller than kMTU
+  int one = 1;
+  ASSERT_EQ(setsockopt(transport->sock_fd, SOL_UDP, UDP_GRO, &one,
+                       sizeof(one)),
+            0);
+
+  send_gso_dgram(send_fd, routing_info, kNumSegs, kMsgSize, 10);
+  ASSERT_EQ(transport->rx_burst_gro(), kNumSegs);
+  for (size_t i = 0; i + 1 < kNumSegs; i++) {
+    check_rx_pkt(i, kMsgSize, static_cast<uint8_t>(i + 1));
+  }
+  check_rx_pkt(kNumSegs - 1, 10, kNumSegs);
+}
+
+/// Segments past the end of the RX ring land in the bounce buffer, and are
+/// copied to the entries at the start of the ring
+TEST_F(UDPTransportTest, rx_burst_gro_wrap) {
+  static constexpr size_t kNumSegs = 8;
+  static constexpr size_t kMsgSize = 1000;
+  static constexpr size_t kRingSize = UDPTransport::kNumRxRingEntries;
+  int one = 1;
+  ASSERT_EQ(setsockopt(transport->sock_fd, SOL_UDP, UDP_GRO, &one,
+                       sizeof(one)),
+            0);
+
+  // Two entries before the end of the ring, and enough free entries
+  const size_t head = kRingSize - 2;
+  transport->rx_ring_head = head;
+  transport->rx_ring_tail = (head + 2 * kNumSegs) % kRingSize;
+
+  send_gso_dgram(send_fd, routing_info, kNumSegs, kMsgSize, kMsgSize);
+  ASSERT_EQ(transport->rx_burst_gro(), kNumSegs);
+  for (size_t i = 0; i < kNumSegs; i++) {
+    check_rx_pkt((head + i) % kRingSize, kMsgSize,
+                 static_cast<uint8_t>(i + 1));
+  }
+  ASSERT_EQ(transport->rx_ring_head, (head + kNumSegs) % kRingSize);
+}
+
+/// The steering program reads the destination Rpc ID at the right offset in
+/// the packet header, and sends each packet to that Rpc's socket
+TEST_F(UDPTransportTest, attach_steering_prog) {
+  static constexpr uint16_t kSharedUdpPort = 31902;
+  static constexpr size_t kNumSockets = 3;
+
+  Transport::reuseport_group_t group;
+  for (size_t i = 0; i < kNumSockets; i++) {
+    const int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    ASSERT_NE(fd, -1);
+    int one = 1;
+    ASSERT_EQ(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)), 0);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(kSharedUdpPort);
+    ASSERT_EQ(
+        bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)), 0);
+    group.emplace_back(static_cast<uint8_t>(10 + i), fd);  // Rpc IDs 10, 11..
+  }
+  ASSERT_TRUE(Transport::attach_steering_prog(group));
+
+  // Send packets to the Rpcs in reverse order, with req_types that look like
+  // other Rpc IDs
+  Transport::RoutingInfo shared_ri =
+      Transport::make_routing_info("127.0.0.1", kSharedUdpPort);
+  socklen_t addrlen;
+  memcpy(&addrlen, shared_ri.buf, sizeof(addrlen));
+  const auto *addr = reinterpret_cast<const struct sockaddr *>(
+      shared_ri.buf + sizeof(addrlen));
+  for (size_t i = kNumSockets; i-- > 0;) {
+    uint8_t pkt[UDPTransport::kMTU];
+    const size_t len = write_pkt(pkt, 10, static_cast<uint8_t>(10 + i + 1));
+    reinterpret_cast<pkthdr_t *>(pkt)->dest_rpc_id = 10 + i;
+    ASSERT_EQ(sendto(send_fd, pkt, len, 0, addr, addrlen),
+              static_cast<ssize_t>(len));
+  }
+
+  // Expect: Each socket got exactly the packet for its Rpc
+  usleep(1000);
+  for (size_t i = 0; i < kNumSockets; i++) {
+    uint8_t pkt[UDPTransport::kMTU];
+    ASSERT_GT(recv(group[i].second, pkt, sizeof(pkt), MSG_DONTWAIT), 0);
+    const auto *pkthdr = reinterpret_cast<const pkthdr_t *>(pkt);
+    ASSERT_EQ(pkthdr->dest_rpc_id, group[i].first);
+    ASSERT_EQ(recv(group[i].second, pkt, sizeof(pkt), MSG_DONTWAIT), -1);
+    close(group[i].second);
+  }
+}
+
+/// Enable MSG_ZEROCOPY sends on \p transport, which kZeroCopyTX leaves off
+static void enable_zerocopy(UDPTransport *transport) {
+  int one = 1;
+  const int ret = setsockopt(transport->sock_fd, SOL_SOCKET, SO_ZEROCOPY, &one,
+                             sizeof(one));
+  assert(ret == 0);
+  _unused(ret);
+  transport->zc_tx_enabled = true;
+}
+
+/// tx_flush() waits for a completion for every zero-copy send, and zero-copy
+/// is disabled once the kernel reports that it copied anyway
+TEST_F(UDPTransportTest, zerocopy_accounting) {
+  static constexpr size_t kNumPkts = 4;
+  uint8_t pkts[kNumPkts][UDPTransport::kMTU];
+  MsgBuffer msg_buffers[kNumPkts];
+  Transport::tx_burst_item_t items[kNumPkts];
+  make_tx_items(pkts, msg_buffers, items, kNumPkts,
+                2 * UDPTransport::kMaxDataPerPkt, &routing_info);
+  enable_zerocopy(transport);
+
+  // Full-size packets
+  // Expect: They're sent with MSG_ZEROCOPY. Loopback copies them.
+  transport->tx_burst(items, kNumPkts);
+  ASSERT_EQ(transport->zc_tx_sent, kNumPkts);
+  transport->tx_flush();
+  ASSERT_EQ(transport->zc_tx_completed, kNumPkts);
+  ASSERT_FALSE(transport->zc_tx_enabled);
+
+  // Expect: Later sends copy
+  transport->tx_burst(items, kNumPkts);
+  ASSERT_EQ(transport->zc_tx_sent, kNumPkts);
+  ASSERT_EQ(rx_pkts(2 * kNumPkts), 2 * kNumPkts);
+}
+
+/// A zero-copy send that fails with ENOBUFS reaps completions and is retried,
+/// and its packets are sent once
+TEST_F(UDPTransportTest, zerocopy_enobufs) {
+  static constexpr size_t kNumPkts = 4;
+  uint8_t pkts[kNumPkts][UDPTransport::kMTU];
+  MsgBuffer msg_buffers[kNumPkts];
+  Transport::tx_burst_item_t items[kNumPkts];
+  make_tx_items(pkts, msg_buffers, items, kNumPkts,
+                2 * UDPTransport::kMaxDataPerPkt, &routing_info);
+  enable_zerocopy(transport);
+
+  // Send without tx_burst()'s reaping, and let the completions arrive
+  transport->tx_burst_batched(items, kNumPkts);
+  ASSERT_EQ(transport->zc_tx_sent, kNumPkts);
+  usleep(1000);
+  ASSERT_EQ(transport->zc_tx_completed, 0);
+
+  transport->testing.zc_enobufs = 1;
+  transport->tx_burst_batched(items, kNumPkts);
+  ASSERT_EQ(transport->testing.zc_enobufs, 0);
+  ASSERT_EQ(transport->zc_tx_completed, kNumPkts);
+  ASSERT_EQ(transport->zc_tx_sent, 2 * kNumPkts);
+
+  transport->tx_flush();
+  ASSERT_EQ(transport->zc_tx_completed, 2 * kNumPkts);
+  ASSERT_EQ(rx_pkts(2 * kNumPkts), 2 * kNumPkts);
+}
+
+}  // namespace erpc
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,209 @@
+/**
+ * @file uring_transport_test.cc
+ * @brief Tests for the io_uring transport: sending a TX batch, receiving with
+ * the multishot recvmsg, and giving RX buffers back to the kernel
+ *
+ * A plain UDP socket on loopback is the transport's peer.
+ */
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define private public
+#define protected public
+#include "transport_impl/uring/uring_transport.h"
+#include "util/timer.h"
+
+namespace erpc {
+static constexpr uint16_t kTestUdpPort = 31910;
+static constexpr uint16_t kTestPeerUdpPort = 31911;
+static constexpr uint8_t kTestRpcId = 100;
+static constexpr size_t kTestRxTimeoutMs = 1000;
+static constexpr size_t kTestBatchSize = 64;  // Datagrams sent at a time
+
+/// Write a single-packet message with \p msg_size data bytes at \p pkt. The
+/// packet's req_type and data bytes are \p tag. Return the packet size.
+static size_t write_pkt(uint8_t *pkt, size_t msg_size, uint8_t tag) {
+  assert(msg_size <= URingTransport::kMaxDataPerPkt);
+  auto *pkthdr = reinterpret_cast<pkthdr_t *>(pkt);
+  pkthdr->format(tag, msg_size, 0 /* dest_session_num */,
+                 PktType::kPktTypeReq, 0 /* pkt_num */, 0 /* req_num */);
+  pkthdr->dest_rpc_id = kTestRpcId;
+  memset(pkt + sizeof(pkthdr_t), tag, msg_size);
+  return sizeof(pkthdr_t) + msg_size;
+}
+
+/// Check that the packet at \p pkt was written with \p msg_size and \p tag
+static void check_pkt(const uint8_t *pkt, size_t msg_size, uint8_t tag) {
+  const auto *pkthdr = reinterpret_cast<const pkthdr_t *>(pkt);
+  ASSERT_EQ(pkthdr->req_type, tag);
+  ASSERT_EQ(pkthdr->msg_size, msg_size);
+  for (size_t j = 0; j < msg_size; j++) {
+    ASSERT_EQ(pkt[sizeof(pkthdr_t) + j], tag);
+  }
+}
+
+/// The data size of test packet \p i
+static size_t test_msg_size(size_t i) { return 1 + (i * 37) % 900; }
+
+class URingTransportTest : public ::testing::Test {
+ public:
+  URingTransportTest() {
+    transport = new URingTransport(kTestUdpPort, kTestRpcId, 0, nullptr);
+    transport->init_mem(rx_ring);
+    routing_info = Transport::make_routing_info("127.0.0.1", kTestUdpPort);
+    peer_routing_info =
+        Transport::make_routing_info("127.0.0.1", kTestPeerUdpPort);
+
+    peer_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    assert(peer_fd != -1);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(kTestPeerUdpPort);
+    int ret = bind(peer_fd, reinterpret_cast<struct sockaddr *>(&addr),
+                   sizeof(addr));
+    assert(ret == 0);
+
+    struct timeval tv;
+    tv.tv_sec = kTestRxTimeoutMs / 1000;
+    tv.tv_usec = 0;
+    ret = setsockopt(peer_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    assert(ret == 0);
+    _unused(ret);
+  }
+
+  ~URingTransportTest() {
+    close(peer_fd);
+    delete transport;
+  }
+
+  /// Send test packet \p i from the peer to the transport
+  void send_pkt(size_t i) {
+    uint8_t pkt[URingTransport::kMTU];
+    const size_t len =
+        write_pkt(pkt, test_msg_size(i), static_cast<uint8_t>(i));
+
+    socklen_t addrlen;
+    memcpy(&addrlen, routing_info.buf, sizeof(addrlen));
+    const auto *addr = reinterpret_cast<const struct sockaddr *>(
+        routing_info.buf + sizeof(addrlen));
+    const ssize_t ret = sendto(peer_fd, pkt, len, 0, addr, addrlen);
+    assert(ret == static_cast<ssize_t>(len));
+    _unused(ret);
+  }
+
+  /// Receive packets until \p expected RX ring entries are filled, or until
+  /// \p timeout_ms passes. Return the number of entries filled.
+  size_t rx_pkts(size_t expected, size_t timeout_ms = kTestRxTimeoutMs) {
+    size_t num_rx = 0;
+    const double freq_ghz = measure_rdtsc_freq();
+    const size_t end_tsc = rdtsc() + ms_to_cycles(timeout_ms, freq_ghz);
+    while (num_rx < expected && rdtsc() < end_tsc) {
+      num_rx += transport->rx_burst();
+    }
+
+    // Packets past the expected ones would show up now
+    usleep(1000);
+    num_rx += transport->rx_burst();
+    return num_rx;
+  }
+
+  URingTransport *transport;
+  uint8_t *rx_ring[URingTransport::kNumRxRingEntries];
+  Transport::RoutingInfo routing_info, peer_routing_info;
+  int peer_fd;
+};
+
+/// Each packet of a TX batch is sent as one datagram, in order
+TEST_F(URingTransportTest, tx_burst) {
+  static constexpr size_t kNumPkts = 8;
+  uint8_t pkts[kNumPkts][URingTransport::kMTU];
+  MsgBuffer msg_buffers[kNumPkts];
+  Transport::tx_burst_item_t items[kNumPkts];
+
+  for (size_t i = 0; i < kNumPkts; i++) {
+    write_pkt(pkts[i], test_msg_size(i), static_cast<uint8_t>(i));
+    msg_buffers[i] =
+        MsgBuffer(reinterpret_cast<pkthdr_t *>(pkts[i]), test_msg_size(i));
+    items[i].routing_info = &peer_routing_info;
+    items[i].msg_buffer = &msg_buffers[i];
+    items[i].pkt_idx = 0;
+    items[i].drop = false;
+  }
+
+  transport->tx_burst(items, kNumPkts);
+  ASSERT_EQ(transport->tx_pending, 0);
+
+  uint8_t dgram[URingTransport::kMTU];
+  for (size_t i = 0; i < kNumPkts; i++) {
+    const ssize_t len = recv(peer_fd, dgram, sizeof(dgram), 0);
+    ASSERT_EQ(len, static_cast<ssize_t>(sizeof(pkthdr_t) + test_msg_size(i)));
+    check_pkt(dgram, test_msg_size(i), static_cast<uint8_t>(i));
+  }
+}
+
+/// The multishot recv fills consecutive RX ring entries, and keeps running
+/// across RX bursts
+TEST_F(URingTransportTest, rx_burst) {
+  for (size_t round = 0; round < 2; round++) {
+    for (size_t i = 0; i < kTestBatchSize; i++) send_pkt(i);
+    ASSERT_EQ(rx_pkts(kTestBatchSize), kTestBatchSize);
+    ASSERT_TRUE(transport->recv_armed);
+
+    for (size_t i = 0; i < kTestBatchSize; i++) {
+      check_pkt(rx_ring[round * kTestBatchSize + i], test_msg_size(i),
+                static_cast<uint8_t>(i));
+    }
+  }
+}
+
+/// Once the kernel has used all its buffers, the recv stops and packets wait
+/// in the socket. Buffers given back with post_recvs() restart it.
+TEST_F(URingTransportTest, rx_buf_reprovision) {
+  const size_t kernel_bufs = transport->uring_bufs_avail;
+  ASSERT_EQ(kernel_bufs, URingTransport::kNumRxRingEntries / 2);
+
+  // Receive packets until the kernel has no buffers left
+  size_t num_rx = 0;
+  while (num_rx < kernel_bufs) {
+    const size_t n = std::min(kTestBatchSize, kernel_bufs - num_rx);
+    for (size_t i = 0; i < n; i++) send_pkt(num_rx + i);
+    ASSERT_EQ(rx_pkts(n), n);
+    num_rx += n;
+  }
+  ASSERT_EQ(transport->uring_bufs_avail, 0);
+
+  // Send more packets
+  // Expect: They aren't received, and the recv stops
+  for (size_t i = 0; i < kTestBatchSize; i++) send_pkt(num_rx + i);
+  ASSERT_EQ(rx_pkts(kTestBatchSize, 50 /* timeout_ms */), 0);
+  ASSERT_FALSE(transport->recv_armed);
+
+  // Give all buffers back
+  // Expect: The recv restarts, and the waiting packets are received into the
+  // returned buffers
+  transport->post_recvs(num_rx);
+  ASSERT_EQ(transport->uring_bufs_avail, kernel_bufs);
+  ASSERT_EQ(rx_pkts(kTestBatchSize), kTestBatchSize);
+  ASSERT_TRUE(transport->recv_armed);
+
+  for (size_t i = 0; i < kTestBatchSize; i++) {
+    const uint8_t *pkt = rx_ring[num_rx + i];
+    ASSERT_GE(pkt, transport->rx_slab);
+    ASSERT_LT(pkt, transport->rx_slab +
+                       kernel_bufs * URingTransport::kRxBufSize);
+    check_pkt(pkt, test_msg_size(num_rx + i),
+              static_cast<uint8_t>(num_rx + i));
+  }
+}
+
+}  // namespace erpc
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
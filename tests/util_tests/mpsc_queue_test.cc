@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "util/mpsc_queue.h"
+
+using namespace erpc;
+
+static constexpr size_t kQueueSize = 8;
+
+TEST(MpscQueueTest, Basic) {
+  MpscQueue<size_t, kQueueSize> queue;
+  ASSERT_TRUE(queue.empty());
+
+  // Fill the queue, wrapping around once
+  for (size_t i = 0; i < kQueueSize / 2; i++) ASSERT_TRUE(queue.try_push(i));
+  for (size_t i = 0; i < kQueueSize / 2; i++) ASSERT_EQ(queue.pop(), i);
+  for (size_t i = 0; i < kQueueSize; i++) ASSERT_TRUE(queue.try_push(i));
+  ASSERT_FALSE(queue.try_push(kQueueSize));
+
+  // Batch pops stop at the end of the queue
+  size_t batch[kQueueSize];
+  ASSERT_EQ(queue.pop_batch(batch, 3), 3);
+  for (size_t i = 0; i < 3; i++) ASSERT_EQ(batch[i], i);
+  ASSERT_EQ(queue.pop_batch(batch, kQueueSize), kQueueSize - 3);
+  for (size_t i = 0; i < kQueueSize - 3; i++) ASSERT_EQ(batch[i], i + 3);
+  ASSERT_TRUE(queue.empty());
+  ASSERT_EQ(queue.pop_batch(batch, kQueueSize), 0);
+}
+
+/// Producers that retry on a full queue. Each producer's elements arrive in
+/// order, and no element is lost or duplicated.
+TEST(MpscQueueTest, MultiProducer) {
+  static constexpr size_t kNumProducers = 4;
+  static constexpr size_t kNumPushes = 100000;
+  MpscQueue<size_t, kQueueSize> queue;
+
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < kNumProducers; p++) {
+    producers.emplace_back([&queue, p] {
+      for (size_t i = 0; i < kNumPushes; i++) {
+        while (!queue.try_push(p * kNumPushes + i)) std::this_thread::yield();
+      }
+    });
+  }
+
+  std::vector<size_t> next(kNumProducers, 0);
+  size_t batch[kQueueSize];
+  size_t num_popped = 0;
+  while (num_popped < kNumProducers * kNumPushes) {
+    const size_t n = queue.pop_batch(batch, kQueueSize);
+    if (n == 0) std::this_thread::yield();
+    for (size_t i = 0; i < n; i++) {
+      const size_t p = batch[i] / kNumPushes;
+      ASSERT_EQ(batch[i] % kNumPushes, next[p]);
+      next[p]++;
+    }
+    num_popped += n;
+  }
+
+  for (auto &t : producers) t.join();
+  ASSERT_TRUE(queue.empty());
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
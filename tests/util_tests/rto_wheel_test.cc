@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+
+#define private public
+#include "rto_wheel.h"
+
+using namespace erpc;
+
+static constexpr size_t kTick = 100;  // Cycles per tick
+
+TEST(RtoWheelTest, Basic) {
+  RtoWheel wheel(kTick, 0);  // First bucket expires at kTick
+  std::vector<SSlot> sslots(3);
+  for (SSlot &s : sslots) s.client_info.rto_pprev = nullptr;
+
+  wheel.insert(&sslots[0], 5 * kTick);
+  wheel.insert(&sslots[1], 3 * kTick);
+  wheel.insert(&sslots[2], 3 * kTick + 1);  // Rounded up to the next bucket
+
+  ASSERT_EQ(wheel.pop_expired(3 * kTick - 1), nullptr);
+  ASSERT_EQ(wheel.pop_expired(3 * kTick), &sslots[1]);
+  ASSERT_EQ(wheel.pop_expired(3 * kTick), nullptr);
+
+  // Removal of a request in the wheel, and of one not in the wheel
+  RtoWheel::remove(&sslots[2]);
+  RtoWheel::remove(&sslots[1]);
+  ASSERT_EQ(wheel.pop_expired(4 * kTick), nullptr);
+
+  // Deadlines past the horizon land in the farthest bucket
+  wheel.insert(&sslots[1], 1000 * RtoWheel::kNumBuckets * kTick);
+  ASSERT_EQ(wheel.pop_expired(5 * kTick), &sslots[0]);
+  ASSERT_EQ(wheel.pop_expired((4 + RtoWheel::kNumBuckets) * kTick),
+            &sslots[1]);
+
+  // Requests re-inserted while popping are not popped again in this tick
+  wheel.insert(&sslots[0], 0);
+  const size_t now = (5 + RtoWheel::kNumBuckets) * kTick;
+  ASSERT_EQ(wheel.pop_expired(now), &sslots[0]);
+  wheel.insert(&sslots[0], now);
+  ASSERT_EQ(wheel.pop_expired(now), nullptr);
+}
+
+// Deadlines past the horizon expire with the farthest bucket, and are not
+// wrapped around into a nearer one
+TEST(RtoWheelTest, HorizonClamp) {
+  static constexpr size_t kHorizon = RtoWheel::kNumBuckets * kTick;
+  RtoWheel wheel(kTick, 0);
+  std::vector<SSlot> sslots(3);
+  for (SSlot &s : sslots) s.client_info.rto_pprev = nullptr;
+
+  wheel.insert(&sslots[0], kHorizon);  // Exactly the farthest bucket
+  wheel.insert(&sslots[1], kHorizon + 1);
+  wheel.insert(&sslots[2], 10 * kHorizon);
+
+  ASSERT_EQ(wheel.pop_expired(kHorizon - 1), nullptr);
+  std::vector<SSlot *> popped;
+  SSlot *s;
+  while ((s = wheel.pop_expired(kHorizon)) != nullptr) popped.push_back(s);
+  std::sort(popped.begin(), popped.end());
+  ASSERT_EQ(popped.size(), 3);
+  for (size_t i = 0; i < 3; i++) ASSERT_EQ(popped[i], &sslots[i]);
+
+  // The owner re-inserts a request that expired early. It's clamped again
+  // relative to the current bucket.
+  wheel.insert(&sslots[2], 10 * kHorizon);
+  ASSERT_EQ(wheel.pop_expired(kHorizon + kTick), nullptr);
+  ASSERT_EQ(wheel.pop_expired(2 * kHorizon - 1), nullptr);
+  ASSERT_EQ(wheel.pop_expired(2 * kHorizon), &sslots[2]);
+}
+
+// After a pause longer than the horizon, one call expires every request
+// without stepping through each missed tick, and the wheel keeps ticking from
+// the current time
+TEST(RtoWheelTest, LongPause) {
+  static constexpr size_t kHorizon = RtoWheel::kNumBuckets * kTick;
+  RtoWheel wheel(kTick, 0);
+  std::vector<SSlot> sslots(3);
+  for (SSlot &s : sslots) s.client_info.rto_pprev = nullptr;
+
+  wheel.insert(&sslots[0], 2 * kTick);
+  wheel.insert(&sslots[1], 100 * kTick);
+  wheel.insert(&sslots[2], 10 * kHorizon);
+
+  const size_t now = 1000 * kHorizon;
+  std::vector<SSlot *> popped;
+  SSlot *s;
+  while ((s = wheel.pop_expired(now)) != nullptr) {
+    // At most one pass over the buckets separates the wheel from now
+    ASSERT_GE(wheel.next_tick_tsc + kHorizon, now);
+    popped.push_back(s);
+  }
+  std::sort(popped.begin(), popped.end());
+  ASSERT_EQ(popped.size(), 3);
+  for (size_t i = 0; i < 3; i++) ASSERT_EQ(popped[i], &sslots[i]);
+  ASSERT_EQ(wheel.next_tick_tsc, now + kTick);
+
+  // Deadlines after the pause are measured from the current time
+  wheel.insert(&sslots[0], now + 3 * kTick);
+  ASSERT_EQ(wheel.pop_expired(now + 2 * kTick), nullptr);
+  ASSERT_EQ(wheel.pop_expired(now + 3 * kTick), &sslots[0]);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}